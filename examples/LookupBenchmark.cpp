@@ -0,0 +1,227 @@
+/**
+ * Benchmark of the different ways to look up the bin labels of many events
+ * Events flat in phase space are generated once, and their labels are then
+ * looked up with HyperHistogram::getVal, HyperBinningFrozen::getLabel and
+ * the batch lookup HyperBinningFrozen::getLabels with a range of group sizes.
+ * The batch lookup is then timed with the events sorted along a Morton or a 
+ * Hilbert curve, for a range of batch sizes, to find the batch size above 
+ * which sorting pays off. Finally, the events are looked up on several
+ * threads with the Chunked and SubtreeAffinity schedules of ParallelBinner,
+ * and with a ReplicatedBinning, which keeps a copy of the binning on each
+ * NUMA node, with and without transparent huge pages
+ * @param 1 Filename of binning scheme
+ * @param 2 (Optional) Number of events, default is 1000000
+ * @param 3 (Optional) Seed for random event generation, default is 42
+ * @param 4 (Optional) Number of times each lookup is repeated, default is 5
+ * @param 5 (Optional) Number of threads for the parallel lookups, default is the number of hardware threads
+ *
+ * The fastest of the repeats is reported for each method. All methods must
+ * agree with HyperHistogram::getVal on every event. The best group size
+ * depends on the machine and on how much of the binning fits in the cache,
+ * so it is worth running this on the machine that will do the lookups.
+ */
+
+#include<algorithm>
+#include<array>
+#include<chrono>
+#include<cstdio>
+#include<functional>
+#include<iostream>
+#include<string>
+#include<thread>
+#include<utility>
+#include<vector>
+#include"TLorentzVector.h"
+#include"TRandom3.h"
+#include"HyperPoint.h"
+#include"HyperHistogram.h"
+#include"HyperBinningFrozen.h"
+#include"ParallelBinner.h"
+#include"ReplicatedBinning.h"
+#include"PhaseSpaceGenerator.h"
+#include"Utilities.h"
+
+/**
+ * Time a lookup, and check it against the expected labels
+ * @param Name Name of the lookup, to be printed
+ * @param Lookup Function that fills the labels of all events
+ * @param Expected Labels from HyperHistogram::getVal
+ * @param NumberRepeats Number of times the lookup is repeated
+ * @return Fastest time per event, in ns
+ */
+double TimeLookup(const std::string &Name,
+		  const std::function<void(std::vector<int>&)> &Lookup,
+		  const std::vector<int> &Expected,
+		  int NumberRepeats) {
+  std::vector<int> Labels(Expected.size());
+  double Fastest = 0.0;
+  for(int i = 0; i < NumberRepeats; i++) {
+    const auto StartTime = std::chrono::steady_clock::now();
+    Lookup(Labels);
+    const double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - StartTime).count();
+    if(i == 0 || Seconds < Fastest) {
+      Fastest = Seconds;
+    }
+  }
+  const double NanosecondsPerEvent = 1e9*Fastest/Expected.size();
+  std::printf("%-36s %10.1f %12.3f %s\n", Name.c_str(), NanosecondsPerEvent,
+	      1e3/NanosecondsPerEvent, Labels == Expected ? "" : "(WRONG LABELS)");
+  return NanosecondsPerEvent;
+}
+
+int main(int argc, char *argv[]) {
+
+  if(argc < 2 || argc > 6) {
+    std::cout << "Usage: " << argv[0] << " <binning scheme> [number of events] [seed] [number of repeats] [number of threads]\n";
+    return 0;
+  }
+
+  const int NumberEvents = argc >= 3 ? std::stoi(std::string(argv[2])) : 1000000;
+  const unsigned int Seed = argc >= 4 ? std::stoul(std::string(argv[3])) : 42;
+  const int NumberRepeats = argc >= 5 ? std::stoi(std::string(argv[4])) : 5;
+  const int NumberThreads = argc == 6 ? std::stoi(std::string(argv[5])) :
+                            std::max(1u, std::thread::hardware_concurrency());
+
+  // Load and freeze the binning scheme
+
+  const HyperHistogram hyperHistogram(argv[1], "MEMRES READ");
+  const HyperBinningFrozen Binning = hyperHistogram.freeze();
+  if(!Binning.hasLabels()) {
+    std::cerr << "The bin contents of " << argv[1] << " can't be stored as integer labels\n";
+    return 1;
+  }
+  std::cout << "Binning scheme with " << Binning.getNumHyperVolumes() << " HyperVolumes and "
+	    << Binning.getNumBins() << " bins\n";
+
+  // Generate the events, and store their coordinates back to back
+
+  const TLorentzVector P_D(0.0, 0.0, 0.0, 1.86483);
+  const double PionMass = 0.13957039;
+  PhaseSpaceGenerator PhaseSpace(P_D, std::vector<double>(4, PionMass));
+  TRandom3 Random(Seed);
+  std::array<TLorentzVector, 4> Daughters;
+  std::vector<HyperPoint> Events(NumberEvents, HyperPoint(5));
+  std::vector<double> Coordinates;
+  Coordinates.reserve(5*NumberEvents);
+  for(auto &Event : Events) {
+    PhaseSpace.generate(Random);
+    for(std::size_t i = 0; i < 4; i++) {
+      Daughters[i] = PhaseSpace.getDecay(i);
+    }
+    Utilities::getBinningCoordinates(Daughters, P_D, Event);
+    Coordinates.insert(Coordinates.end(), Event.data(), Event.data() + 5);
+  }
+
+  // The labels that every lookup must reproduce
+
+  std::vector<int> Expected(NumberEvents);
+  for(int n = 0; n < NumberEvents; n++) {
+    Expected[n] = static_cast<int>(hyperHistogram.getVal(Events[n]));
+  }
+
+  std::printf("%-36s %10s %12s\n", "Lookup", "ns/event", "Mevents/s");
+
+  TimeLookup("HyperHistogram::getVal", [&](std::vector<int> &Labels) {
+    for(int n = 0; n < NumberEvents; n++) {
+      Labels[n] = static_cast<int>(hyperHistogram.getVal(Events[n]));
+    }
+  }, Expected, NumberRepeats);
+
+  const double Single = TimeLookup("HyperBinningFrozen::getLabel", [&](std::vector<int> &Labels) {
+    for(int n = 0; n < NumberEvents; n++) {
+      Labels[n] = Binning.getLabel(Coordinates.data() + 5*n);
+    }
+  }, Expected, NumberRepeats);
+
+  int BestGroupSize = 1;
+  double Best = Single;
+  for(int GroupSize = 1; GroupSize <= HyperBinningFrozen::MaxGroupSize; GroupSize *= 2) {
+    const double Batch = TimeLookup("getLabels, group size " + std::to_string(GroupSize), [&](std::vector<int> &Labels) {
+      Binning.getLabels(Coordinates.data(), NumberEvents, Labels.data(), GroupSize);
+    }, Expected, NumberRepeats);
+    if(Batch < Best) {
+      Best = Batch;
+      BestGroupSize = GroupSize;
+    }
+  }
+  std::cout << "Fastest batch lookup on this machine: group size " << BestGroupSize << "\n";
+
+  // Sorting the events along a space-filling curve before the lookup only
+  // pays off if the batches are large enough. The events are split into
+  // batches of a given size, and each batch is looked up in its own order
+
+  std::cout << "\nEvents sorted along a space-filling curve, with group size " << BestGroupSize << "\n";
+  std::printf("%-36s %10s %12s\n", "Lookup", "ns/event", "Mevents/s");
+  const std::array<std::pair<HyperBinningFrozen::PointOrder, std::string>, 3> Orders{{
+    {HyperBinningFrozen::InputOrder, "input order"},
+    {HyperBinningFrozen::MortonOrder, "Morton order"},
+    {HyperBinningFrozen::HilbertOrder, "Hilbert order"}}};
+  for(int BatchSize = 100; BatchSize <= NumberEvents; BatchSize *= 10) {
+    for(const auto &Order : Orders) {
+      const std::string Name = "batches of " + std::to_string(BatchSize) + ", " + Order.second;
+      TimeLookup(Name, [&](std::vector<int> &Labels) {
+	for(int First = 0; First < NumberEvents; First += BatchSize) {
+	  const int Size = std::min(BatchSize, NumberEvents - First);
+	  Binning.getLabels(Coordinates.data() + 5*First, Size, Labels.data() + First, BestGroupSize, Order.first);
+	}
+      }, Expected, NumberRepeats);
+    }
+  }
+
+  // With several threads, each core either walks the whole binning
+  // (Chunked), or only its own subtrees (SubtreeAffinity)
+
+  std::cout << "\nParallel lookups on " << NumberThreads << " threads\n";
+  std::printf("%-36s %10s %12s\n", "Lookup", "ns/event", "Mevents/s");
+  const ParallelBinner Chunked(Binning, NumberThreads, ParallelBinner::Chunked);
+  const ParallelBinner Subtrees(Binning, NumberThreads, ParallelBinner::SubtreeAffinity);
+  TimeLookup("ParallelBinner, chunked", [&](std::vector<int> &Labels) {
+    Chunked.getLabels(Coordinates.data(), NumberEvents, Labels.data());
+  }, Expected, NumberRepeats);
+  TimeLookup("ParallelBinner, " + std::to_string(Subtrees.getNumSubtrees()) + " subtrees", [&](std::vector<int> &Labels) {
+    Subtrees.getLabels(Coordinates.data(), NumberEvents, Labels.data());
+  }, Expected, NumberRepeats);
+
+  // A copy of the binning on each NUMA node, so that no thread has to
+  // reach into the memory of another socket, with and without huge pages
+
+  const ReplicatedBinning HugePages(Binning, true, true);
+  const ReplicatedBinning SmallPages(Binning, true, false);
+  std::cout << "\nCopies of the binning on " << HugePages.getNumReplicas() << " NUMA node(s)\n";
+  for(int i = 0; i < HugePages.getNumReplicas(); i++) {
+    std::cout << "Node " << HugePages.getReplicaNode(i) << (HugePages.isBound(i) ? ", bound" : ", not bound")
+	      << ", " << HugePages.getHugePageBytes(i)/(1024*1024) << " MB on huge pages\n";
+  }
+  for(int i = 0; i < SmallPages.getNumReplicas(); i++) {
+    std::cout << "Node " << SmallPages.getReplicaNode(i) << ", copy on small pages"
+	      << ", " << SmallPages.getHugePageBytes(i)/(1024*1024) << " MB on huge pages\n";
+  }
+  std::printf("%-36s %10s %12s\n", "Lookup", "ns/event", "Mevents/s");
+  TimeLookup("getLabel, original", [&](std::vector<int> &Labels) {
+    for(int n = 0; n < NumberEvents; n++) {
+      Labels[n] = Binning.getLabel(Coordinates.data() + 5*n);
+    }
+  }, Expected, NumberRepeats);
+  TimeLookup("getLabel, copy on huge pages", [&](std::vector<int> &Labels) {
+    const HyperBinningFrozen &Copy = HugePages.getBinning();
+    for(int n = 0; n < NumberEvents; n++) {
+      Labels[n] = Copy.getLabel(Coordinates.data() + 5*n);
+    }
+  }, Expected, NumberRepeats);
+  TimeLookup("getLabel, copy on small pages", [&](std::vector<int> &Labels) {
+    const HyperBinningFrozen &Copy = SmallPages.getBinning();
+    for(int n = 0; n < NumberEvents; n++) {
+      Labels[n] = Copy.getLabel(Coordinates.data() + 5*n);
+    }
+  }, Expected, NumberRepeats);
+  const ParallelBinner ReplicatedChunked(HugePages, NumberThreads, ParallelBinner::Chunked);
+  const ParallelBinner ReplicatedSubtrees(HugePages, NumberThreads, ParallelBinner::SubtreeAffinity);
+  TimeLookup("ParallelBinner, chunked, copies", [&](std::vector<int> &Labels) {
+    ReplicatedChunked.getLabels(Coordinates.data(), NumberEvents, Labels.data());
+  }, Expected, NumberRepeats);
+  TimeLookup("ParallelBinner, subtrees, copies", [&](std::vector<int> &Labels) {
+    ReplicatedSubtrees.getLabels(Coordinates.data(), NumberEvents, Labels.data());
+  }, Expected, NumberRepeats);
+
+  return 0;
+}
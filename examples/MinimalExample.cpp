@@ -4,22 +4,182 @@
  * @param 1 Filename of binning scheme
  * @param 2 Seed for random event generation
  * @param 3 Number of events to generate
+ * @param 4 (Optional) Output file, which turns on the high-throughput mode
+ * @param 5 (Optional) Number of threads in the high-throughput mode
+ *
+ * In the high-throughput mode the events are generated on several threads
+ * and written to the output file instead of the terminal. If the filename
+ * ends with .csv each event is one line "px,py,pz,E (x4),bin number",
+ * otherwise each event is a binary record of 16 doubles (px, py, pz, E of
+ * pi+ pi+ pi- pi-) followed by the bin number as a 32-bit integer, in the
+ * native byte order. The output only depends on the seed, not on the number
+ * of threads.
  */
 
 #include<array>
 #include<string>
 #include<iostream>
 #include<algorithm>
+#include<atomic>
+#include<chrono>
+#include<condition_variable>
+#include<cstdio>
+#include<cstring>
+#include<fstream>
+#include<mutex>
+#include<thread>
+#include<vector>
 #include"TLorentzVector.h"
 #include"TGenPhaseSpace.h"
 #include"TRandom.h"
+#include"TRandom3.h"
 #include"HyperPoint.h"
 #include"HyperHistogram.h"
+#include"PhaseSpaceGenerator.h"
+#include"PhaseSpaceIntegrator.h"
 #include"Utilities.h"
 
+/**
+ * Generate, bin and write events on several threads
+ * The events are generated in chunks with their own random number stream,
+ * and the chunks are written in order
+ * @param hyperHistogram Binning scheme
+ * @param P_D Four-momentum of D
+ * @param Seed Seed for random event generation
+ * @param NumberEvents Number of events to generate
+ * @param Filename Output file, in CSV format if it ends with .csv and binary otherwise
+ * @param NumberThreads Number of threads
+ */
+void RunThroughputMode(const HyperHistogram &hyperHistogram,
+		       const TLorentzVector &P_D,
+		       unsigned int Seed,
+		       std::size_t NumberEvents,
+		       const std::string &Filename,
+		       int NumberThreads) {
+
+  const bool CSV = Filename.size() >= 4 &&
+                   Filename.compare(Filename.size() - 4, 4, ".csv") == 0;
+
+  std::ofstream Output(Filename, CSV ? std::ios::out : std::ios::out | std::ios::binary);
+  if(!Output) {
+    std::cerr << "Could not open " << Filename << " for writing\n";
+    return;
+  }
+
+  // Chunks are finished in any order, but written in order, and at most
+  // MaxChunksInFlight chunks are kept in memory at the same time
+
+  constexpr std::size_t ChunkSize = 10000;
+  const std::size_t NumberChunks = (NumberEvents + ChunkSize - 1)/ChunkSize;
+  const std::size_t MaxChunksInFlight = 4*NumberThreads;
+
+  std::vector<std::string> Buffers(NumberChunks);
+  std::vector<bool> Finished(NumberChunks, false);
+  std::size_t NextToWrite = 0;
+  std::atomic<std::size_t> NextChunk(0);
+  std::mutex Mutex;
+  std::condition_variable ChunkFinished, ChunkWritten;
+
+  auto Worker = [&]() {
+
+    const double PionMass = 0.13957039;
+    PhaseSpaceGenerator PhaseSpace(P_D, std::vector<double>(4, PionMass));
+    TRandom3 Random;
+    std::array<TLorentzVector, 4> Daughters;
+    HyperPoint hyperPoint(5);
+
+    for(std::size_t Chunk = NextChunk++; Chunk < NumberChunks; Chunk = NextChunk++) {
+
+      {
+	std::unique_lock<std::mutex> Lock(Mutex);
+	ChunkWritten.wait(Lock, [&]() { return Chunk < NextToWrite + MaxChunksInFlight; });
+      }
+
+      Random.SetSeed(PhaseSpaceIntegrator::getChunkSeed(Seed, Chunk));
+      const std::size_t EventsInChunk = std::min(ChunkSize, NumberEvents - Chunk*ChunkSize);
+
+      std::string Buffer;
+      Buffer.reserve(EventsInChunk*(CSV ? 160 : 16*sizeof(double) + sizeof(int)));
+      char Record[16*sizeof(double) + sizeof(int)];
+      char Number[32];
+
+      for(std::size_t n = 0; n < EventsInChunk; n++) {
+
+	PhaseSpace.generate(Random);
+	for(std::size_t i = 0; i < 4; i++) {
+	  Daughters[i] = PhaseSpace.getDecay(i);
+	}
+
+	const bool Flip = Utilities::getBinningCoordinates(Daughters, P_D, hyperPoint);
+	const int BinNumber = static_cast<int>(hyperHistogram.getVal(hyperPoint))*(Flip ? -1 : 1);
+
+	if(CSV) {
+	  for(std::size_t i = 0; i < 4; i++) {
+	    for(std::size_t j = 0; j < 4; j++) {
+	      const int Length = std::snprintf(Number, sizeof(Number), "%.7g,", Daughters[i][j]);
+	      Buffer.append(Number, Length);
+	    }
+	  }
+	  const int Length = std::snprintf(Number, sizeof(Number), "%d\n", BinNumber);
+	  Buffer.append(Number, Length);
+	} else {
+	  double Momenta[16];
+	  for(std::size_t i = 0; i < 4; i++) {
+	    for(std::size_t j = 0; j < 4; j++) {
+	      Momenta[4*i + j] = Daughters[i][j];
+	    }
+	  }
+	  std::memcpy(Record, Momenta, sizeof(Momenta));
+	  std::memcpy(Record + sizeof(Momenta), &BinNumber, sizeof(BinNumber));
+	  Buffer.append(Record, sizeof(Record));
+	}
+      }
+
+      std::lock_guard<std::mutex> Lock(Mutex);
+      Buffers[Chunk] = std::move(Buffer);
+      Finished[Chunk] = true;
+      ChunkFinished.notify_one();
+    }
+  };
+
+  const auto StartTime = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> Threads;
+  for(int i = 0; i < NumberThreads; i++) {
+    Threads.emplace_back(Worker);
+  }
+
+  // Write the chunks in order as they become available
+
+  while(NextToWrite < NumberChunks) {
+    std::string Buffer;
+    {
+      std::unique_lock<std::mutex> Lock(Mutex);
+      ChunkFinished.wait(Lock, [&]() { return Finished[NextToWrite]; });
+      Buffer = std::move(Buffers[NextToWrite]);
+    }
+    Output.write(Buffer.data(), Buffer.size());
+    {
+      std::lock_guard<std::mutex> Lock(Mutex);
+      NextToWrite++;
+    }
+    ChunkWritten.notify_all();
+  }
+
+  for(auto &Thread : Threads) {
+    Thread.join();
+  }
+  Output.close();
+
+  const double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - StartTime).count();
+  std::cout << "Generated, binned and wrote " << NumberEvents << " events to "
+	    << Filename << " in " << Seconds << " s on " << NumberThreads
+	    << " threads (" << NumberEvents/Seconds << " events/s)\n";
+}
+
 int main(int argc, char *argv[]) {
 
-  if(argc != 3 && argc != 4) {
+  if(argc < 3 || argc > 6) {
     return 0;
   }
 
@@ -42,15 +202,26 @@ int main(int argc, char *argv[]) {
 
   // Number of random events to generate
 
-  const std::size_t NumberIterations = argc == 4 ?
-                                       std::stoi(std::string(argv[3])) : 1;
+  const std::size_t NumberIterations = argc >= 4 ?
+                                       std::stoll(std::string(argv[3])) : 1;
+
+  // High-throughput mode, writing to a file
+
+  if(argc >= 5) {
+    const int NumberThreads = argc == 6 ? std::stoi(std::string(argv[5])) :
+                              std::max(1u, std::thread::hardware_concurrency());
+    RunThroughputMode(hyperHistogram, P_D, std::stoul(std::string(argv[2])),
+		      NumberIterations, argv[4], std::max(1, NumberThreads));
+    return 0;
+  }
+
+  TGenPhaseSpace PhaseSpace;
+  PhaseSpace.SetDecay(P_D, 4, DaughterMasses.data());
   
   for(std::size_t n = 0; n < NumberIterations; n++) {
 
     // Generate random D decay
 
-    TGenPhaseSpace PhaseSpace;
-    PhaseSpace.SetDecay(P_D, 4, DaughterMasses.data());
     PhaseSpace.Generate();
 
     // Particle ordering: pi+ pi+ pi- pi-
@@ -60,61 +231,10 @@ int main(int argc, char *argv[]) {
     }
 
     // Calculate the five variables that parameterise the D decay
+    // and determine bin number
 
-    const double mPlus = (Daughters[0] + Daughters[1]).M();
-    const double mMinus = (Daughters[2] + Daughters[3]).M();
-
-    double cosThetaPlus =
-      Utilities::getCosTheta(Daughters[0], Daughters[0] + Daughters[1], P_D);
-
-    double cosThetaMinus =
-      Utilities::getCosTheta(Daughters[2], Daughters[2] + Daughters[3], P_D);
-
-    double phi = Utilities::getPhi(Daughters);
-
-    constexpr double mMin = 2.0*0.13957039;
-
-    double mPlusPrime, mMinusPrime;
-    if(mMinus > mPlus) {
-      mPlusPrime  = mPlus  + (mPlus - mMin);
-      mMinusPrime = mMinus + (mPlus - mMin);
-    }
-    else {
-      mPlusPrime  = mPlus  + (mMinus - mMin);
-      mMinusPrime = mMinus + (mMinus - mMin);
-    }
-
-    // Transform the variables so that cosThetaPlus > 0, cosThetaMinus > 0 and phi > 0
-
-    if (cosThetaPlus < 0.0){
-      cosThetaPlus = -cosThetaPlus;
-      phi = phi - TMath::Pi();
-    }
-
-    if (cosThetaMinus < 0.0){
-      cosThetaMinus = -cosThetaMinus;
-      phi = phi- TMath::Pi();
-    }
-
-    while (phi < -TMath::Pi()){
-      phi += 2.0*TMath::Pi();
-    }
-
-    while (phi > TMath::Pi()){
-      phi -= 2.0*TMath::Pi();
-    }
-
-    bool Flip = false;
-    if (phi < 0){
-      std::swap(cosThetaPlus, cosThetaMinus); 
-      std::swap(mPlusPrime  , mMinusPrime  ); 
-      phi = -phi;
-      Flip = true;
-    }
-
-    // Create hyperpoint and determine bin number
-
-    HyperPoint hyperPoint(mPlusPrime, mMinusPrime, cosThetaPlus, cosThetaMinus, phi);
+    HyperPoint hyperPoint(5);
+    const bool Flip = Utilities::getBinningCoordinates(Daughters, P_D, hyperPoint);
     const double BinNumber = hyperHistogram.getVal(hyperPoint)*(Flip ? -1 : 1);
 
     // Print event
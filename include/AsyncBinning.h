@@ -0,0 +1,99 @@
+/**
+ * AsyncBinning loads a binning on a background thread, so that the rest of
+ * a job can be set up in the meantime.
+ *
+ **/
+
+/** \class AsyncBinning
+
+Reading a binning scheme and freezing it takes a while for a large scheme,
+and nothing else happens in the meantime. An AsyncBinning starts the load
+on a background thread as soon as it is made, and returns straight away.
+The first call to getBinning() waits for the load to finish, if it hasn't
+already, and every call after that returns at once.
+
+The load is either a binary scheme file (see HyperBinningFrozen::load()), or
+any function that makes a HyperBinningFrozen, e.g. one that loads a ROOT
+scheme into a HyperHistogram and freezes it. If the load fails, e.g. the
+file can't be read or the function throws, getBinning() throws the same
+exception on every call.
+
+A ROOT scheme is read with TFile and TTree on the background thread, while
+the main thread goes on with its own ROOT calls, and both use gROOT and
+gDirectory. ROOT::EnableThreadSafety() must therefore have been called
+before an AsyncBinning that uses ROOT is made. Binary scheme files don't
+need ROOT at all.
+
+getWaitTime() tells how long getBinning() had to wait, and getLoadTime() how
+long the load took, so the difference is the part of the load that was
+hidden behind the rest of the set up.
+
+~~~ {.cpp}
+
+  ROOT::EnableThreadSafety();
+  AsyncBinning asyncBinning([](){ return HyperHistogram("BesOptimEqualV0.root").freeze(); });
+
+  //open the input files, set up the job, ...
+
+  const HyperBinningFrozen& binning = asyncBinning.getBinning();
+  std::cout << "Waited " << asyncBinning.getWaitTime() << " s of " << asyncBinning.getLoadTime() << " s" << std::endl;
+
+~~~
+
+*/
+
+#ifndef ASYNCBINNING_HH
+#define ASYNCBINNING_HH
+
+// HyperPlot includes
+#include "HyperBinningFrozen.h"
+
+// Root includes
+
+// std includes
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+
+class AsyncBinning {
+
+  private:
+
+  mutable std::future<HyperBinningFrozen> _future; /**< The load running on the background thread */
+
+  mutable HyperBinningFrozen _binning;             /**< The binning, once it has been loaded */
+
+  mutable std::once_flag _waited;                  /**< Makes sure the load is only waited for once */
+
+  mutable std::exception_ptr _error;               /**< The exception thrown by the load, if any */
+
+  std::atomic<bool> _isReady;                      /**< Has the load finished? */
+
+  double _loadTime;                                /**< Time the load took in seconds, set by the background thread */
+
+  mutable double _waitTime;                        /**< Time getBinning() waited for the load in seconds */
+
+  void wait() const;
+
+  public:
+
+  AsyncBinning(const std::function<HyperBinningFrozen()>& makeBinning);
+  AsyncBinning(const std::string& filename);
+  ~AsyncBinning();
+
+  AsyncBinning(const AsyncBinning&) = delete;
+  AsyncBinning& operator=(const AsyncBinning&) = delete;
+
+  const HyperBinningFrozen& getBinning() const;
+
+  bool isReady() const {return _isReady;}
+  /**< check if the load has finished, without waiting for it */
+  double getLoadTime() const;
+  double getWaitTime() const;
+
+};
+
+#endif
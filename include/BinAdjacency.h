@@ -0,0 +1,118 @@
+/**
+ * BinAdjacency is the graph of which bins of a binning share a face, with
+ * the dimension and the area of each shared face.
+ *
+ **/
+
+/** \class BinAdjacency
+
+Two bins are neighbours if one of their HyperCuboids ends where one of the
+other's begins in some dimension, and the two overlap (with a non-zero
+width) in all the other dimensions. Bins that only touch along an edge or
+at a corner aren't neighbours. The area of the shared face is the volume
+of the overlap in the other dimensions, summed over all pairs of touching
+HyperCuboids.
+
+The graph is stored in compressed sparse row form: the neighbours of each
+bin are stored back to back, sorted by bin number, together with the
+dimension and the area of each shared face. A pair of bins that touch in
+more than one dimension, which can happen for bins made of several
+HyperCuboids, has one entry for each dimension.
+
+The neighbours of each bin are found with a region query over its
+HyperCuboids (see HyperBinningFrozen::getVolumesInRegion()), so only the
+bins nearby are ever compared, and the bins are split between several
+threads. Boundaries are compared exactly, which is the case for binnings
+made by splitting HyperVolumes, where neighbours share their boundaries.
+
+Building the graph of a fine binning still takes a while, so it can be
+saved next to the binning file and loaded from there. The file records the
+fingerprint of the binning (see HyperBinningFrozen::getFingerprint()), so
+a file that belongs to a different binning is never loaded.
+
+~~~ {.cpp}
+
+  BinAdjacency binAdjacency;
+  binAdjacency.loadOrBuild("BesOptimEqualV0.adjacency", binning);
+  for (int i = 0; i < binAdjacency.getNumNeighbours(Bin); i++){
+    std::cout << binAdjacency.getNeighbour(Bin, i) << " shares a face in dimension " << binAdjacency.getFaceDimension(Bin, i) << std::endl;
+  }
+
+~~~
+
+*/
+
+#ifndef BINADJACENCY_HH
+#define BINADJACENCY_HH
+
+// HyperPlot includes
+#include "HyperBinningFrozen.h"
+
+// Root includes
+
+// std includes
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class BinAdjacency {
+
+  private:
+
+  struct Face {
+    int    bin;       /**< the bin on the high side of the face */
+    int    neighbour; /**< the bin on the low side of the face */
+    int    dimension; /**< the dimension that the face is perpendicular to */
+    double area;      /**< the area of the face */
+  };
+
+  static constexpr std::uint32_t FileVersion = 1; /**< changes whenever the layout of the file changes */
+
+  std::uint64_t       _fingerprint;    /**< Fingerprint of the binning the graph was built from */
+
+  std::vector<int>    _firstNeighbour; /**< Index of the first neighbour of each bin, with the total at the end */
+  std::vector<int>    _neighbours;     /**< The neighbours of all bins, back to back */
+  std::vector<int>    _faceDimensions; /**< The dimension of each shared face */
+  std::vector<double> _faceAreas;      /**< The area of each shared face */
+
+  void findFaces(const HyperBinningFrozen& binning, int volumeNumber, std::vector<int>& candidates, std::vector<Face>& faces) const;
+
+  public:
+
+  BinAdjacency();
+  BinAdjacency(const HyperBinningFrozen& binning, int nThreads = 0);
+
+  void build(const HyperBinningFrozen& binning, int nThreads = 0);
+
+  bool save(const std::string& filename) const;
+  bool load(const std::string& filename, const HyperBinningFrozen& binning);
+  bool loadOrBuild(const std::string& filename, const HyperBinningFrozen& binning, int nThreads = 0);
+
+  int getNumBins () const {return _firstNeighbour.size() == 0 ? 0 : _firstNeighbour.size() - 1;}
+  /**< get the number of bins in the graph */
+  int getNumFaces() const {return _neighbours.size();}
+  /**< get the number of entries in the graph, which counts every shared face twice */
+  std::uint64_t getFingerprint() const {return _fingerprint;}
+  /**< get the fingerprint of the binning the graph was built from */
+
+  int getNumNeighbours(int binNumber) const {return _firstNeighbour[binNumber + 1] - _firstNeighbour[binNumber];}
+  /**< get the number of neighbours of a bin (counting a neighbour once for every dimension they touch in) */
+  int getNeighbour    (int binNumber, int i) const {return _neighbours    [_firstNeighbour[binNumber] + i];}
+  /**< get the bin number of the i-th neighbour of a bin */
+  int getFaceDimension(int binNumber, int i) const {return _faceDimensions[_firstNeighbour[binNumber] + i];}
+  /**< get the dimension that the face shared with the i-th neighbour is perpendicular to */
+  double getFaceArea  (int binNumber, int i) const {return _faceAreas     [_firstNeighbour[binNumber] + i];}
+  /**< get the area of the face shared with the i-th neighbour */
+
+  const std::vector<int>&    getFirstNeighbours() const {return _firstNeighbour;}
+  /**< get the CSR row offsets, one per bin plus the total at the end */
+  const std::vector<int>&    getNeighbours     () const {return _neighbours;}
+  /**< get the CSR column indices, which are the bin numbers of the neighbours */
+  const std::vector<int>&    getFaceDimensions () const {return _faceDimensions;}
+  /**< get the dimension of every shared face, in the same order as getNeighbours() */
+  const std::vector<double>& getFaceAreas      () const {return _faceAreas;}
+  /**< get the area of every shared face, in the same order as getNeighbours() */
+
+};
+
+#endif
@@ -0,0 +1,93 @@
+/**
+ * BinSampler generates points that are uniformly distributed inside given
+ * bins of a binning, without rejection sampling.
+ *
+ **/
+
+/** \class BinSampler
+
+A point inside a bin is generated by first picking one of the HyperCuboids
+of the bin, with a probability proportional to its volume, and then a
+uniform point inside that HyperCuboid. The HyperCuboids are picked with an
+alias table, which takes two random numbers however many HyperCuboids the
+bin has. The alias table of each bin is only built the first time a point
+is generated in that bin, by whichever thread gets there first.
+
+The points follow the same boundary convention as the lookups: a point is
+inside a HyperCuboid if low < x <= high, so every point generated in a bin
+is found in that bin again (as long as the HyperVolumes linked to the same
+HyperVolume don't overlap).
+
+Like PhaseSpaceIntegrator, the batch functions generate the points in
+chunks of fixed size, and each chunk has its own random number stream,
+seeded from the global seed and the chunk index. The points for a given
+seed therefore don't depend on the number of threads. std::mt19937_64 is
+used rather than TRandom3, so that the sampler doesn't need ROOT, and its
+output is turned into doubles directly rather than through
+std::uniform_real_distribution, whose algorithm differs between standard
+libraries, so the points are also the same on every platform.
+
+~~~ {.cpp}
+
+  const BinSampler binSampler(binning, 8);
+  std::vector<double> Coordinates(5*NumberEvents);
+  binSampler.sample(BinNumber, NumberEvents, Coordinates.data(), Seed);
+
+~~~
+
+*/
+
+#ifndef BINSAMPLER_HH
+#define BINSAMPLER_HH
+
+// HyperPlot includes
+#include "HyperBinningFrozen.h"
+
+// Root includes
+
+// std includes
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <vector>
+
+class BinSampler {
+
+  private:
+
+  struct AliasTable {
+    std::vector<double> probability; /**< probability of keeping each HyperCuboid, rather than taking its alias */
+    std::vector<int>    alias;       /**< the HyperCuboid taken instead of each HyperCuboid */
+  };
+
+  const HyperBinningFrozen& _binning;    /**< The binning, which must outlive the BinSampler */
+
+  int _nThreads;                         /**< Number of worker threads */
+
+  int _chunkSize;                        /**< Number of points generated with each random number stream */
+
+  std::vector<int> _volumeOfBin;         /**< The HyperVolume of each bin */
+
+  mutable std::vector<AliasTable> _aliasTables;                 /**< The alias table of each bin, once it is built */
+  mutable std::unique_ptr<std::once_flag[]> _aliasTableBuilt;   /**< Makes sure each alias table is built once */
+
+  const AliasTable& getAliasTable(int binNumber) const;
+  void sampleBatch(const int* binNumbers, int binNumber, int nPoints, double* coords, std::uint64_t seed) const;
+
+  public:
+
+  BinSampler(const HyperBinningFrozen& binning, int nThreads = 0, int chunkSize = 100000);
+
+  BinSampler(const BinSampler&) = delete;
+  BinSampler& operator=(const BinSampler&) = delete;
+
+  static std::uint64_t getChunkSeed(std::uint64_t seed, long long chunk);
+
+  void sample(int binNumber, double* coords, std::mt19937_64& random) const;
+  bool sample(int binNumber, int nPoints, double* coords, std::uint64_t seed) const;
+  bool sample(const int* binNumbers, int nPoints, double* coords, std::uint64_t seed) const;
+
+};
+
+#endif
@@ -17,7 +17,7 @@
 
 
 // Root includes
-
+#include "TString.h"
 
 // std includes
 
@@ -59,6 +59,7 @@ class BinningBase {
   //Purely virtual functions
 
   virtual void load(TString filename, TString option = "READ") = 0;
+  virtual void save(TString filename) const = 0;
 
 
   virtual BinningBase* clone() const = 0;
@@ -68,7 +69,7 @@ class BinningBase {
 
   virtual HyperVolume getBinHyperVolume(int binNumber) const = 0;
 
-  //virtual void mergeBinnings( const BinningBase& other ) = 0;
+  virtual void mergeBinnings( const BinningBase& other ) = 0;
 
   virtual HyperCuboid getLimits() const = 0;
  
@@ -0,0 +1,126 @@
+/**
+ * BinningDiff compares two versions of a binning, and re-bins events from
+ * the old version into the new one, looking up only those that need it.
+ *
+ **/
+
+/** \class BinningDiff
+
+When a binning scheme is revised, most of phase space usually keeps its
+label, and samples that were binned with the old scheme don't all need to
+be binned again. BinningDiff overlays the two binnings: for every bin of
+the old binning, it finds the bins of the new binning that overlap it with
+a non-zero volume, with a region query (see
+HyperBinningFrozen::getVolumesInRegion()). Two things come out of this.
+
+The changes are the regions where the label (or bin number) of the new
+binning differs from that of the old one, as the HyperCuboids where an old
+and a new bin overlap, together with their total volume.
+
+And for every old bin, either all of it falls into bins with the same new
+label, so that an event stored with that old bin number takes that label
+straight away, or it is split between several new labels, so that its
+events have to be looked up again. rebin() does exactly this, for a batch
+of events with their stored bin numbers. Events stored outside the old
+binning (bin number -1) are looked up again if the new binning reaches
+anywhere the old one didn't.
+
+Volumes smaller than tolerance times the volume of the bin being compared
+are ignored, so that rounding in the sums doesn't count as a change.
+
+~~~ {.cpp}
+
+  const BinningDiff binningDiff(oldBinning, newBinning, BinningDiff::Labels);
+  std::cout << 100.0*binningDiff.getLookupFraction() << "% of the volume needs to be looked up again" << std::endl;
+
+  int NumberLookedUp = binningDiff.rebin(Coordinates.data(), OldBinNumbers.data(), NumberEvents, NewLabels.data());
+
+~~~
+
+*/
+
+#ifndef BINNINGDIFF_HH
+#define BINNINGDIFF_HH
+
+// HyperPlot includes
+#include "HyperBinningFrozen.h"
+#include "HyperCuboid.h"
+
+// Root includes
+
+// std includes
+#include <vector>
+
+class BinningDiff {
+
+  public:
+
+  enum Index {
+    BinNumbers, /**< events are re-binned to bin numbers */
+    Labels      /**< events are re-binned to bin labels */
+  };
+
+  struct Change {
+    int         oldBin;   /**< bin number in the old binning */
+    int         newBin;   /**< bin number in the new binning */
+    int         oldLabel; /**< label in the old binning */
+    int         newLabel; /**< label in the new binning */
+    HyperCuboid region;   /**< the region where the two bins overlap */
+  };
+
+  private:
+
+  struct Results {
+    std::vector<Change> changes;
+    std::vector<double> newCovered;
+    double              totalVolume;
+    double              changedVolume;
+    double              lookupVolume;
+  };
+
+  const HyperBinningFrozen& _newBinning; /**< The new binning, which must outlive the BinningDiff */
+
+  Index _index;                          /**< Whether events are re-binned to bin numbers or labels */
+
+  double _tolerance;                     /**< Volumes below this fraction of the bin being compared are ignored */
+
+  std::vector<int>  _newIndexOfOldBin;   /**< The new bin number or label of everything in each old bin, with events outside the old binning last */
+  std::vector<char> _needsLookup;        /**< Is each old bin split between several new bin numbers or labels? */
+
+  std::vector<Change> _changes;          /**< Regions where the bin number or label changes, sorted by old bin number */
+
+  double _totalVolume;                   /**< Total volume of the old bins */
+  double _changedVolume;                 /**< Volume of the old bins where the bin number or label changes */
+  double _lookupVolume;                  /**< Volume of the old bins whose events need to be looked up again */
+
+  int  getIndex  (const HyperBinningFrozen& binning, int volumeNumber) const;
+  void compareBin(const HyperBinningFrozen& oldBinning, int volumeNumber, std::vector<int>& candidates, Results& results);
+
+  public:
+
+  BinningDiff(const HyperBinningFrozen& oldBinning, const HyperBinningFrozen& newBinning, Index index = Labels, int nThreads = 0, double tolerance = 1e-9);
+
+  BinningDiff(const BinningDiff&) = delete;
+  BinningDiff& operator=(const BinningDiff&) = delete;
+
+  int rebin(const double* coords, const int* oldBinNumbers, int nPoints, int* newIndices) const;
+
+  int getNumOldBins() const {return (int)_needsLookup.size() - 1;}
+  /**< get the number of bins in the old binning */
+  bool needsLookup(int oldBinNumber) const {return _needsLookup[oldBinNumber == -1 ? getNumOldBins() : oldBinNumber] != 0;}
+  /**< check if events in an old bin (or -1 for outside the old binning) need to be looked up again */
+  int getNewIndexOfOldBin(int oldBinNumber) const {return _newIndexOfOldBin[oldBinNumber == -1 ? getNumOldBins() : oldBinNumber];}
+  /**< get the new bin number or label of every event in an old bin, if it doesn't need to be looked up again */
+
+  const std::vector<Change>& getChanges() const {return _changes;}
+  /**< get the regions where the bin number or label changes, sorted by old bin number */
+  int getNumLookupBins() const;
+
+  double getChangedFraction() const {return _totalVolume > 0.0 ? _changedVolume/_totalVolume : 0.0;}
+  /**< get the fraction of the volume of the old binning where the bin number or label changes */
+  double getLookupFraction () const {return _totalVolume > 0.0 ? _lookupVolume/_totalVolume : 0.0;}
+  /**< get the fraction of the volume of the old binning whose events need to be looked up again */
+
+};
+
+#endif
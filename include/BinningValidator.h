@@ -0,0 +1,138 @@
+/**
+ * BinningValidator checks that the HyperVolumes linked from each HyperVolume
+ * of a binning tile it exactly, without overlaps or gaps.
+ *
+ **/
+
+/** \class BinningValidator
+
+A lookup that enters a HyperVolume expects to find the point in exactly one
+of its linked HyperVolumes. Where two linked HyperVolumes overlap, the
+point goes to whichever is tested first, and where they leave a gap, the
+trail of linked bins goes cold and the point isn't binned at all. Both can
+happen with a binning scheme that was made or edited by hand.
+
+validate() looks at every HyperVolume with links, and reports
+
+  - Overlaps: pairs of linked HyperVolumes whose HyperCuboids overlap with
+    a non-zero volume. The overlap goes to the first of the two, which is
+    the one tested first. The primary volumes (or the HyperVolumes that
+    nothing links to) are checked for overlaps in the same way, with -1 as
+    the volume number.
+  - Gaps: parts of a HyperVolume that none of its linked HyperVolumes
+    cover, as a list of HyperCuboids, largest first.
+  - Overhangs: parts of a linked HyperVolume that stick out of the
+    HyperVolume linking to it, and can never be reached.
+
+Comparing every pair of HyperCuboids would take far too long for a node with
+many linked HyperVolumes, so overlapping pairs are found by sweep and prune:
+the HyperCuboids are sorted along one dimension, and each one is only
+compared with those that haven't ended yet when it begins. Large numbers
+of HyperCuboids, e.g. the primary volumes of a flat binning, are first
+put in a grid of cells, which are swept one at a time. Gaps are found
+by first comparing the volume of a HyperVolume with the volume its linked
+HyperVolumes cover, and only where that falls short are the linked
+HyperCuboids cut out of it to find the uncovered regions. The HyperVolumes
+are split between several threads.
+
+Volumes smaller than tolerance times the volume of the HyperVolume being
+checked are ignored, so that rounding in the sums doesn't count as a gap.
+Overlaps are exact, since they are found by comparing boundaries.
+
+~~~ {.cpp}
+
+  BinningValidator validator;
+  if (validator.validate(binning, 8) == false){
+    for (const BinningValidator::Gap& gap : validator.getGaps()){
+      std::cout << "HyperVolume " << gap.volumeNumber << " has a gap of " << gap.fraction << std::endl;
+    }
+  }
+
+~~~
+
+*/
+
+#ifndef BINNINGVALIDATOR_HH
+#define BINNINGVALIDATOR_HH
+
+// HyperPlot includes
+#include "HyperBinningFrozen.h"
+#include "HyperCuboid.h"
+
+// Root includes
+
+// std includes
+#include <vector>
+
+class BinningValidator {
+
+  public:
+
+  struct Overlap {
+    int    volumeNumber; /**< the HyperVolume that links to both, or -1 for the primary volumes */
+    int    first;        /**< the HyperVolume that is tested first, and gets the points in the overlap */
+    int    second;       /**< the HyperVolume that is tested second */
+    double volume;       /**< volume of the overlap */
+  };
+
+  struct Gap {
+    int    volumeNumber;             /**< the HyperVolume with the gap */
+    double volume;                   /**< volume that none of the linked HyperVolumes cover */
+    double fraction;                 /**< the same, as a fraction of the volume of the HyperVolume */
+    std::vector<HyperCuboid> regions;/**< the uncovered regions, largest first */
+    bool   allRegions;               /**< false if there were too many regions, and only the largest are kept */
+  };
+
+  struct Overhang {
+    int    volumeNumber; /**< the HyperVolume that links to the one sticking out */
+    int    linkedVolume; /**< the linked HyperVolume that sticks out */
+    double volume;       /**< volume of the part that sticks out */
+  };
+
+  private:
+
+  struct Results {
+    std::vector<Overlap>  overlaps;
+    std::vector<Gap>      gaps;
+    std::vector<Overhang> overhangs;
+  };
+
+  struct Box {
+    int           member; /**< position of the HyperVolume among the ones being checked */
+    const double* low;    /**< low corner of the HyperCuboid */
+    const double* high;   /**< high corner of the HyperCuboid */
+  };
+
+  double _tolerance;               /**< Volumes below this fraction of the HyperVolume being checked are ignored */
+
+  int _maxRegions;                 /**< Largest number of uncovered regions kept for each gap */
+
+  static const int _maxSweepBoxes = 1024; /**< Most HyperCuboids swept at once, before they are split into a grid of cells */
+
+  std::vector<Overlap>  _overlaps;  /**< Overlaps found by the last validate() */
+  std::vector<Gap>      _gaps;      /**< Gaps found by the last validate() */
+  std::vector<Overhang> _overhangs; /**< Overhangs found by the last validate() */
+
+  void checkVolume(const HyperBinningFrozen& binning, int volumeNumber, const std::vector<int>& members, std::vector<Box>& boxes, Results& results) const;
+  double findOverlaps(const HyperBinningFrozen& binning, int volumeNumber, const std::vector<int>& members, std::vector<Box>& boxes, Results& results) const;
+  bool findGapRegions(const HyperBinningFrozen& binning, int volumeNumber, const std::vector<Box>& boxes, std::vector<double>& pieces) const;
+
+  public:
+
+  BinningValidator(double tolerance = 1e-9, int maxRegions = 100);
+
+  bool validate(const HyperBinningFrozen& binning, int nThreads = 0);
+
+  bool isValid() const {return _overlaps.size() == 0 && _gaps.size() == 0 && _overhangs.size() == 0;}
+  /**< check if the last validate() found nothing wrong */
+
+  const std::vector<Overlap>&  getOverlaps () const {return _overlaps;}
+  /**< get the overlaps found by the last validate(), sorted by volume number */
+  const std::vector<Gap>&      getGaps     () const {return _gaps;}
+  /**< get the gaps found by the last validate(), sorted by volume number */
+  const std::vector<Overhang>& getOverhangs() const {return _overhangs;}
+  /**< get the overhangs found by the last validate(), sorted by volume number */
+
+};
+
+#endif
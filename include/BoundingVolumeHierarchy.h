@@ -0,0 +1,177 @@
+/**
+ * A bounding volume hierarchy over a list of boxes, used to find the first
+ * box in the list that contains a point without testing all of them.
+ *
+ * Each box is stored as 2*dim doubles, the low corner followed by the high
+ * corner, and contains the points with low < x <= high in every dimension,
+ * like a HyperCuboid. The boxes are sorted into a binary tree, splitting 
+ * them in half along the longest side of their centres at every level, and
+ * every node of the tree holds the box that surrounds all the boxes below 
+ * it. A search only descends into nodes that contain the point.
+ *
+ * The boxes are usually the limits of HyperVolumes, which only surround
+ * the HyperVolume. findFirst() therefore takes a test that says if the 
+ * point really is inside item i, and returns the smallest i whose box 
+ * contains the point and that passes the test. This is exactly what a loop
+ * over all the items in order would find, so the index can replace such a
+ * loop without changing any results.
+ *
+ * findOverlapping() instead visits every item whose box overlaps a region,
+ * for the region queries of HyperBinningFrozen.
+ **/
+
+#ifndef BOUNDINGVOLUMEHIERARCHY_HH
+#define BOUNDINGVOLUMEHIERARCHY_HH
+
+// HyperPlot includes
+#include "MappableArray.h"
+
+// Root includes
+
+// std includes
+#include <limits>
+#include <utility>
+#include <vector>
+
+class BoundingVolumeHierarchy {
+
+  private:
+
+  struct Node {
+    int firstChild; /**< index of the first of the two daughter nodes, the second one follows it */
+    int firstItem;  /**< index of the first item of a leaf node in _items */
+    int nItems;     /**< number of items in a leaf node, or zero for other nodes */
+    int minItem;    /**< the smallest item below this node */
+  };
+
+  static const int _maxLeafSize = 4; /**< largest number of items in a leaf node */
+  static const int _maxDepth    = 60; /**< the tree is never deeper than this */
+
+  int _dimension;                   /**< Dimensionality of the boxes */
+
+  MappableArray<Node>   _nodes;       /**< The nodes of the tree, the first one is the root */
+
+  MappableArray<double> _nodeBoxes;   /**< The box surrounding each node, low corner then high corner */
+
+  MappableArray<int>    _items;       /**< The items, ordered by the leaf they are in, and in increasing order within a leaf */
+
+  MappableArray<double> _itemBoxes;   /**< The box of each item, in the same order as _items */
+
+  void buildNode(int nodeNumber, std::vector<int>& items, std::vector<double>& centres, const double* boxes, int first, int last, int depth);
+
+  bool inBox(const double* box, const double* coords) const{
+    for (int d = 0; d < _dimension; d++){
+      if ( !(box[d] < coords[d] && coords[d] <= box[_dimension + d]) ) return false;
+    }
+    return true;
+  }
+
+  bool overlapsBox(const double* box, const double* low, const double* high) const{
+    for (int d = 0; d < _dimension; d++){
+      if ( !(box[d] < high[d] && low[d] <= box[_dimension + d]) ) return false;
+    }
+    return true;
+  }
+
+  public:
+
+  BoundingVolumeHierarchy(int dimension = 0);
+
+  void build(int dimension, const double* boxes, int nItems);
+  void clear();
+
+  int getDimension() const {return _dimension;}
+  /**< get the dimensionality of the boxes */
+  int getNumItems () const {return _items.size();}
+  /**< get the number of boxes in the index */
+
+  template <class Test>
+  int findFirst(const double* coords, const Test& test) const;
+  template <class Visit>
+  void findOverlapping(const double* low, const double* high, const Visit& visit) const;
+
+  void writeImage(ImageWriter& writer) const;
+  bool readImage (ImageReader& reader, int nItems);
+  bool isMapped  () const {return _nodes.isMapped() && _nodeBoxes.isMapped() && _items.isMapped() && _itemBoxes.isMapped();}
+  /**< check if every array is mapped onto an image */
+
+};
+
+///Find the smallest item whose box contains coords, and for which 
+///test(item) is true. Returns -1 if there is none. This never allocates
+///memory.
+template <class Test>
+int BoundingVolumeHierarchy::findFirst(const double* coords, const Test& test) const{
+
+  if (_nodes.size() == 0) return -1;
+
+  int best = std::numeric_limits<int>::max();
+
+  int stack[_maxDepth + 2];
+  int nStack = 0;
+  stack[nStack++] = 0;
+
+  while (nStack > 0){
+
+    const int   nodeNumber = stack[--nStack];
+    const Node& node       = _nodes[nodeNumber];
+    if (node.minItem >= best) continue;
+    if (inBox(_nodeBoxes.data() + 2*_dimension*nodeNumber, coords) == false) continue;
+
+    if (node.nItems > 0){
+      for (int i = node.firstItem; i < node.firstItem + node.nItems; i++){
+        const int item = _items[i];
+        if (item >= best) break;
+        if (inBox(_itemBoxes.data() + 2*_dimension*i, coords) && test(item)) { best = item; break; }
+      }
+      continue;
+    }
+
+    //Visit the daughter with the smaller items first, as it is more 
+    //likely to rule out the other one
+    int first  = node.firstChild;
+    int second = node.firstChild + 1;
+    if (_nodes[second].minItem < _nodes[first].minItem) std::swap(first, second);
+    stack[nStack++] = second;
+    stack[nStack++] = first;
+
+  }
+
+  return best == std::numeric_limits<int>::max() ? -1 : best;
+
+}
+
+///Call visit(item) for every item whose box overlaps the region from low
+///to high, which includes its faces, so a region with low == high in some
+///dimension is a slice. The items are visited in no particular order. This
+///never allocates memory.
+template <class Visit>
+void BoundingVolumeHierarchy::findOverlapping(const double* low, const double* high, const Visit& visit) const{
+
+  if (_nodes.size() == 0) return;
+
+  int stack[_maxDepth + 2];
+  int nStack = 0;
+  stack[nStack++] = 0;
+
+  while (nStack > 0){
+
+    const int   nodeNumber = stack[--nStack];
+    const Node& node       = _nodes[nodeNumber];
+    if (overlapsBox(_nodeBoxes.data() + 2*_dimension*nodeNumber, low, high) == false) continue;
+
+    if (node.nItems > 0){
+      for (int i = node.firstItem; i < node.firstItem + node.nItems; i++){
+        if (overlapsBox(_itemBoxes.data() + 2*_dimension*i, low, high)) visit(_items[i]);
+      }
+      continue;
+    }
+
+    stack[nStack++] = node.firstChild + 1;
+    stack[nStack++] = node.firstChild;
+
+  }
+
+}
+
+#endif
@@ -45,8 +45,10 @@ class HistogramBase {
   void resetBinContents(int nBins);
 
   double getBinContent(int bin) const;
+  void   setBinContent(int bin, double val);
 
   void loadBase(TString filename);
+  void saveBase(TString filename) const;
 
 };
 
@@ -60,6 +60,8 @@ The
 #include "HyperVolume.h"
 #include "BinningBase.h"
 #include "CachedVar.h"
+#include "HyperBinningFrozen.h"
+#include "BoundingVolumeHierarchy.h"
 
 
 // Root includes
@@ -149,6 +151,19 @@ class HyperBinning : public BinningBase {
     ~~~
   */
 
+  mutable CachedVar<BoundingVolumeHierarchy> _rootVolumeIndex;
+  /**< 
+    A spatial index over the limits of the primary volumes, so that a HyperPoint
+    can find its primary volume without testing all of them in turn. If there
+    are no primary volumes and no linked bins (a flat binning), it covers all
+    of the HyperVolumes instead. This is only built if there are at
+    least _minIndexedVolumes volumes to cover, otherwise it is empty and they 
+    are tested in turn.
+  */
+
+  static const int _minIndexedVolumes = 8;
+  /**< Smallest number of volumes for which _rootVolumeIndex is built */
+
   protected:
 
 
@@ -157,6 +172,7 @@ class HyperBinning : public BinningBase {
   void updateCash() const; 
   void updateBinNumbering() const; 
   void updateMinMax() const;
+  void updateRootVolumeIndex() const;
 
   int getHyperBinningDimFromTree(TTree* tree);
 
@@ -180,10 +196,16 @@ class HyperBinning : public BinningBase {
 
   virtual std::vector<int> getLinkedHyperVolumes( int volumeNumber ) const = 0;
   virtual HyperVolume getHyperVolume(int volumeNumber) const = 0; /**< get one of the HyperVolumes */
-  //virtual void addPrimaryVolumeNumber(int volumeNumber) = 0;
-  virtual bool addHyperVolume(const HyperVolume& hyperVolume, std::vector<int> linkedVolumes = std::vector<int>(0, 0)) = 0;
+  virtual HyperCuboid getHyperVolumeLimits(int volumeNumber) const; /**< get the HyperCuboid surrounding one of the HyperVolumes */
+  virtual void addPrimaryVolumeNumber(int volumeNumber) = 0;
+  virtual bool addHyperVolume(const HyperVolume& hyperVolume, const std::vector<int>& linkedVolumes = std::vector<int>(0, 0)) = 0;
   virtual int getNumHyperVolumes() const = 0;  
 
+  //Used when looking up bins. These must not copy any HyperVolumes, or allocate any memory
+  virtual bool inHyperVolume           (int volumeNumber, const HyperPoint& coords) const = 0; /**< check if a HyperPoint falls in one of the HyperVolumes */
+  virtual int  getNumLinkedHyperVolumes(int volumeNumber) const = 0;
+  virtual int  getLinkedHyperVolume    (int volumeNumber, int i) const = 0;
+
   virtual int getNumPrimaryVolumes  () const = 0;  
   virtual int getPrimaryVolumeNumber(int i) const = 0;  
 
@@ -193,12 +215,13 @@ class HyperBinning : public BinningBase {
   /*    These will be implemented in the derived classes */
 
   virtual void load(TString filename, TString option = "READ") = 0;
+  virtual void save(TString filename) const = 0;
   virtual BinningBase* clone() const = 0;
 
   /*    These will be implemented in this class */
 
 
-  //virtual void mergeBinnings( const BinningBase& other );
+  virtual void mergeBinnings( const BinningBase& other );
 
   virtual int getNumBins() const;
   virtual int getBinNum(const HyperPoint& coords) const;
@@ -209,6 +232,8 @@ class HyperBinning : public BinningBase {
 
   virtual HyperCuboid getLimits()          const;
 
+  HyperBinningFrozen freeze() const;
+
 
 
 };
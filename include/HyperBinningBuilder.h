@@ -0,0 +1,76 @@
+/**
+ * HyperBinningBuilder is used to build a large HyperBinningMemRes in code.
+ *
+ **/
+
+/** \class HyperBinningBuilder
+
+Adding HyperVolumes one at a time with HyperBinningMemRes::addHyperVolume()
+copies each HyperVolume and its links. HyperBinningBuilder instead 
+collects the HyperCuboids and links in bulk, either from flat arrays or from
+containers that are moved in. Nothing is checked until finalize(), which 
+validates everything once, builds all the caches in one pass, and hands
+over the result as an immutable HyperBinningMemRes. The time this takes 
+grows linearly with the number of HyperVolumes.
+
+~~~ {.cpp}
+
+  HyperBinningBuilder builder(5);
+  builder.addHyperVolumes(std::move(hyperVolumes), std::move(linkedVolumes));
+  builder.addPrimaryVolumeNumber(0);
+  std::unique_ptr<const HyperBinningMemRes> binning = builder.finalize();
+  binning->save("MyBinning.root");
+
+~~~
+
+*/
+
+#ifndef HYPERBINNINGBUILDER_HH
+#define HYPERBINNINGBUILDER_HH
+
+// HyperPlot includes
+#include "HyperVolume.h"
+#include "HyperBinningMemRes.h"
+
+// Root includes
+
+// std includes
+#include <memory>
+#include <vector>
+
+class HyperBinningBuilder {
+
+  private:
+
+  int _dimension;                        /**< Dimensionality of the binning */
+
+  std::vector<double> _cuboidCorners;    /**< HyperCuboids of all HyperVolumes, low corner then high corner */
+  std::vector<int>    _firstCuboid;      /**< Index of the first HyperCuboid of each HyperVolume, plus one past the end */
+  std::vector<int>    _linkedVolumes;    /**< Linked HyperVolumes of all HyperVolumes, back to back */
+  std::vector<int>    _firstLink;        /**< Index of the first link of each HyperVolume, plus one past the end */
+  std::vector<int>    _primaryVolumeNumbers; /**< Primary volume numbers */
+
+  bool validate() const;
+  void clear();
+
+  public:
+
+  HyperBinningBuilder(int dimension);
+
+  void reserve(int nVolumes, int nCuboids, int nLinks);
+
+  int  getNumHyperVolumes() const {return (int)_firstCuboid.size() - 1;}
+  /**< get the number of HyperVolumes added so far */
+
+  int  addHyperVolume (const HyperVolume& hyperVolume, const std::vector<int>& linkedVolumes = std::vector<int>());
+  void addHyperVolumes(std::vector<HyperVolume>&& hyperVolumes, std::vector< std::vector<int> >&& linkedVolumes);
+  void addHyperVolumes(int nVolumes, const int* nCuboids, const double* cuboidCorners, const int* nLinks, const int* linkedVolumes);
+
+  void addPrimaryVolumeNumber (int volumeNumber);
+  void addPrimaryVolumeNumbers(const std::vector<int>& volumeNumbers);
+
+  std::unique_ptr<const HyperBinningMemRes> finalize();
+
+};
+
+#endif
@@ -0,0 +1,304 @@
+/**
+ * HyperBinningFrozen is a read-only copy of a HyperBinning that is laid
+ * out for fast lookups. 
+ *
+ **/
+
+/** \class HyperBinningFrozen
+
+Looking up a bin in a HyperHistogram goes through virtual calls into the
+HyperBinning to find the HyperVolume, then through _binNum to find the bin 
+number, and finally through HistogramBase::_binContents to find the bin 
+content. For the D->4pi binning scheme the bin content is the (integer) bin
+label, so most of this work is wasted. 
+
+HyperBinningFrozen stores every HyperVolume as a small node that holds the
+range of its HyperCuboids, the range of its linked HyperVolumes, its bin 
+number, and, for the true bins, the bin label as a 16-bit integer. The 
+HyperCuboids of each HyperVolume are sorted from largest to smallest, and 
+HyperVolumes with more than one HyperCuboid are first tested against the 
+HyperCuboid that surrounds them. A lookup
+walks the bin hierarchy in exactly the same order as HyperBinning::getBinNum,
+and finishes at the leaf with the label in hand. Once frozen, the
+HyperHistogram it came from is no longer needed.
+
+Batches of points can be looked up with getVolumeNumbers(), getBinNums()
+and getLabels(). When the binning doesn't fit into the cache, a single lookup
+spends most of its time waiting for the next node to arrive from memory, 
+one level at a time. The batch lookups instead keep a group of points 
+in flight, each at its own level of the hierarchy. For every level, the 
+batch lookup first prefetches what each point in the group needs next (its
+links, then the linked nodes, then their HyperCuboids), so that by the 
+time the points are tested and moved down, the memory has arrived. The 
+group size is tunable, and a group size of one is the same as a loop over
+getVolumeNumber(). When most
+of the binning is already in the cache there is nothing to wait for, and 
+the extra passes make the batch lookups slower than a plain loop, so the 
+group size is best chosen with the LookupBenchmark example.
+
+Points that are close to each other usually walk the same path down the 
+bin hierarchy. The batch lookups can therefore first sort the points along
+a Morton (Z-order) or Hilbert curve through the limits of the binning, 
+look them up in that order, and put the results back into the order of the 
+input. Consecutive lookups then find most of the nodes they need in the 
+cache. Sorting costs time and memory of its own, so it only pays off for 
+large batches, and the LookupBenchmark example shows where the break-even
+batch size is.
+
+When there are many primary volumes, e.g. after merging binnings, the 
+first one that contains a point is found with a BoundingVolumeHierarchy 
+over their limits instead of testing them all in turn. The same is done
+over all the HyperVolumes of a flat binning, which has no primary volumes
+and no links.
+
+getBinsInRegion() finds all the bins that overlap a region, such as a band
+in one of the invariant masses, by walking down the bin hierarchy and 
+skipping every HyperVolume whose HyperCuboids miss the region, so the time
+it takes grows with the number of bins found rather than the size of the 
+binning. It can also give the fraction of the volume of each bin that is 
+inside the region. Like the lookups, it assumes that the HyperVolumes 
+linked to the same HyperVolume don't overlap each other.
+
+rasteriseSlice() fills a 2D grid with the labels at the centre of each 
+pixel, for a slice through two dimensions at fixed values of the others. 
+It finds the bins in the slice with the same walk, and fills the pixels 
+of each of their HyperCuboids row by row, instead of looking up every pixel
+(see HyperHistogram::getSlice() for a TH2D). The bins are filled in the
+order a lookup tests them, so where they overlap, a pixel gets the same bin
+as a lookup would.
+
+For a coarse classification, getVolumeNumberAtDepth() and 
+getVolumeNumberAtSize() stop part of the way down the bin hierarchy, and 
+return the HyperVolume they stopped at. The bins below each HyperVolume 
+are found with getBinsBelow(). Bin numbers follow the order in which the 
+HyperVolumes were added, so the bins below a HyperVolume are usually not 
+a range of bin numbers. Instead, buildIndex() lists all the bins in the 
+order of a depth-first walk through the hierarchy, where the bins below 
+every HyperVolume form a range.
+
+A HyperBinningFrozen is usually made with HyperHistogram::freeze() or 
+HyperBinning::freeze(). It can also be filled by hand, by adding all the 
+HyperVolumes with addHyperVolume() before any primary volume numbers, and
+finally calling buildIndex(). Until then, the primary volumes are tested
+in turn.
+
+All of its arrays can be written into a single image with writeImage(), 
+and another HyperBinningFrozen can be mapped onto that image with 
+readImage(). This is how SharedBinning shares one binning between all the
+processes on a machine. save() writes the image into a binary scheme file, 
+which load() reads back without ROOT (see tools/BinningConverter). The file
+is in the byte order of the machine that wrote it.
+
+HyperBinningFrozen and the classes built on it (ParallelBinner,
+SharedBinning, ReplicatedBinning, MigrationMatrix, BinAdjacency and 
+BinSampler), together with HyperPoint, HyperCuboid and HyperVolume, form 
+the D02pipipipi_binning_core library, which doesn't need ROOT.
+
+*/
+
+#ifndef HYPERBINNINGFROZEN_HH
+#define HYPERBINNINGFROZEN_HH
+
+// HyperPlot includes
+#include "HyperPoint.h"
+#include "HyperCuboid.h"
+#include "HyperVolume.h"
+#include "BoundingVolumeHierarchy.h"
+#include "MappableArray.h"
+
+// Root includes
+
+// std includes
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class HyperBinningFrozen {
+
+  private:
+
+  struct Node {
+    int          firstCuboid; /**< index of the first HyperCuboid in _cuboidCorners */
+    int          nCuboids;    /**< number of HyperCuboids in the HyperVolume */
+    int          firstLink;   /**< index of the first linked HyperVolume in _linkedVolumes */
+    int          nLinks;      /**< number of linked HyperVolumes (zero for a true bin) */
+    int          binNumber;   /**< bin number, or -1 if this is part of the hierarchy */
+    std::int16_t label;       /**< bin label, only used for true bins */
+  };
+
+  int _dimension;                     /**< Dimensionality of the binning */
+
+  MappableArray<Node>   _nodes;         /**< One node for each HyperVolume */
+
+  MappableArray<double> _cuboidCorners; /**< All HyperCuboids, each one is the low corner followed by the high corner */
+
+  MappableArray<double> _volumeLimits;  /**< The HyperCuboid surrounding each node, low corner then high corner */
+
+  MappableArray<int>    _linkedVolumes; /**< The linked HyperVolumes of all nodes, back to back */
+
+  MappableArray<int>    _primaryVolumeNumbers; /**< Primary volumes, see HyperBinningMemRes */
+
+  MappableArray<double> _allLimits;     /**< Low then high corner surrounding all HyperVolumes */
+  MappableArray<double> _primaryLimits; /**< Low then high corner surrounding the primary volumes */
+
+  int _nBins;                         /**< Number of true bins */
+
+  BoundingVolumeHierarchy _rootIndex; /**< Index over the limits of the primary volumes (or all volumes of a flat binning). Empty until buildIndex() */
+  static const int _minIndexedVolumes = 8; /**< Fewer volumes than this are tested in turn */
+
+  MappableArray<int> _rootVolumes;    /**< HyperVolumes that no other links to, for region queries of binnings with links but no primary volumes. Empty until buildIndex() */
+
+  MappableArray<int> _binsInDepthOrder; /**< All bin numbers, in the order of a depth-first walk through the hierarchy. Empty until buildIndex() */
+  MappableArray<int> _binsBelow;        /**< For each HyperVolume, the first of its bins in _binsInDepthOrder and the number of them. Empty until buildIndex() */
+
+  std::shared_ptr<const char> _file;  /**< The contents of the file the binning was loaded from, which the arrays are mapped onto */
+
+  static const std::size_t _fileHeaderSize = 64; /**< the image starts this far into a binary scheme file */
+
+  bool _hasLabels;                    /**< Have the bin labels been set? */
+  std::int16_t _outsideLabel;         /**< Label returned for points that aren't in any bin */
+
+  struct Lookup {
+    int point;                /**< index of the point in the batch */
+    int volumeNumber;         /**< HyperVolume whose linked HyperVolumes are searched next */
+  };
+
+  void walkBatch   (const double* coords, int nPoints, int* volumeNumbers, int groupSize) const;
+  bool startLookup (Lookup& lookup, int& nextPoint, int nPoints, const double* coords, int* volumeNumbers) const;
+  bool descend     (Lookup& lookup, const double* coords, int* volumeNumbers) const;
+  void prefetchLinks        (int volumeNumber) const;
+  void prefetchLinkedNodes  (int volumeNumber) const;
+  void prefetchLinkedCuboids(int volumeNumber) const;
+
+  bool inNode   (int volumeNumber, const double* coords) const;
+  bool overlapsNode(int volumeNumber, const double* low, const double* high) const;
+  bool inLimits (const double* coords) const;
+  void extendLimits(MappableArray<double>& limits, int volumeNumber) const;
+  bool checkIndices() const;
+
+  public:
+
+  HyperBinningFrozen(int dimension = 0);
+
+  //Used when filling the HyperBinningFrozen
+
+  void addHyperVolume(const HyperVolume& hyperVolume, const std::vector<int>& linkedVolumes);
+  void addPrimaryVolumeNumber(int volumeNumber);
+  bool setLabels(const std::vector<double>& binContents);
+  void buildIndex();
+
+  //Information about the binning
+
+  int getDimension      () const {return _dimension;}
+  /**< get the dimensionality of the binning */
+  int getNumHyperVolumes() const {return _nodes.size();}
+  /**< get the number of HyperVolumes (bins and hierarchy) */
+  int getNumBins        () const {return _nBins;}
+  /**< get the number of true bins */
+  bool hasLabels        () const {return _hasLabels;}
+  /**< check if bin labels have been set */
+
+  HyperCuboid getLimits() const;
+
+  //Read-only access to the HyperVolumes, without copying them
+
+  int getNumHyperCuboids      (int volumeNumber) const {return _nodes[volumeNumber].nCuboids;}
+  /**< get the number of HyperCuboids that make up a HyperVolume */
+  const double* getLowCorner  (int volumeNumber, int i) const {return _cuboidCorners.data() + 2*_dimension*(_nodes[volumeNumber].firstCuboid + i);}
+  /**< get the low corner of the i-th HyperCuboid of a HyperVolume */
+  const double* getHighCorner (int volumeNumber, int i) const {return getLowCorner(volumeNumber, i) + _dimension;}
+  /**< get the high corner of the i-th HyperCuboid of a HyperVolume */
+  const double* getVolumeLimits(int volumeNumber) const {return _volumeLimits.data() + 2*_dimension*volumeNumber;}
+  /**< get the low then high corner of the HyperCuboid that surrounds a HyperVolume */
+  int getNumLinkedHyperVolumes(int volumeNumber) const {return _nodes[volumeNumber].nLinks;}
+  /**< get the number of HyperVolumes linked to a HyperVolume */
+  int getLinkedHyperVolume    (int volumeNumber, int i) const {return _linkedVolumes[_nodes[volumeNumber].firstLink + i];}
+  /**< get the i-th HyperVolume linked to a HyperVolume */
+  int getBinNum               (int volumeNumber) const {return volumeNumber == -1 ? -1 : _nodes[volumeNumber].binNumber;}
+  /**< get the bin number of a HyperVolume, or -1 if it's part of the hierarchy (or -1 itself) */
+  int getVolumeLabel          (int volumeNumber) const {return _nodes[volumeNumber].label;}
+  /**< get the label of a HyperVolume that is a true bin */
+  int getOutsideLabel         () const {return _outsideLabel;}
+  /**< get the label of points that aren't in any bin */
+  int getNumPrimaryVolumes    () const {return _primaryVolumeNumbers.size();}
+  /**< get the number of primary volumes */
+  int getPrimaryVolumeNumber  (int i) const {return _primaryVolumeNumbers[i];}
+  /**< get one of the primary volume numbers */
+
+  HyperVolume getHyperVolume(int volumeNumber) const;
+
+  std::uint64_t getFingerprint() const;
+
+  int getNumBinsBelow(int volumeNumber) const {return _binsBelow.size() == 0 || volumeNumber == -1 ? 0 : _binsBelow[2*volumeNumber + 1];}
+  /**< get the number of bins below a HyperVolume (one for a bin itself, none for -1), once buildIndex() has been called */
+  const int* getBinsBelow(int volumeNumber) const {return _binsInDepthOrder.data() + (_binsBelow.size() == 0 || volumeNumber == -1 ? 0 : _binsBelow[2*volumeNumber]);}
+  /**< get the bin numbers of the bins below a HyperVolume, which are getNumBinsBelow() ints in a row */
+
+  //Lookups. These never allocate memory
+
+  bool inHyperVolume    (int volumeNumber, const double* coords) const {return inNode(volumeNumber, coords);}
+  /**< check if coords falls inside one of the HyperVolumes */
+  int  findPrimaryVolume(const double* coords) const;
+  int  followLinks      (int volumeNumber, const double* coords) const;
+  int  followLinks      (int volumeNumber, const double* coords, int maxDepth, int maxBins) const;
+  int  getLabelOfVolume (int volumeNumber) const;
+  double getDistanceToBoundary(int volumeNumber, const double* coords) const;
+
+  int getVolumeNumber(const double* coords) const;
+  int getVolumeNumberAtDepth(const double* coords, int depth) const;
+  int getVolumeNumberAtSize (const double* coords, int maxBins) const;
+  int getBinNum      (const double* coords) const;
+  int getBinNum      (const HyperPoint& coords) const;
+  int getLabel       (const double* coords) const;
+  int getLabel       (const HyperPoint& coords) const;
+
+  //Batch lookups. The points are stored back to back in coords, with
+  //getDimension() doubles each. In the InputOrder these never allocate 
+  //memory either
+
+  static constexpr int DefaultGroupSize = 16; /**< default number of points in flight in the batch lookups */
+  static constexpr int MaxGroupSize     = 64; /**< largest number of points in flight in the batch lookups */
+
+  enum PointOrder { 
+    InputOrder,  /**< look up the points in the order they are given */
+    MortonOrder, /**< look up the points in the order of a Morton (Z-order) curve */
+    HilbertOrder /**< look up the points in the order of a Hilbert curve */
+  };
+
+  void getVolumeNumbers(const double* coords, int nPoints, int* volumeNumbers, int groupSize = DefaultGroupSize, PointOrder order = InputOrder) const;
+  void getBinNums      (const double* coords, int nPoints, int* binNumbers   , int groupSize = DefaultGroupSize, PointOrder order = InputOrder) const;
+  void getLabels       (const double* coords, int nPoints, int* labels       , int groupSize = DefaultGroupSize, PointOrder order = InputOrder) const;
+
+  void sortPoints(const double* coords, int nPoints, PointOrder order, std::vector<int>& permutation) const;
+
+  //Region queries. A region is given by its low and high corners, and 
+  //includes its faces, so a region with low == high in some dimensions
+  //is a slice through the binning
+
+  void getVolumesInRegion(const double* low, const double* high, std::vector<int>& volumeNumbers) const;
+  void getBinsInRegion   (const double* low, const double* high, std::vector<int>& binNumbers, std::vector<double>* overlapFractions = 0) const;
+  void getBinsInRegion   (const HyperCuboid& region, std::vector<int>& binNumbers, std::vector<double>* overlapFractions = 0) const;
+  double getOverlapFraction(int volumeNumber, const double* low, const double* high) const;
+
+  bool rasteriseSlice(const double* coords, int dimX, int nX, double lowX, double highX,
+                                            int dimY, int nY, double lowY, double highY, int* labels) const;
+
+  //Images. A HyperBinningFrozen can be written into one contiguous block 
+  //of memory, and another one can then be mapped onto that block without
+  //copying it (see MappableArray and SharedBinning)
+
+  static constexpr std::uint32_t ImageVersion = 3; /**< changes whenever the layout of the image changes */
+
+  void writeImage(ImageWriter& writer) const;
+  bool readImage (ImageReader& reader);
+  bool isMapped  () const;
+
+  static constexpr std::uint32_t FileVersion = 1; /**< changes whenever the layout of the file header changes */
+
+  bool save(const std::string& filename) const;
+  bool load(const std::string& filename);
+
+};
+
+#endif
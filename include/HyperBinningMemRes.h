@@ -74,11 +74,27 @@ class HyperBinningMemRes : public HyperBinning {
 
   protected:
 
-  std::vector< HyperVolume      > _hyperVolumes;
+  std::vector< double > _cuboidCorners;
   /**< 
-    std::vector containing all of the HyperVolumes. Usually, not all of these are bins,
+    The arena that holds the HyperCuboids of all the HyperVolumes, back to back in
+    one block of memory. Each HyperCuboid takes up 2*dim doubles, the low corner
+    followed by the high corner. Usually, not all of the HyperVolumes are bins,
     but part of the bin hierarchy that is discussed in the class description.
   */
+
+  std::vector< double > _volumeLimits;
+  /**< 
+    The HyperCuboid that surrounds each HyperVolume, stored as 2*dim doubles (low corner
+    followed by the high corner) per HyperVolume. HyperVolumes made up from more than one
+    HyperCuboid are first tested against this.
+  */
+
+  std::vector< int > _firstCuboid;
+  /**< 
+    HyperVolume i is made up of HyperCuboids _firstCuboid[i] to _firstCuboid[i+1] - 1
+    in _cuboidCorners, sorted from largest to smallest volume. This has one more element
+    than there are HyperVolumes.
+  */
   
   std::vector< int > _primaryVolumeNumbers;
   /**<
@@ -106,12 +122,13 @@ class HyperBinningMemRes : public HyperBinning {
 
   */
 
-  std::vector< std::vector<int> > _linkedHyperVolumes; 
+  std::vector< int > _linkedHyperVolumes; 
   /**< 
-    Every HyperVolume has a _linkedHyperVolumes - if this is empty, this
+    Every HyperVolume has a list of linked HyperVolumes - if this is empty, this
     means the HyperVolume is a true Bin. If not it is part of the binning hierarchy.
     In the below, HyperVolume 0 would be linked to HyperVolume [1,2], although 
-    HyperVolume 4 would be linked to nothing.
+    HyperVolume 4 would be linked to nothing. All the lists are stored back to back,
+    and the list for HyperVolume i runs from _firstLink[i] to _firstLink[i+1] - 1.
 
     ~~~ {.cpp}
     
@@ -129,17 +146,32 @@ class HyperBinningMemRes : public HyperBinning {
     
      | 0 | 1|   2  |   3   |  4  |
     
+    _linkedHyperVolumes = { 1, 2, 3, 4, 5, 6, 7, 8 }
+    _firstLink          = { 0, 2, 4, 6, 8, 8, 8, 8, 8, 8 }
+
     ~~~
 
   */
 
+  std::vector< int > _firstLink;
+  /**< 
+    Index of the first linked HyperVolume of each HyperVolume in _linkedHyperVolumes.
+    This has one more element than there are HyperVolumes.
+  */
+
+  void addHyperCuboid(const double* lowCorner, const double* highCorner);
+  void endHyperVolume(const int* linkedVolumes, int nLinkedVolumes);
+  void updateVolumeLimits(int volumeNumber);
+
+  friend class HyperBinningBuilder;
+
   void setBranchAddresses   (TTree* tree, int* binNumber, double* lowCorner, double* highCorner, std::vector<int>** linkedBins) const;
   
   void loadPrimaryVolumeNumbers(TFile* file);
   
   public:
   
-  HyperBinningMemRes() = default;
+  HyperBinningMemRes();
 
   virtual ~HyperBinningMemRes() = default;
 
@@ -148,12 +180,17 @@ class HyperBinningMemRes : public HyperBinning {
   virtual void setDimension(int dim);
 
   virtual void addPrimaryVolumeNumber(int volumeNumber);
-  virtual bool addHyperVolume(const HyperVolume& hyperVolume, std::vector<int> linkedVolumes = std::vector<int>(0, 0));
+  virtual bool addHyperVolume(const HyperVolume& hyperVolume, const std::vector<int>& linkedVolumes = std::vector<int>(0, 0));
   
   virtual int getNumHyperVolumes() const;  
   virtual HyperVolume getHyperVolume(int volumeNumber) const; /**< get one of the HyperVolumes */
+  virtual HyperCuboid getHyperVolumeLimits(int volumeNumber) const;
   virtual std::vector<int> getLinkedHyperVolumes( int volumeNumber ) const;
 
+  virtual bool inHyperVolume           (int volumeNumber, const HyperPoint& coords) const;
+  virtual int  getNumLinkedHyperVolumes(int volumeNumber) const;
+  virtual int  getLinkedHyperVolume    (int volumeNumber, int i) const;
+
   virtual int getNumPrimaryVolumes  (     ) const;  
   virtual int getPrimaryVolumeNumber(int i) const;  
 
@@ -161,6 +198,7 @@ class HyperBinningMemRes : public HyperBinning {
   //Functions we are required to implement from BinningBase that were not implemented in HyperBinning
 
   virtual void load(TString filename, TString option = "READ");
+  virtual void save(TString filename) const;
 
   virtual BinningBase* clone() const;
 
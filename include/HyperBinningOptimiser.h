@@ -0,0 +1,101 @@
+/**
+ * HyperBinningOptimiser rebuilds the bin hierarchy of a HyperBinning, so
+ * that fewer HyperVolumes are tested to find a bin. The bins themselves
+ * stay exactly the same.
+ *
+ **/
+
+/** \class HyperBinningOptimiser
+
+The hierarchy of a binning scheme reflects the order in which the bins were
+split when the scheme was made. It often has HyperVolumes with a single
+linked HyperVolume, long narrow paths down to a few small bins, and
+HyperVolumes with many linked HyperVolumes, all of which make
+HyperBinning::followBinLinks() test more HyperVolumes than it needs to.
+
+optimise() throws away the HyperVolumes in between the primary volumes and
+the bins, and builds new ones. Below each primary volume, the bins are
+split in two by a plane that no bin crosses, as evenly as possible, and the
+largest group is split again until there are fanOut groups. Each group
+becomes a new HyperVolume, the HyperCuboid that surrounds its bins, and is
+split in the same way until it only holds one bin. Because the groups are
+split by planes, the new HyperVolumes never overlap, and every point ends
+up in the same bin as before. A group that can't be split by any plane
+keeps all its bins as linked HyperVolumes.
+
+If maxDepth is set, there are never more than maxDepth links between a
+primary volume and a bin, and the fan-out is raised where that is needed.
+
+The bins keep their order, so the bin numbers don't change, and a
+HyperHistogram over the new binning can take the bin contents of the old
+one. The primary volumes keep their HyperVolumes, but a primary volume with
+a single bin below it is replaced by that bin.
+
+getLookupCost() counts the HyperVolumes that are tested to reach each bin,
+to compare the binning before and after.
+
+~~~ {.cpp}
+
+  HyperBinningMemRes binning;
+  binning.load("BesOptimEqualV0.root");
+
+  const HyperBinningOptimiser optimiser(4);
+  std::unique_ptr<const HyperBinningMemRes> optimised = optimiser.optimise(binning);
+
+  HyperBinningOptimiser::LookupCost before = HyperBinningOptimiser::getLookupCost(binning);
+  HyperBinningOptimiser::LookupCost after  = HyperBinningOptimiser::getLookupCost(*optimised);
+
+~~~
+
+*/
+
+#ifndef HYPERBINNINGOPTIMISER_HH
+#define HYPERBINNINGOPTIMISER_HH
+
+// HyperPlot includes
+#include "HyperBinning.h"
+#include "HyperBinningMemRes.h"
+
+// Root includes
+
+// std includes
+#include <memory>
+#include <vector>
+
+class HyperBinningOptimiser {
+
+  public:
+
+  struct LookupCost {
+    double averageTests; /**< number of HyperVolumes tested to reach a bin, averaged over the bins */
+    int    maxTests;     /**< largest number of HyperVolumes tested to reach a bin */
+    double averageDepth; /**< number of links between the primary volume and a bin, averaged over the bins */
+    int    maxDepth;     /**< largest number of links between the primary volume and a bin */
+    int    nHierarchy;   /**< number of HyperVolumes that aren't bins */
+  };
+
+  private:
+
+  struct Node {
+    std::vector<double> limits;   /**< low corner followed by high corner of the HyperCuboid surrounding the bins */
+    std::vector<int>    children; /**< linked nodes, or -(volume number + 1) for bins */
+  };
+
+  int _fanOut;   /**< Number of linked HyperVolumes that each new HyperVolume gets, where possible */
+
+  int _maxDepth; /**< Largest number of links between a primary volume and a bin, or 0 for no limit */
+
+  bool splitInTwo(const std::vector<double>& limits, int dim, std::vector<int>& bins, std::vector<int>& otherBins) const;
+  int  buildNode(const std::vector<double>& limits, int dim, std::vector<int>& bins, int depthLeft, std::vector<Node>& nodes) const;
+
+  public:
+
+  HyperBinningOptimiser(int fanOut = 4, int maxDepth = 0);
+
+  std::unique_ptr<const HyperBinningMemRes> optimise(const HyperBinning& binning) const;
+
+  static LookupCost getLookupCost(const HyperBinning& binning);
+
+};
+
+#endif
@@ -14,7 +14,6 @@ class HyperCuboid;
 
 // HyperPlot includes
 #include "HyperPoint.h"
-#include "HyperVolume.h"
 
 // Root includes
 
@@ -52,6 +51,9 @@ class HyperCuboid {
 
   bool        inVolume(const HyperPoint& coords, std::vector<int> dims) const;
 
+  double getVolume() const;
+  static double getVolume(const double* low, const double* high, int dimension);
+
   const HyperPoint& getLowCorner () const{ return _lowCorner ; }
   /**< return the low HyperPoint corner */
   const HyperPoint& getHighCorner() const{ return _highCorner; }
@@ -40,6 +40,7 @@ Binning Algorithm Options:
 
 // Root includes
 #include "TRandom.h"
+#include "TH2D.h"
 
 // std includes
 #include <iostream>
@@ -56,6 +57,8 @@ class HyperHistogram : public HistogramBase {
   
   HyperHistogram(TString filename, TString option = "MEMRES READ");
 
+  HyperHistogram(const BinningBase& binning);
+
   HyperHistogram(const HyperHistogram& other) = delete;
 
   HyperHistogram& operator=(const HyperHistogram& other) = delete;
@@ -64,9 +67,15 @@ class HyperHistogram : public HistogramBase {
   
   virtual double getVal(const HyperPoint& point) const;
 
+  HyperBinningFrozen freeze() const;
+
+  TH2D getSlice(const HyperPoint& point, int dimX, int dimY, int nBinsX = 500, int nBinsY = 500, TString name = "slice") const;
+  static TH2D getSlice(const HyperBinningFrozen& binning, const HyperPoint& point, int dimX, int dimY, int nBinsX = 500, int nBinsY = 500, TString name = "slice");
+
   TString getBinningType(TString filename);
 
   void load     (TString filename, TString option = "MEMRES READ");
+  void save     (TString filename) const;
 
   virtual ~HyperHistogram();
 
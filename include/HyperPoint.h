@@ -14,11 +14,10 @@
 // HyperPlot includes
 
 // Root includes
-#include "TMatrixD.h"
-#include "TRandom.h"
 
 // std includes
 #include <iostream>
+#include <vector>
 
 
 class HyperPoint {
@@ -39,6 +38,8 @@ class HyperPoint {
   //std::vector compatibility
   const double& at(int i) const;
   double& at(int i);
+  const double* data() const {return _coords.data();}
+  /**< pointer to the coordinates, for when looping over them needs to be fast */
 
   HyperPoint & operator= (const HyperPoint & other) = default;
 
@@ -16,6 +16,7 @@ class HyperVolume;
 // HyperPlot includes
 #include "HyperPoint.h"
 #include "HyperCuboid.h"
+#include "CachedVar.h"
 
 // Root includes
 
@@ -30,6 +31,12 @@ class HyperVolume {
 
   std::vector<HyperCuboid> _hyperCuboids;  /**< vector containing HyperCuboids that define the HyperVolume */
 
+  mutable CachedVar<HyperCuboid> _limits;  
+  /**< the HyperCuboid that surrounds all the HyperCuboids. This is updated whenever a
+  HyperCuboid is added, so a HyperPoint outside it can be rejected with a single test. */
+
+  void updateLimits() const;
+
 
   public:
 
@@ -44,10 +51,11 @@ class HyperVolume {
   /**< return the std::vector containing the HyperCuboids */
 
   const HyperCuboid&              at            (int i) const{return _hyperCuboids.at(i);}
-  HyperCuboid&              at            (int i){return _hyperCuboids.at(i);}
+  HyperCuboid&              at            (int i){_limits.changed(); return _hyperCuboids.at(i);}
 
   /**< return one of the HyperCuboids */
 
+  int size() const{return (int)_hyperCuboids.size();}
   /**< return the number of HyperCuboids that make up the HyperVolume */
 
   HyperVolume & operator= (const HyperVolume & other) = delete;
@@ -59,6 +67,8 @@ class HyperVolume {
   
   HyperCuboid getLimits() const;
 
+  void sortHyperCuboids();
+
   ~HyperVolume() = default;
 
 };
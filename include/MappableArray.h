@@ -0,0 +1,190 @@
+/**
+ * MappableArray is an array that either owns its elements, like a
+ * std::vector, or refers to elements that live somewhere else, e.g. in a
+ * shared memory segment. ImageWriter and ImageReader write such arrays
+ * into one contiguous image and map them back out of it.
+ *
+ **/
+
+/** \class MappableArray
+
+The read-only binnings (HyperBinningFrozen and its BoundingVolumeHierarchy)
+store all their arrays as MappableArrays. While they are being built, the
+arrays own their elements and can grow. Once built, they can be written into
+a single contiguous image with an ImageWriter. An ImageReader maps the arrays
+of another binning straight onto such an image, without copying anything, so
+that many processes can share one copy of a binning (see SharedBinning).
+
+Reading a MappableArray costs the same as reading a std::vector. Changing
+a MappableArray that refers to an image first copies its elements, so the
+image itself is never written to.
+
+~~~ {.cpp}
+
+  //count the bytes, then write the image
+  ImageWriter counter;
+  binning.writeImage(counter);
+  std::vector<char> image(counter.getSize());
+  ImageWriter writer(image.data());
+  binning.writeImage(writer);
+
+  //map another binning onto the image
+  ImageReader reader(image.data(), image.size());
+  otherBinning.readImage(reader);
+
+~~~
+
+*/
+
+#ifndef MAPPABLEARRAY_HH
+#define MAPPABLEARRAY_HH
+
+// HyperPlot includes
+
+// Root includes
+
+// std includes
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+template <class T>
+class MappableArray {
+
+  static_assert(std::is_trivially_copyable<T>::value, "MappableArray elements are copied byte by byte");
+
+  private:
+
+  std::vector<T> _owned;  /**< The elements, if they are owned */
+  const T*       _data;   /**< The elements, either _owned.data() or somewhere in an image */
+  std::size_t    _size;   /**< The number of elements */
+  bool           _mapped; /**< Do the elements live in an image? */
+
+  void sync() {_data = _owned.data(); _size = _owned.size(); _mapped = false;}
+  /**< point at the owned elements, after they have changed */
+  void own () {if (_mapped) {_owned.assign(_data, _data + _size); sync();}}
+  /**< take a copy of the elements, before they are changed */
+
+  public:
+
+  MappableArray(std::size_t size = 0) : _owned(size) {sync();}
+  MappableArray(const MappableArray& other) : _owned(other._owned), _data(other._data), _size(other._size), _mapped(other._mapped) {if (!_mapped) sync();}
+  MappableArray(MappableArray&& other) : _owned(std::move(other._owned)), _data(other._data), _size(other._size), _mapped(other._mapped) {if (!_mapped) sync(); other.sync();}
+  MappableArray& operator=(MappableArray other) {_owned.swap(other._owned); _data = other._data; _size = other._size; _mapped = other._mapped; if (!_mapped) sync(); return *this;}
+  MappableArray& operator=(const std::vector<T>& values) {_owned = values; sync(); return *this;}
+
+  std::size_t size () const {return _size;}
+  /**< get the number of elements */
+  bool        empty() const {return _size == 0;}
+  /**< check if there are no elements */
+  bool     isMapped() const {return _mapped;}
+  /**< check if the elements live in an image */
+
+  const T* data      ()              const {return _data;}
+  /**< get the elements */
+  const T& operator[](std::size_t i) const {return _data[i];}
+  /**< get one of the elements */
+  const T* begin     ()              const {return _data;}
+  const T* end       ()              const {return _data + _size;}
+
+  T* data      ()              {own(); return _owned.data();}
+  /**< get the elements, to change them */
+  T& operator[](std::size_t i) {own(); return _owned[i];}
+  /**< get one of the elements, to change it */
+  T* begin     ()              {own(); return _owned.data();}
+  T* end       ()              {own(); return _owned.data() + _size;}
+
+  void push_back(const T& value)               {own(); _owned.push_back(value); sync();}
+  void append   (const T* first, const T* last) {own(); _owned.insert(_owned.end(), first, last); sync();}
+  void resize   (std::size_t size)              {own(); _owned.resize(size); sync();}
+  void reserve  (std::size_t size)              {own(); _owned.reserve(size); sync();}
+  void clear    ()                              {_owned.clear(); sync();}
+
+  void map(const T* data, std::size_t size) {_owned = std::vector<T>(); _data = data; _size = size; _mapped = true;}
+  /**< refer to elements that live somewhere else, and must outlive this MappableArray */
+
+};
+
+class ImageWriter {
+
+  private:
+
+  char*       _image; /**< Where the image is written, or zero if the bytes are only counted */
+  std::size_t _size;  /**< The number of bytes written so far */
+
+  public:
+
+  static const std::size_t Alignment = 64; /**< every array starts on a new cache line */
+
+  ImageWriter(char* image = 0) : _image(image), _size(0) {}
+
+  std::size_t getSize() const {return _size;}
+  /**< get the number of bytes written so far */
+
+  template <class T>
+  void write(const T& value){
+    static_assert(std::is_trivially_copyable<T>::value, "only plain values can be written into an image");
+    if (_image != 0) std::memcpy(_image + _size, &value, sizeof(T));
+    _size += sizeof(T);
+  }
+  /**< write a single value */
+
+  template <class T>
+  void write(const MappableArray<T>& array){
+    write<std::uint64_t>(array.size());
+    std::size_t padding = (Alignment - _size % Alignment) % Alignment;
+    if (_image != 0) std::memset(_image + _size, 0, padding);
+    _size += padding;
+    if (_image != 0 && array.size() != 0) std::memcpy(_image + _size, array.data(), array.size()*sizeof(T));
+    _size += array.size()*sizeof(T);
+  }
+  /**< write the size of an array, then its elements, starting on a new cache line */
+
+};
+
+class ImageReader {
+
+  private:
+
+  const char* _image;    /**< The image, which must start on a cache line */
+  std::size_t _size;     /**< The size of the image in bytes */
+  std::size_t _position; /**< The number of bytes read so far */
+  bool        _ok;       /**< Have all reads so far stayed inside the image? */
+
+  public:
+
+  ImageReader(const char* image, std::size_t size) : _image(image), _size(size), _position(0), _ok(true) {}
+
+  bool isOk() const {return _ok;}
+  /**< check that nothing was read from beyond the end of the image */
+  std::size_t getPosition() const {return _position;}
+  /**< get the number of bytes read so far */
+
+  template <class T>
+  bool read(T& value){
+    static_assert(std::is_trivially_copyable<T>::value, "only plain values can be read from an image");
+    if (_ok == false || _size - _position < sizeof(T)) return _ok = false;
+    std::memcpy(&value, _image + _position, sizeof(T));
+    _position += sizeof(T);
+    return true;
+  }
+  /**< read a single value */
+
+  template <class T>
+  bool read(MappableArray<T>& array){
+    std::uint64_t n = 0;
+    if (read(n) == false) return false;
+    _position += (ImageWriter::Alignment - _position % ImageWriter::Alignment) % ImageWriter::Alignment;
+    if (_position > _size || n > (_size - _position)/sizeof(T)) return _ok = false;
+    array.map(reinterpret_cast<const T*>(_image + _position), n);
+    _position += n*sizeof(T);
+    return true;
+  }
+  /**< map an array onto the image, without copying it */
+
+};
+
+#endif
@@ -0,0 +1,99 @@
+/**
+ * MigrationMatrix counts how events migrate between bins, when each event
+ * is binned once with its true and once with its reconstructed coordinates.
+ *
+ **/
+
+/** \class MigrationMatrix
+
+For resolution studies, every event is binned twice, and the migration
+matrix counts the events for each pair of (true, reconstructed) bins. Only
+a small fraction of the pairs is ever filled, so the matrix is sparse, and
+only the pairs that have been filled are stored.
+
+fill() takes a batch of true and a batch of reconstructed coordinates,
+looks them up with a ParallelBinner, and adds them to the matrix on the
+same threads. It can be called as often as needed, e.g. once per file. The
+matrix is indexed either by bin number, where -1 is outside the binning, or
+by bin label (see HyperBinningFrozen::getLabel()).
+
+fill() can also return the distance from each true and reconstructed point
+to the nearest boundary of its bin, which is worked out from the result of
+the same lookup (see HyperBinningFrozen::getDistanceToBoundary()).
+
+~~~ {.cpp}
+
+  const ParallelBinner parallelBinner(binning, 8);
+  MigrationMatrix migrationMatrix(parallelBinner, MigrationMatrix::Labels);
+  migrationMatrix.fill(TrueCoordinates.data(), RecoCoordinates.data(), NumberEvents);
+  for (const MigrationMatrix::Entry& entry : migrationMatrix.getEntries()){
+    std::cout << entry.trueIndex << " -> " << entry.recoIndex << " : " << entry.nEvents << std::endl;
+  }
+
+~~~
+
+*/
+
+#ifndef MIGRATIONMATRIX_HH
+#define MIGRATIONMATRIX_HH
+
+// HyperPlot includes
+#include "ParallelBinner.h"
+
+// Root includes
+
+// std includes
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class MigrationMatrix {
+
+  public:
+
+  enum Index {
+    BinNumbers, /**< the matrix is indexed by bin number */
+    Labels      /**< the matrix is indexed by bin label */
+  };
+
+  struct Entry {
+    int       trueIndex; /**< bin number or label of the true coordinates */
+    int       recoIndex; /**< bin number or label of the reconstructed coordinates */
+    long long nEvents;   /**< number of events */
+    double    sumW;      /**< sum of the event weights */
+    double    sumW2;     /**< sum of the squared event weights */
+  };
+
+  private:
+
+  typedef std::unordered_map<std::uint64_t, Entry> Cells;
+
+  const ParallelBinner& _binner; /**< Used for the lookups, must outlive the MigrationMatrix */
+
+  Index _index;                  /**< How the matrix is indexed */
+
+  Cells _cells;                  /**< The filled (true, reconstructed) pairs */
+
+  int getIndex(const HyperBinningFrozen& binning, int volumeNumber) const;
+  static std::uint64_t getKey(int trueIndex, int recoIndex);
+
+  public:
+
+  MigrationMatrix(const ParallelBinner& binner, Index index = BinNumbers);
+
+  void fill(const double* trueCoords, const double* recoCoords, int nPoints, const double* weights = 0,
+            double* trueDistances = 0, double* recoDistances = 0);
+  void clear() {_cells.clear();}
+  /**< remove all the events */
+
+  Index getIndex() const {return _index;}
+  /**< get how the matrix is indexed */
+  int getNumEntries() const {return _cells.size();}
+  /**< get the number of (true, reconstructed) pairs that have been filled */
+
+  Entry getEntry(int trueIndex, int recoIndex) const;
+  std::vector<Entry> getEntries() const;
+
+};
+
+#endif
@@ -0,0 +1,97 @@
+/**
+ * Looks up the bins of a batch of points on several threads, using a
+ * HyperBinningFrozen.
+ *
+ * In the Chunked schedule, the batch is split into chunks that the threads
+ * take in turn, and every thread walks the whole bin hierarchy. For a large
+ * binning, each core then ends up pulling all of it into its own cache.
+ *
+ * In the SubtreeAffinity schedule, the hierarchy below the primary volumes
+ * is cut into subtrees when the ParallelBinner is made, splitting the 
+ * largest subtree until there are at least eight per thread. A lookup 
+ * first routes every point down to the root of its subtree, which only
+ * touches the top of the hierarchy, and sorts the points by subtree. 
+ * Each thread is then given a contiguous range of subtrees, with about the
+ * same number of points, and finishes the lookups of those points only. 
+ * Each core therefore only needs its own part of the binning in its cache.
+ *
+ * Made from a ReplicatedBinning, every thread uses the copy of the binning
+ * on its own NUMA node.
+ *
+ * Both schedules give the same results as HyperBinningFrozen::getVolumeNumber.
+ * Binnings without primary volumes have no hierarchy to split, and always 
+ * use the Chunked schedule.
+ **/
+
+#ifndef PARALLELBINNER_HH
+#define PARALLELBINNER_HH
+
+// HyperPlot includes
+#include "HyperBinningFrozen.h"
+#include "ReplicatedBinning.h"
+
+// Root includes
+
+// std includes
+#include <vector>
+
+class ParallelBinner {
+
+  public:
+
+  enum Schedule {
+    Chunked,        /**< every thread looks up chunks of the batch in turn */
+    SubtreeAffinity /**< every thread looks up the points in its own subtrees */
+  };
+
+  private:
+
+  const HyperBinningFrozen& _binning; /**< The binning, which must outlive the ParallelBinner */
+
+  const ReplicatedBinning* _replicas; /**< Copies of the binning on each NUMA node, or zero */
+
+  int _nThreads;                      /**< Number of worker threads */
+
+  Schedule _schedule;                 /**< How the work is split between threads */
+
+  int _chunkSize;                     /**< Number of points in each chunk */
+
+  int _groupSize;                     /**< Group size of the batch lookups in the Chunked schedule */
+
+  std::vector<int> _subtreeRoots;     /**< The HyperVolume at the root of each subtree */
+
+  std::vector<int> _subtreeNumber;    /**< The subtree rooted at each HyperVolume, or -1 */
+
+  void makeSubtrees();
+  int  routePoint(const HyperBinningFrozen& binning, const double* coords, int& volumeNumber) const;
+
+  void getVolumeNumbersChunked(const double* coords, int nPoints, int* volumeNumbers) const;
+  void getVolumeNumbersSubtree(const double* coords, int nPoints, int* volumeNumbers) const;
+
+  public:
+
+  ParallelBinner(const HyperBinningFrozen& binning, int nThreads = 0, Schedule schedule = SubtreeAffinity, int chunkSize = 10000);
+  ParallelBinner(const ReplicatedBinning& binning, int nThreads = 0, Schedule schedule = SubtreeAffinity, int chunkSize = 10000);
+
+  int getNumThreads () const {return _nThreads;}
+  /**< get the number of worker threads */
+  int getChunkSize  () const {return _chunkSize;}
+  /**< get the number of points in each chunk */
+  Schedule getSchedule() const {return _subtreeRoots.size() == 0 ? Chunked : _schedule;}
+  /**< get the schedule that is used, which is Chunked if the binning can't be split */
+  int getNumSubtrees() const {return _subtreeRoots.size();}
+  /**< get the number of subtrees in the SubtreeAffinity schedule */
+
+  const HyperBinningFrozen& getLocalBinning() const {return _replicas == 0 ? _binning : _replicas->getBinning();}
+  /**< get the copy of the binning on the NUMA node of the calling thread */
+
+  void setGroupSize(int groupSize) {_groupSize = groupSize;}
+  /**< set the group size of the batch lookups, see HyperBinningFrozen::getVolumeNumbers() */
+
+  void getVolumeNumbers(const double* coords, int nPoints, int* volumeNumbers) const;
+  void getBinNums      (const double* coords, int nPoints, int* binNumbers   ) const;
+  void getLabels       (const double* coords, int nPoints, int* labels       ) const;
+
+};
+
+#endif
@@ -0,0 +1,53 @@
+/**
+ * Generator of flat N-body phase space, using the same (Raubold-Lynch)
+ * algorithm as TGenPhaseSpace. Unlike TGenPhaseSpace, which always draws
+ * from gRandom, the random number generator is passed in explicitly so that
+ * each thread can run with its own independent and reproducible stream.
+ */
+
+#ifndef PHASESPACEGENERATOR_HH
+#define PHASESPACEGENERATOR_HH
+
+// Root includes
+#include "TLorentzVector.h"
+#include "TRandom.h"
+
+// std includes
+#include <vector>
+
+class PhaseSpaceGenerator {
+
+  private:
+
+  TLorentzVector _parent;            /**< Four-momentum of the decaying particle */
+
+  std::vector<double> _masses;       /**< Masses of the daughters */
+
+  double _kineticEnergy;             /**< Energy available after the daughter masses are subtracted */
+
+  double _maxWeight;                 /**< Inverse of the maximum weight, used to normalise the weights to at most one */
+
+  std::vector<TLorentzVector> _daughters; /**< Four-momenta of the last generated event */
+  
+  std::vector<double> _random;       /**< Work space for the sorted random numbers */
+  std::vector<double> _invMass;      /**< Work space for the intermediate invariant masses */
+  std::vector<double> _momentum;     /**< Work space for the intermediate two-body momenta */
+
+  static double twoBodyMomentum(double a, double b, double c);
+
+  public:
+
+  PhaseSpaceGenerator(const TLorentzVector& parent, const std::vector<double>& masses);
+
+  double generate(TRandom& random);
+  /**< generate an event and return its weight (between zero and one) */
+
+  const TLorentzVector& getDecay(int i) const {return _daughters[i];}
+  /**< get the four-momentum of daughter i in the last generated event */
+
+  int getNumDaughters() const {return (int)_masses.size();}
+  /**< get the number of daughters */
+
+};
+
+#endif
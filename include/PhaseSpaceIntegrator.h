@@ -0,0 +1,91 @@
+/**
+ * Integrates D -> pi+ pi+ pi- pi- phase space over each bin of a binning
+ * scheme. Weighted phase space events are generated in parallel, and binned
+ * using a HyperHistogram, where the bin contents are the bin numbers.
+ *
+ * The events are generated in chunks of fixed size, and each chunk has its
+ * own random number stream, seeded from the global seed and the chunk
+ * index. The chunk results are summed in chunk order, so the result for a
+ * given seed does not depend on the number of threads.
+ **/
+
+#ifndef PHASESPACEINTEGRATOR_HH
+#define PHASESPACEINTEGRATOR_HH
+
+// HyperPlot includes
+#include "HyperHistogram.h"
+
+// Root includes
+
+// std includes
+#include <map>
+#include <vector>
+
+/**
+ * The sum of weights, the sum of weights squared, and number of events
+ * that fall in a bin
+ */
+struct PhaseSpaceBinSum {
+  double    sumW   = 0.0;
+  double    sumW2  = 0.0;
+  long long nEvents = 0;
+  PhaseSpaceBinSum& operator+=(const PhaseSpaceBinSum& other);
+};
+
+class PhaseSpaceIntegral {
+
+  private:
+
+  long long _nGenerated;                     /**< Number of generated events */
+
+  std::map<int, PhaseSpaceBinSum> _binSums;  /**< Sums for each (signed) bin number */
+
+  PhaseSpaceBinSum _total;                   /**< Sums over all bins */
+
+  public:
+
+  PhaseSpaceIntegral();
+
+  void add(int binNumber, const PhaseSpaceBinSum& binSum);
+  void addGenerated(long long nGenerated);
+
+  long long getNumGenerated() const {return _nGenerated;}
+  /**< get the number of generated events */
+
+  std::vector<int> getBinNumbers() const;
+
+  const PhaseSpaceBinSum& getBinSum(int binNumber) const;
+  const PhaseSpaceBinSum& getTotal() const {return _total;}
+  /**< get the sums over all bins */
+
+  double getIntegral     (int binNumber) const;
+  double getIntegralError(int binNumber) const;
+
+  double getFraction     (int binNumber) const;
+  double getFractionError(int binNumber) const;
+
+};
+
+class PhaseSpaceIntegrator {
+
+  private:
+
+  const HyperHistogram& _hyperHistogram; /**< Binning scheme, where the bin contents are the bin numbers */
+
+  int _nThreads;                         /**< Number of worker threads */
+
+  int _chunkSize;                        /**< Number of events generated with each random number stream */
+
+  PhaseSpaceIntegral integrateChunk(long long nEvents, unsigned int seed) const;
+
+  public:
+
+  PhaseSpaceIntegrator(const HyperHistogram& hyperHistogram, int nThreads = 0, int chunkSize = 100000);
+
+  static unsigned int getChunkSeed(unsigned int seed, long long chunk);
+
+  PhaseSpaceIntegral integrate(long long nEvents, unsigned int seed) const;
+
+};
+
+#endif
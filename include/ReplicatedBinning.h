@@ -0,0 +1,99 @@
+/**
+ * ReplicatedBinning keeps one copy of a HyperBinningFrozen in the memory
+ * of each NUMA node, backed by transparent huge pages where possible.
+ *
+ **/
+
+/** \class ReplicatedBinning
+
+On a machine with several sockets, memory belongs to the NUMA node of one
+socket, and threads on the other sockets pay a higher latency for every
+level of the bin hierarchy they walk. A ReplicatedBinning writes the image
+of a binning (see HyperBinningFrozen::writeImage()) once into the memory of
+every NUMA node, and getBinning() hands each thread the copy on its own
+node. The copies are placed with mbind() before they are first written,
+with a preferred policy, so a node that is out of memory falls back to its
+neighbours instead of failing.
+
+The copies are also aligned to 2 MB and advised to use transparent huge
+pages, so that a large binning needs far fewer TLB entries. Whether the
+kernel actually gives huge pages depends on its settings, and
+getHugePageBytes() tells how much of a copy ended up on them. Without huge
+pages, the copies are advised against them instead, so that they can be
+compared with copies on small pages even where the kernel uses huge pages
+for everything.
+
+On a machine with a single NUMA node, or where mbind() isn't allowed, e.g.
+in some containers, there is a single copy, or the copies are simply not
+bound, and everything still works. Each copy is read-only once written.
+
+~~~ {.cpp}
+
+  const ReplicatedBinning replicatedBinning(binning);
+  const ParallelBinner parallelBinner(replicatedBinning, 32);
+  parallelBinner.getLabels(Coordinates.data(), NumberEvents, Labels.data());
+
+  //or, from any thread
+  const int Label = replicatedBinning.getBinning().getLabel(Coords);
+
+~~~
+
+*/
+
+#ifndef REPLICATEDBINNING_HH
+#define REPLICATEDBINNING_HH
+
+// HyperPlot includes
+#include "HyperBinningFrozen.h"
+
+// Root includes
+
+// std includes
+#include <cstddef>
+#include <vector>
+
+class ReplicatedBinning {
+
+  private:
+
+  struct Replica {
+    int                node;     /**< NUMA node that the copy was placed on */
+    void*              memory;   /**< Where the copy is mapped */
+    std::size_t        size;     /**< Size of the mapping in bytes */
+    bool               isBound;  /**< Was the copy placed with mbind()? */
+    HyperBinningFrozen binning;  /**< The binning, mapped onto the copy */
+  };
+
+  static const std::size_t _hugePageSize = 2*1024*1024; /**< the copies are aligned to this */
+
+  std::vector<Replica> _replicas;      /**< One copy for each NUMA node */
+  std::vector<int>     _replicaOfNode; /**< The copy used by each NUMA node, or -1 */
+
+  bool makeReplica(const HyperBinningFrozen& binning, int node, bool bind, bool hugePages);
+
+  public:
+
+  ReplicatedBinning(const HyperBinningFrozen& binning, bool replicate = true, bool hugePages = true);
+  ~ReplicatedBinning();
+
+  ReplicatedBinning(const ReplicatedBinning&) = delete;
+  ReplicatedBinning& operator=(const ReplicatedBinning&) = delete;
+
+  int getNumReplicas() const {return _replicas.size();}
+  /**< get the number of copies, which is one per NUMA node if they are replicated */
+  int getReplicaNode(int replica) const {return _replicas[replica].node;}
+  /**< get the NUMA node that a copy was placed on */
+  bool isBound(int replica) const {return _replicas[replica].isBound;}
+  /**< check if a copy was placed on its NUMA node with mbind() */
+  std::size_t getHugePageBytes(int replica) const;
+
+  const HyperBinningFrozen& getBinning(int replica) const {return _replicas[replica].binning;}
+  /**< get one of the copies */
+  const HyperBinningFrozen& getBinning() const;
+
+  static std::vector<int> getNumaNodes();
+  static int getCurrentNode();
+
+};
+
+#endif
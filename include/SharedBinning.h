@@ -0,0 +1,139 @@
+/**
+ * SharedBinning shares one HyperBinningFrozen between all the processes on
+ * a machine, through a named POSIX shared memory segment.
+ *
+ **/
+
+/** \class SharedBinning
+
+When one single-threaded process is run per core, every process usually
+loads its own copy of the binning. With a SharedBinning, the first process
+publishes the binning into a named shared memory segment, and the others
+attach to it read-only. The binning is then held in memory once per machine,
+and only the first process pays for loading it.
+
+The segment holds a small header followed by the image of the binning (see
+HyperBinningFrozen::writeImage()). Attaching maps the image and points the
+arrays of a HyperBinningFrozen at it, so nothing is copied, and lookups on
+the attached binning are as fast as on the original.
+
+ - Versions: the header records the layout of the segment and of the image,
+   so a process never attaches to a segment written by an incompatible
+   build. It also records a version number chosen by the user, e.g. a
+   version of the binning scheme, and attaching checks that it matches.
+ - Reference counting: every attached process holds a shared lock on the
+   segment. When a process detaches and finds that no other process holds
+   a lock, it removes the segment. Locks are released by the operating
+   system when a process exits, so a process that crashes is never counted.
+ - Crash safety: the segment is written while holding an exclusive lock,
+   and is only marked as ready once it is complete. Processes that attach
+   in the meantime wait for the lock, or, in the moment between creating
+   the segment and locking it, for the segment to grow. If a process finds
+   the segment gone once it holds the lock, it starts again. A segment
+   left behind half-written, or retired but not removed, by a process that
+   crashed is never attached to, and attachOrPublish() replaces it.
+
+~~~ {.cpp}
+
+  SharedBinning sharedBinning;
+  sharedBinning.attachOrPublish("/BesOptimEqualV0", [](){ return HyperHistogram("BesOptimEqualV0.root").freeze(); });
+  const HyperBinningFrozen& binning = sharedBinning.getBinning();
+
+~~~
+
+The binning returned by getBinning() is only valid while the SharedBinning
+is attached. Segments are named like files in /dev/shm, with a leading
+slash, and are only shared between processes of the same user.
+
+*/
+
+#ifndef SHAREDBINNING_HH
+#define SHAREDBINNING_HH
+
+// HyperPlot includes
+#include "HyperBinningFrozen.h"
+
+// Root includes
+
+// std includes
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+class SharedBinning {
+
+  private:
+
+  struct Header {
+    char          magic[8];      /**< always "HBSHARED" */
+    std::uint32_t formatVersion; /**< SharedBinning::FormatVersion of the process that wrote the segment */
+    std::uint32_t imageVersion;  /**< HyperBinningFrozen::ImageVersion of the process that wrote the segment */
+    std::uint64_t version;       /**< version number chosen by the user */
+    std::uint64_t imageSize;     /**< size of the image in bytes */
+    std::uint32_t state;         /**< Writing, Ready or Retired */
+  };
+
+  enum State {
+    Writing = 1, /**< the segment is being written */
+    Ready   = 2, /**< the segment is complete */
+    Retired = 3  /**< the segment has been removed, and is about to disappear */
+  };
+
+  enum Status {
+    Attached,     /**< attached to a ready segment */
+    Missing,      /**< there is no segment, or it has just been removed */
+    Stale,        /**< the segment was left behind half-written */
+    WrongVersion, /**< the segment holds a different version, or was written by an incompatible build */
+    Failed        /**< something else went wrong */
+  };
+
+  static const std::size_t _imageOffset = 4096; /**< the image starts on the page after the header */
+  static const int _creatingTimeout = 1000;     /**< milliseconds a segment can be smaller than the header before it counts as stale */
+
+  std::string        _name;        /**< Name of the segment */
+  int                _fd;          /**< File descriptor of the segment, which holds the lock */
+  void*              _segment;     /**< Where the segment is mapped */
+  std::size_t        _segmentSize; /**< Size of the segment in bytes */
+  std::uint64_t      _version;     /**< Version number of the binning */
+  bool               _isPublisher; /**< Did this process write the segment? */
+  HyperBinningFrozen _binning;     /**< The binning, mapped onto the segment */
+
+  Status open   (const std::string& name, std::uint64_t version);
+  bool   create (const std::string& name, const HyperBinningFrozen& binning, std::uint64_t version, bool& exists);
+  bool   mapImage();
+  void   release();
+  static bool removeIfUnused(int fd, const std::string& name);
+  static bool hasName(int fd, const std::string& name);
+
+  public:
+
+  static constexpr std::uint32_t FormatVersion = 1; /**< changes whenever the layout of the header changes */
+
+  SharedBinning();
+  ~SharedBinning();
+
+  SharedBinning(const SharedBinning&) = delete;
+  SharedBinning& operator=(const SharedBinning&) = delete;
+
+  bool publish(const std::string& name, const HyperBinningFrozen& binning, std::uint64_t version = 0);
+  bool attach (const std::string& name, std::uint64_t version = 0);
+  bool attachOrPublish(const std::string& name, const std::function<HyperBinningFrozen()>& makeBinning, std::uint64_t version = 0);
+  void detach ();
+
+  static bool remove(const std::string& name);
+
+  bool isAttached () const {return _segment != 0;}
+  /**< check if a segment is attached */
+  bool isPublisher() const {return _isPublisher;}
+  /**< check if this process wrote the attached segment */
+  const std::string& getName() const {return _name;}
+  /**< get the name of the attached segment */
+  std::uint64_t getVersion() const {return _version;}
+  /**< get the version number of the attached binning */
+  const HyperBinningFrozen& getBinning() const {return _binning;}
+  /**< get the attached binning, which is only valid while it is attached */
+
+};
+
+#endif
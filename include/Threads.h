@@ -0,0 +1,27 @@
+/**
+ * Runs work on several threads, one of which is the calling thread, for the
+ * classes that split their work between threads (ParallelBinner,
+ * MigrationMatrix, BinAdjacency, BinSampler, BinningValidator and
+ * BinningDiff).
+ *
+ **/
+
+#ifndef THREADS_HH
+#define THREADS_HH
+
+// HyperPlot includes
+
+// Root includes
+
+// std includes
+#include <functional>
+
+namespace Threads {
+
+  int  getNumThreads(int nThreads);
+  void runThreads(int nThreads, const std::function<void(int)>& work);
+  void runThreads(int nThreads, int nChunks, const std::function<void(int, int)>& work);
+
+}
+
+#endif
@@ -8,6 +8,7 @@
 
 #include<array>
 #include"TLorentzVector.h"
+#include"HyperPoint.h"
 
 namespace Utilities {
   /**
@@ -24,6 +25,17 @@ namespace Utilities {
   double getCosTheta(TLorentzVector particle,
 		     const TLorentzVector &parent,
 		     TLorentzVector grandparent);
+  /**
+   * Calculate the five coordinates used by the binning scheme, folded
+   * so that cosThetaPlus > 0, cosThetaMinus > 0 and phi > 0
+   * @param daughters 4-momentum of the daughters in the order pi+ pi+ pi- pi-
+   * @param parent 4-momentum of the D meson
+   * @param hyperPoint 5D point that is filled with (mPlus', mMinus', cosThetaPlus, cosThetaMinus, phi)
+   * @return True if phi was flipped, in which case the bin number is negative
+   */
+  bool getBinningCoordinates(const std::array<TLorentzVector, 4> &daughters,
+			     const TLorentzVector &parent,
+			     HyperPoint &hyperPoint);
 };
 
 #endif
@@ -0,0 +1,102 @@
+#include "AsyncBinning.h"
+
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+
+///Start loading a binning on a background thread, by calling makeBinning
+///there. makeBinning must not depend on anything that is destroyed before
+///the load finishes.
+AsyncBinning::AsyncBinning(const std::function<HyperBinningFrozen()>& makeBinning) :
+  _isReady (false),
+  _loadTime(0.0),
+  _waitTime(0.0)
+{
+
+  _future = std::async(std::launch::async, [this, makeBinning](){
+    auto start = std::chrono::steady_clock::now();
+    try {
+      HyperBinningFrozen binning = makeBinning();
+      _loadTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      _isReady = true;
+      return binning;
+    }
+    catch (...){
+      _loadTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      _isReady = true;
+      throw;
+    }
+  });
+
+}
+
+///Start loading a binary scheme file on a background thread. If the file
+///can't be loaded, getBinning() throws a std::runtime_error.
+AsyncBinning::AsyncBinning(const std::string& filename) :
+  AsyncBinning([filename](){
+    HyperBinningFrozen binning;
+    if (binning.load(filename) == false){
+      throw std::runtime_error("AsyncBinning - could not load " + filename);
+    }
+    return binning;
+  })
+{
+
+}
+
+///Destructor. The load still running on the background thread writes to
+///the members, so it has to finish before they are destroyed.
+AsyncBinning::~AsyncBinning(){
+
+  if (_future.valid()) _future.wait();
+
+}
+
+///Wait for the load to finish, if that hasn't been done yet, and keep the
+///binning, or the exception that makeBinning threw
+void AsyncBinning::wait() const{
+
+  std::call_once(_waited, [this](){
+    auto start = std::chrono::steady_clock::now();
+    try {
+      _binning = _future.get();
+    }
+    catch (...){
+      _error = std::current_exception();
+    }
+    _waitTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  });
+
+}
+
+///Get the binning. The first call waits for the load to finish, if it
+///hasn't already, and all calls after that return at once. This can be
+///called from several threads, which then all wait for the same load.
+///If makeBinning threw an exception, every call throws it again.
+const HyperBinningFrozen& AsyncBinning::getBinning() const{
+
+  wait();
+  if (_error) std::rethrow_exception(_error);
+  return _binning;
+
+}
+
+///Get the time the load took on the background thread, in seconds. This
+///waits for the load to finish.
+double AsyncBinning::getLoadTime() const{
+
+  wait();
+  return _loadTime;
+
+}
+
+///Get the time that getBinning() spent waiting for the load, in seconds.
+///This is zero if the load had finished before the binning was first
+///needed, and otherwise the part of the load that wasn't hidden. If the
+///binning hasn't been asked for yet, this waits for it, which then counts.
+double AsyncBinning::getWaitTime() const{
+
+  wait();
+  return _waitTime;
+
+}
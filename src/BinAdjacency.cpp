@@ -0,0 +1,240 @@
+#include "BinAdjacency.h"
+
+#include "Threads.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+///Construct an empty BinAdjacency
+///
+BinAdjacency::BinAdjacency() :
+  _fingerprint(0)
+{
+
+}
+
+///Build the graph of a binning, see build()
+///
+BinAdjacency::BinAdjacency(const HyperBinningFrozen& binning, int nThreads) :
+  _fingerprint(0)
+{
+  build(binning, nThreads);
+}
+
+///Find the faces that a bin shares with the bins on the low side of it. The
+///faces on its high side are found from the other bin, so every face is
+///found exactly once. The region query over each HyperCuboid includes the
+///low faces of the HyperCuboid, but not the volumes just above its high faces.
+void BinAdjacency::findFaces(const HyperBinningFrozen& binning, int volumeNumber, std::vector<int>& candidates, std::vector<Face>& faces) const{
+
+  const int dim = binning.getDimension();
+  const int bin = binning.getBinNum(volumeNumber);
+
+  for (int c = 0; c < binning.getNumHyperCuboids(volumeNumber); c++){
+
+    const double* low  = binning.getLowCorner (volumeNumber, c);
+    const double* high = binning.getHighCorner(volumeNumber, c);
+    binning.getVolumesInRegion(low, high, candidates);
+
+    for (int other : candidates){
+      if (other == volumeNumber) continue;
+
+      for (int o = 0; o < binning.getNumHyperCuboids(other); o++){
+        const double* otherLow  = binning.getLowCorner (other, o);
+        const double* otherHigh = binning.getHighCorner(other, o);
+
+        //The other HyperCuboid must end where this one begins in exactly one
+        //dimension, and overlap it with a non-zero width in all the others
+        int    dimension = -1;
+        double area      = 1.0;
+        for (int d = 0; d < dim && area > 0.0; d++){
+          if (otherHigh[d] == low[d] && dimension == -1) { dimension = d; continue; }
+          area *= std::min(high[d], otherHigh[d]) - std::max(low[d], otherLow[d]);
+        }
+        if (dimension == -1 || !(area > 0.0)) continue;
+
+        faces.push_back(Face{bin, binning.getBinNum(other), dimension, area});
+      }
+    }
+
+  }
+
+}
+
+///Build the graph of a binning on nThreads threads, or on one thread per
+///core if nThreads is zero
+void BinAdjacency::build(const HyperBinningFrozen& binning, int nThreads){
+
+  nThreads = Threads::getNumThreads(nThreads);
+
+  const int nBins = binning.getNumBins();
+
+  std::vector<int> volumeOfBin(nBins, -1);
+  for (int volumeNumber = 0; volumeNumber < binning.getNumHyperVolumes(); volumeNumber++){
+    int bin = binning.getBinNum(volumeNumber);
+    if (bin != -1) volumeOfBin[bin] = volumeNumber;
+  }
+
+  //Each thread takes chunks of bins in turn, and keeps its own faces
+
+  const int chunkSize = 256;
+  const int nChunks   = (nBins + chunkSize - 1)/chunkSize;
+  nThreads = std::max(1, std::min(nThreads, nChunks));
+
+  std::vector<std::vector<Face>> threadFaces(nThreads);
+
+  Threads::runThreads(nThreads, nChunks, [&](int thread, int chunk) {
+    std::vector<int> candidates;
+    for (int bin = chunk*chunkSize; bin < std::min(nBins, (chunk + 1)*chunkSize); bin++){
+      findFaces(binning, volumeOfBin[bin], candidates, threadFaces[thread]);
+    }
+  });
+
+  //Every face goes into the graph from both sides. Faces between the same
+  //two bins in the same dimension, from different HyperCuboids, are merged
+
+  std::vector<Face> faces;
+  for (const std::vector<Face>& thisFaces : threadFaces){
+    for (const Face& face : thisFaces){
+      faces.push_back(face);
+      faces.push_back(Face{face.neighbour, face.bin, face.dimension, face.area});
+    }
+  }
+  threadFaces.clear();
+
+  std::sort(faces.begin(), faces.end(), [](const Face& a, const Face& b){
+    if (a.bin       != b.bin      ) return a.bin       < b.bin;
+    if (a.neighbour != b.neighbour) return a.neighbour < b.neighbour;
+    return a.dimension < b.dimension;
+  });
+
+  _fingerprint = binning.getFingerprint();
+  _firstNeighbour.assign(nBins + 1, 0);
+  _neighbours    .clear();
+  _faceDimensions.clear();
+  _faceAreas     .clear();
+
+  for (unsigned i = 0; i < faces.size(); i++){
+    const Face& face = faces[i];
+    if (i > 0 && face.bin == faces[i - 1].bin && face.neighbour == faces[i - 1].neighbour && face.dimension == faces[i - 1].dimension){
+      _faceAreas.back() += face.area;
+      continue;
+    }
+    _firstNeighbour[face.bin + 1]++;
+    _neighbours    .push_back(face.neighbour);
+    _faceDimensions.push_back(face.dimension);
+    _faceAreas     .push_back(face.area);
+  }
+  for (int bin = 0; bin < nBins; bin++) _firstNeighbour[bin + 1] += _firstNeighbour[bin];
+
+}
+
+namespace {
+
+  const char FileMagic[8] = {'H', 'B', 'A', 'D', 'J', 'A', 'C', 'Y'};
+
+  template <class T>
+  void writeArray(std::ofstream& file, const std::vector<T>& array){
+    std::uint64_t size = array.size();
+    file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    file.write(reinterpret_cast<const char*>(array.data()), array.size()*sizeof(T));
+  }
+
+  template <class T>
+  bool readArray(std::ifstream& file, std::vector<T>& array, std::uint64_t maxSize){
+    std::uint64_t size = 0;
+    if (!file.read(reinterpret_cast<char*>(&size), sizeof(size)) || size > maxSize) return false;
+    array.resize(size);
+    return (bool)file.read(reinterpret_cast<char*>(array.data()), size*sizeof(T));
+  }
+
+}
+
+///Save the graph into a binary file, e.g. next to the binning file
+///
+bool BinAdjacency::save(const std::string& filename) const{
+
+  std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+
+  file.write(FileMagic, sizeof(FileMagic));
+  file.write(reinterpret_cast<const char*>(&FileVersion ), sizeof(FileVersion ));
+  file.write(reinterpret_cast<const char*>(&_fingerprint), sizeof(_fingerprint));
+  writeArray(file, _firstNeighbour);
+  writeArray(file, _neighbours    );
+  writeArray(file, _faceDimensions);
+  writeArray(file, _faceAreas     );
+  file.close();
+
+  if (!file){
+    std::cerr << "BinAdjacency::save - could not write " << filename << std::endl;
+    return false;
+  }
+  return true;
+
+}
+
+///Load a graph saved by save(). Fails (and leaves the graph unchanged) if
+///the file doesn't exist, is damaged, or belongs to a different binning.
+bool BinAdjacency::load(const std::string& filename, const HyperBinningFrozen& binning){
+
+  std::ifstream file(filename, std::ios::binary);
+  if (!file) return false;
+
+  char          magic[8]    = {0};
+  std::uint32_t version     = 0;
+  std::uint64_t fingerprint = 0;
+  file.read(magic, sizeof(magic));
+  file.read(reinterpret_cast<char*>(&version    ), sizeof(version    ));
+  file.read(reinterpret_cast<char*>(&fingerprint), sizeof(fingerprint));
+
+  if (!file || std::memcmp(magic, FileMagic, sizeof(magic)) != 0 || version != FileVersion){
+    std::cerr << "BinAdjacency::load - " << filename << " is not a bin adjacency file of this version" << std::endl;
+    return false;
+  }
+  if (fingerprint != binning.getFingerprint()){
+    std::cerr << "BinAdjacency::load - " << filename << " belongs to a different binning" << std::endl;
+    return false;
+  }
+
+  //Read into a copy, and check that it is consistent before using it
+
+  BinAdjacency adjacency;
+  adjacency._fingerprint = fingerprint;
+  const std::uint64_t nBins = binning.getNumBins();
+  bool isOk = readArray(file, adjacency._firstNeighbour, nBins + 1) && adjacency._firstNeighbour.size() == nBins + 1;
+  const std::uint64_t nFaces = isOk ? adjacency._firstNeighbour.back() : 0;
+  isOk = isOk && readArray(file, adjacency._neighbours    , nFaces) && adjacency._neighbours    .size() == nFaces;
+  isOk = isOk && readArray(file, adjacency._faceDimensions, nFaces) && adjacency._faceDimensions.size() == nFaces;
+  isOk = isOk && readArray(file, adjacency._faceAreas     , nFaces) && adjacency._faceAreas     .size() == nFaces;
+
+  for (std::uint64_t bin = 0; isOk && bin < nBins; bin++){
+    isOk = adjacency._firstNeighbour[bin] <= adjacency._firstNeighbour[bin + 1];
+  }
+  for (std::uint64_t i = 0; isOk && i < nFaces; i++){
+    isOk = adjacency._neighbours[i] >= 0 && adjacency._neighbours[i] < (int)nBins &&
+           adjacency._faceDimensions[i] >= 0 && adjacency._faceDimensions[i] < binning.getDimension();
+  }
+  isOk = isOk && adjacency._firstNeighbour[0] == 0;
+
+  if (isOk == false){
+    std::cerr << "BinAdjacency::load - " << filename << " is damaged" << std::endl;
+    return false;
+  }
+
+  *this = adjacency;
+  return true;
+
+}
+
+///Load the graph of a binning from a file, or, if there is no usable file,
+///build it and save it there for next time
+bool BinAdjacency::loadOrBuild(const std::string& filename, const HyperBinningFrozen& binning, int nThreads){
+
+  if (load(filename, binning)) return true;
+
+  build(binning, nThreads);
+  return save(filename);
+
+}
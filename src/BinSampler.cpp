@@ -0,0 +1,156 @@
+#include "BinSampler.h"
+
+#include "Threads.h"
+
+#include <algorithm>
+#include <iostream>
+
+///Construct the sampler. If nThreads is zero, the number of hardware
+///threads is used. The chunk size sets the granularity of the work split
+///between threads, and together with the seed it fixes the points.
+BinSampler::BinSampler(const HyperBinningFrozen& binning, int nThreads, int chunkSize) :
+  _binning        (binning),
+  _nThreads       (nThreads),
+  _chunkSize      (chunkSize),
+  _volumeOfBin    (binning.getNumBins(), -1),
+  _aliasTables    (binning.getNumBins()),
+  _aliasTableBuilt(new std::once_flag[binning.getNumBins()])
+{
+  _nThreads = Threads::getNumThreads(_nThreads);
+  if (_chunkSize <= 0) {
+    std::cerr << "BinSampler - chunk size must be positive, setting to 100000" << std::endl;
+    _chunkSize = 100000;
+  }
+
+  for (int volumeNumber = 0; volumeNumber < binning.getNumHyperVolumes(); volumeNumber++){
+    int binNumber = binning.getBinNum(volumeNumber);
+    if (binNumber != -1) _volumeOfBin[binNumber] = volumeNumber;
+  }
+}
+
+///Get the seed of the random number stream used for one chunk, in the same
+///way as PhaseSpaceIntegrator::getChunkSeed(), but with 64 bits
+std::uint64_t BinSampler::getChunkSeed(std::uint64_t seed, long long chunk){
+  std::uint64_t z = seed + (std::uint64_t)chunk*0x9E3779B97F4A7C15ULL + 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+///Get the alias table of a bin, and build it first if this is the first
+///time it is needed (Vose's method)
+const BinSampler::AliasTable& BinSampler::getAliasTable(int binNumber) const{
+
+  std::call_once(_aliasTableBuilt[binNumber], [&](){
+
+    const int volumeNumber = _volumeOfBin[binNumber];
+    const int nCuboids     = _binning.getNumHyperCuboids(volumeNumber);
+    const int dim          = _binning.getDimension();
+
+    //The volume of each HyperCuboid, scaled so that they average to one
+
+    std::vector<double> scaled(nCuboids, 1.0);
+    double total = 0.0;
+    for (int c = 0; c < nCuboids; c++){
+      const double* low  = _binning.getLowCorner (volumeNumber, c);
+      const double* high = _binning.getHighCorner(volumeNumber, c);
+      for (int d = 0; d < dim; d++) scaled[c] *= high[d] - low[d];
+      total += scaled[c];
+    }
+    for (int c = 0; c < nCuboids; c++) scaled[c] = total > 0.0 ? scaled[c]*nCuboids/total : 1.0;
+
+    //Pair each HyperCuboid below the average with one above it
+
+    AliasTable& table = _aliasTables[binNumber];
+    table.probability.assign(nCuboids, 1.0);
+    table.alias.resize(nCuboids);
+    for (int c = 0; c < nCuboids; c++) table.alias[c] = c;
+
+    std::vector<int> small, large;
+    for (int c = 0; c < nCuboids; c++) (scaled[c] < 1.0 ? small : large).push_back(c);
+
+    while (small.size() > 0 && large.size() > 0){
+      int less = small.back(); small.pop_back();
+      int more = large.back(); large.pop_back();
+      table.probability[less] = scaled[less];
+      table.alias      [less] = more;
+      scaled[more] -= 1.0 - scaled[less];
+      (scaled[more] < 1.0 ? small : large).push_back(more);
+    }
+
+  });
+
+  return _aliasTables[binNumber];
+
+}
+
+///Generate one point uniformly inside a bin, and write it to coords, which
+///must have getDimension() elements. The bin number must exist.
+void BinSampler::sample(int binNumber, double* coords, std::mt19937_64& random) const{
+
+  //The top 53 bits of each number make a double in [0, 1)
+  auto uniform = [&random](){ return (random() >> 11)*0x1.0p-53; };
+
+  const int volumeNumber = _volumeOfBin[binNumber];
+  const int nCuboids     = _binning.getNumHyperCuboids(volumeNumber);
+
+  int cuboid = 0;
+  if (nCuboids > 1){
+    const AliasTable& table = getAliasTable(binNumber);
+    cuboid = std::min(nCuboids - 1, (int)(uniform()*nCuboids));
+    if (uniform() >= table.probability[cuboid]) cuboid = table.alias[cuboid];
+  }
+
+  //Measure from the high corner, so that the point is in (low, high]
+  const double* low  = _binning.getLowCorner (volumeNumber, cuboid);
+  const double* high = _binning.getHighCorner(volumeNumber, cuboid);
+  for (int d = 0; d < _binning.getDimension(); d++){
+    do { coords[d] = high[d] - uniform()*(high[d] - low[d]); } while ( !(coords[d] > low[d]) && high[d] > low[d] );
+  }
+
+}
+
+///Generate points in chunks on all the threads, either in the bins given
+///by binNumbers, or all in binNumber if binNumbers is zero
+void BinSampler::sampleBatch(const int* binNumbers, int binNumber, int nPoints, double* coords, std::uint64_t seed) const{
+
+  const int dim     = _binning.getDimension();
+  const int nChunks = (nPoints + _chunkSize - 1)/_chunkSize;
+
+  Threads::runThreads(std::min(_nThreads, std::max(nChunks, 1)), nChunks, [&](int, int chunk) {
+    std::mt19937_64 random(getChunkSeed(seed, chunk));
+    for (int i = chunk*_chunkSize; i < std::min(nPoints, (chunk + 1)*_chunkSize); i++){
+      sample(binNumbers == 0 ? binNumber : binNumbers[i], coords + (std::size_t)i*dim, random);
+    }
+  });
+
+}
+
+///Generate nPoints points uniformly inside a bin, and store them back to
+///back in coords, with getDimension() doubles each. The points only depend
+///on the seed and the chunk size. Fails if the bin doesn't exist.
+bool BinSampler::sample(int binNumber, int nPoints, double* coords, std::uint64_t seed) const{
+
+  if (binNumber < 0 || binNumber >= _binning.getNumBins()){
+    std::cerr << "BinSampler::sample - bin " << binNumber << " does not exist" << std::endl;
+    return false;
+  }
+  sampleBatch(0, binNumber, nPoints, coords, seed);
+  return true;
+
+}
+
+///Generate one point uniformly inside each of the bins in binNumbers, see
+///above. Fails if any of the bins doesn't exist.
+bool BinSampler::sample(const int* binNumbers, int nPoints, double* coords, std::uint64_t seed) const{
+
+  for (int i = 0; i < nPoints; i++){
+    if (binNumbers[i] < 0 || binNumbers[i] >= _binning.getNumBins()){
+      std::cerr << "BinSampler::sample - bin " << binNumbers[i] << " does not exist" << std::endl;
+      return false;
+    }
+  }
+  sampleBatch(binNumbers, -1, nPoints, coords, seed);
+  return true;
+
+}
@@ -0,0 +1,223 @@
+#include "BinningDiff.h"
+
+#include "Threads.h"
+
+#include <algorithm>
+#include <iostream>
+
+///Compare the old and the new binning on nThreads threads (or the number
+///of hardware threads if it is zero). Events will be re-binned into bin
+///numbers or labels of the new binning, depending on index.
+BinningDiff::BinningDiff(const HyperBinningFrozen& oldBinning, const HyperBinningFrozen& newBinning, Index index, int nThreads, double tolerance) :
+  _newBinning   (newBinning),
+  _index        (index),
+  _tolerance    (tolerance),
+  _totalVolume  (0.0),
+  _changedVolume(0.0),
+  _lookupVolume (0.0)
+{
+
+  nThreads = Threads::getNumThreads(nThreads);
+
+  const int nOldBins = oldBinning.getNumBins();
+  _newIndexOfOldBin.assign(nOldBins + 1, getIndex(newBinning, -1));
+  _needsLookup     .assign(nOldBins + 1, 0);
+
+  if (oldBinning.getDimension() != newBinning.getDimension()){
+    std::cerr << "BinningDiff - the binnings have different dimensions, every event will be looked up again" << std::endl;
+    _needsLookup.assign(nOldBins + 1, 1);
+    return;
+  }
+
+  std::vector<int> volumeOfBin(nOldBins, -1);
+  for (int volumeNumber = 0; volumeNumber < oldBinning.getNumHyperVolumes(); volumeNumber++){
+    int bin = oldBinning.getBinNum(volumeNumber);
+    if (bin != -1) volumeOfBin[bin] = volumeNumber;
+  }
+
+  //Each thread takes chunks of old bins in turn, and keeps its own results
+
+  const int chunkSize = 256;
+  const int nChunks   = (nOldBins + chunkSize - 1)/chunkSize;
+  nThreads = std::max(1, std::min(nThreads, nChunks));
+
+  std::vector<Results> threadResults(nThreads);
+  for (Results& results : threadResults){
+    results.newCovered.assign(newBinning.getNumBins(), 0.0);
+    results.totalVolume   = 0.0;
+    results.changedVolume = 0.0;
+    results.lookupVolume  = 0.0;
+  }
+
+  Threads::runThreads(nThreads, nChunks, [&](int thread, int chunk) {
+    std::vector<int> candidates;
+    for (int bin = chunk*chunkSize; bin < std::min(nOldBins, (chunk + 1)*chunkSize); bin++){
+      compareBin(oldBinning, volumeOfBin[bin], candidates, threadResults[thread]);
+    }
+  });
+
+  std::vector<double> newCovered(newBinning.getNumBins(), 0.0);
+  for (Results& results : threadResults){
+    _changes.insert(_changes.end(), results.changes.begin(), results.changes.end());
+    for (unsigned bin = 0; bin < newCovered.size(); bin++) newCovered[bin] += results.newCovered[bin];
+    _totalVolume   += results.totalVolume;
+    _changedVolume += results.changedVolume;
+    _lookupVolume  += results.lookupVolume;
+  }
+  std::stable_sort(_changes.begin(), _changes.end(), [](const Change& a, const Change& b){ return a.oldBin < b.oldBin; });
+
+  //Events outside the old binning only need to be looked up again if some
+  //new bin isn't covered by the old bins
+
+  for (int volumeNumber = 0; volumeNumber < newBinning.getNumHyperVolumes(); volumeNumber++){
+    int bin = newBinning.getBinNum(volumeNumber);
+    if (bin == -1) continue;
+    double volume = 0.0;
+    for (int c = 0; c < newBinning.getNumHyperCuboids(volumeNumber); c++){
+      volume += HyperCuboid::getVolume(newBinning.getLowCorner(volumeNumber, c), newBinning.getHighCorner(volumeNumber, c), newBinning.getDimension());
+    }
+    if (volume - newCovered[bin] > _tolerance*volume) {
+      _needsLookup[nOldBins] = 1;
+      break;
+    }
+  }
+
+}
+
+///Get the bin number or label of a HyperVolume of a binning, or of the
+///outside of the binning if the volume number is -1
+int BinningDiff::getIndex(const HyperBinningFrozen& binning, int volumeNumber) const{
+
+  return _index == Labels ? binning.getLabelOfVolume(volumeNumber) : binning.getBinNum(volumeNumber);
+
+}
+
+///Overlay one old bin with the new bins that overlap it, and work out if
+///all of it goes to the same new bin number or label
+void BinningDiff::compareBin(const HyperBinningFrozen& oldBinning, int volumeNumber, std::vector<int>& candidates, Results& results){
+
+  const int dim      = oldBinning.getDimension();
+  const int oldBin   = oldBinning.getBinNum(volumeNumber);
+  const int oldIndex = getIndex(oldBinning, volumeNumber);
+
+  std::vector<int> newIndices;
+  std::vector<double> low(dim), high(dim);
+  double volume  = 0.0;
+  double covered = 0.0;
+  double changed = 0.0;
+
+  for (int c = 0; c < oldBinning.getNumHyperCuboids(volumeNumber); c++){
+
+    const double* oldLow  = oldBinning.getLowCorner (volumeNumber, c);
+    const double* oldHigh = oldBinning.getHighCorner(volumeNumber, c);
+    volume += HyperCuboid::getVolume(oldLow, oldHigh, dim);
+
+    _newBinning.getVolumesInRegion(oldLow, oldHigh, candidates);
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    for (int newVolume : candidates){
+      for (int n = 0; n < _newBinning.getNumHyperCuboids(newVolume); n++){
+        const double* newLow  = _newBinning.getLowCorner (newVolume, n);
+        const double* newHigh = _newBinning.getHighCorner(newVolume, n);
+
+        bool overlaps = true;
+        for (int d = 0; d < dim && overlaps; d++){
+          low [d] = std::max(oldLow [d], newLow [d]);
+          high[d] = std::min(oldHigh[d], newHigh[d]);
+          overlaps = low[d] < high[d];
+        }
+        if (overlaps == false) continue;
+
+        double overlap = HyperCuboid::getVolume(low.data(), high.data(), dim);
+        covered += overlap;
+        results.newCovered[_newBinning.getBinNum(newVolume)] += overlap;
+
+        int newIndex = getIndex(_newBinning, newVolume);
+        newIndices.push_back(newIndex);
+        if (newIndex == oldIndex) continue;
+
+        changed += overlap;
+        HyperCuboid region(dim);
+        for (int d = 0; d < dim; d++){
+          region.getLowCorner ().at(d) = low [d];
+          region.getHighCorner().at(d) = high[d];
+        }
+        results.changes.push_back(Change{oldBin, _newBinning.getBinNum(newVolume), oldBinning.getLabelOfVolume(volumeNumber), _newBinning.getLabelOfVolume(newVolume), region});
+      }
+    }
+  }
+
+  //Part of the old bin that isn't in any new bin goes outside the new binning
+
+  if (volume - covered > _tolerance*volume){
+    int newIndex = getIndex(_newBinning, -1);
+    newIndices.push_back(newIndex);
+    if (newIndex != oldIndex) changed += volume - covered;
+  }
+
+  std::sort(newIndices.begin(), newIndices.end());
+  newIndices.erase(std::unique(newIndices.begin(), newIndices.end()), newIndices.end());
+
+  if (newIndices.size() == 1) _newIndexOfOldBin[oldBin] = newIndices[0];
+  if (newIndices.size() >  1) {
+    _needsLookup[oldBin] = 1;
+    results.lookupVolume += volume;
+  }
+
+  results.totalVolume   += volume;
+  results.changedVolume += changed > _tolerance*volume ? changed : 0.0;
+
+}
+
+///Get the number of old bins whose events need to be looked up again
+int BinningDiff::getNumLookupBins() const{
+
+  return std::count(_needsLookup.begin(), _needsLookup.end() - 1, 1);
+
+}
+
+///Re-bin a batch of events, stored back to back in coords with
+///getDimension() doubles each, from their bin numbers in the old binning.
+///Events in an old bin that falls into a single new bin number or label get
+///it straight away, and only the others are looked up in the new binning.
+///Returns the number of events that were looked up again, or -1 (and
+///leaves newIndices unchanged) if any of the old bin numbers doesn't exist.
+int BinningDiff::rebin(const double* coords, const int* oldBinNumbers, int nPoints, int* newIndices) const{
+
+  const int dim = _newBinning.getDimension();
+
+  //Check every old bin number first, so that nothing is written if one is wrong
+
+  for (int i = 0; i < nPoints; i++){
+    int oldBin = oldBinNumbers[i];
+    if (oldBin < -1 || oldBin >= getNumOldBins()){
+      std::cerr << "BinningDiff::rebin - bin " << oldBin << " does not exist in the old binning" << std::endl;
+      return -1;
+    }
+  }
+
+  std::vector<int> lookups;
+  for (int i = 0; i < nPoints; i++){
+    int oldBin = oldBinNumbers[i];
+    if (needsLookup(oldBin)) lookups.push_back(i);
+    else newIndices[i] = getNewIndexOfOldBin(oldBin);
+  }
+
+  //Gather the events to look up, so that they go through the batch lookup
+
+  const int nLookups = lookups.size();
+  std::vector<double> lookupCoords((std::size_t)nLookups*dim);
+  std::vector<int>    lookupIndices(nLookups);
+  for (int i = 0; i < nLookups; i++){
+    std::copy(coords + (std::size_t)lookups[i]*dim, coords + (std::size_t)(lookups[i] + 1)*dim, lookupCoords.begin() + (std::size_t)i*dim);
+  }
+
+  if (_index == Labels) _newBinning.getLabels (lookupCoords.data(), nLookups, lookupIndices.data());
+  else                  _newBinning.getBinNums(lookupCoords.data(), nLookups, lookupIndices.data());
+
+  for (int i = 0; i < nLookups; i++) newIndices[lookups[i]] = lookupIndices[i];
+
+  return nLookups;
+
+}
@@ -0,0 +1,387 @@
+#include "BinningValidator.h"
+
+#include "Threads.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+///Get the volume of the overlap of two HyperCuboids, which is zero if they
+///only touch
+double getOverlapVolume(const double* lowA, const double* highA, const double* lowB, const double* highB, int dim){
+  double volume = 1.0;
+  for (int d = 0; d < dim; d++){
+    double width = std::min(highA[d], highB[d]) - std::max(lowA[d], lowB[d]);
+    if (width <= 0.0) return 0.0;
+    volume *= width;
+  }
+  return volume;
+}
+
+}
+
+///Construct the validator. Gaps and overhangs smaller than tolerance times
+///the volume of the HyperVolume being checked are ignored, and at most
+///maxRegions uncovered regions are kept for each gap.
+BinningValidator::BinningValidator(double tolerance, int maxRegions) :
+  _tolerance (tolerance),
+  _maxRegions(std::max(0, maxRegions))
+{
+}
+
+///Find the overlapping pairs among the HyperCuboids of the HyperVolumes in
+///members, by sweep and prune, and add them to the results. boxes holds
+///the HyperCuboids, and gets sorted. Returns the total volume of the overlaps.
+double BinningValidator::findOverlaps(const HyperBinningFrozen& binning, int volumeNumber, const std::vector<int>& members, std::vector<Box>& boxes, Results& results) const{
+
+  int dim    = binning.getDimension();
+  int nBoxes = boxes.size();
+  if (nBoxes < 2) return 0.0;
+
+  //Sweep along the dimension where the HyperCuboids are the most spread
+  //out compared to their width, so that few of them are open at once
+
+  int    axis      = 0;
+  double bestSpread = -1.0;
+  for (int d = 0; d < dim; d++){
+    double minLow = boxes[0].low[d];
+    double maxLow = boxes[0].low[d];
+    double width  = 0.0;
+    for (const Box& box : boxes){
+      minLow = std::min(minLow, box.low[d]);
+      maxLow = std::max(maxLow, box.low[d]);
+      width += box.high[d] - box.low[d];
+    }
+    double spread = width > 0.0 ? (maxLow - minLow)*nBoxes/width : 0.0;
+    if (spread > bestSpread) { bestSpread = spread; axis = d; }
+  }
+
+  std::sort(boxes.begin(), boxes.end(), [axis](const Box& a, const Box& b){ return a.low[axis] < b.low[axis]; });
+
+  std::vector<Overlap> found;
+  std::vector<int>     order;
+  std::vector<int>     open;
+
+  //Sweep over the HyperCuboids in order, keeping those that are still open.
+  //A pair is only kept if accept() is true for the low corner of its overlap.
+
+  std::vector<double> corner(dim);
+  auto sweep = [&](auto accept) {
+    open.clear();
+    for (int i : order){
+      const Box& box = boxes[i];
+      open.erase(std::remove_if(open.begin(), open.end(), [&](int j){ return boxes[j].high[axis] <= box.low[axis]; }), open.end());
+      for (int j : open){
+        if (boxes[j].member == box.member) continue;
+        double volume = getOverlapVolume(box.low, box.high, boxes[j].low, boxes[j].high, dim);
+        if (volume == 0.0) continue;
+        for (int d = 0; d < dim; d++) corner[d] = std::max(box.low[d], boxes[j].low[d]);
+        if (accept(corner.data()) == false) continue;
+        found.push_back(Overlap{volumeNumber, std::min(box.member, boxes[j].member), std::max(box.member, boxes[j].member), volume});
+      }
+      open.push_back(i);
+    }
+  };
+
+  if (nBoxes <= _maxSweepBoxes){
+    for (int i = 0; i < nBoxes; i++) order.push_back(i);
+    sweep([](const double*){ return true; });
+  }
+  else{
+
+    //With many HyperCuboids, e.g. a flat binning, a single sweep keeps a
+    //whole slice of them open at once. Instead, they are put in a grid of
+    //cells, with about eight per cell, and each cell is swept on its own.
+    //A pair that shares several cells is only kept in the cell that holds
+    //the low corner of its overlap.
+
+    int nPerDim = std::max(1, (int)std::pow(nBoxes/8.0, 1.0/dim));
+    std::vector<double> gridLow (boxes[0].low , boxes[0].low  + dim);
+    std::vector<double> gridHigh(boxes[0].high, boxes[0].high + dim);
+    for (const Box& box : boxes){
+      for (int d = 0; d < dim; d++){
+        gridLow [d] = std::min(gridLow [d], box.low [d]);
+        gridHigh[d] = std::max(gridHigh[d], box.high[d]);
+      }
+    }
+    auto getCell = [&](double x, int d){
+      if (gridHigh[d] <= gridLow[d]) return 0;
+      return std::max(0, std::min(nPerDim - 1, (int)((x - gridLow[d])/(gridHigh[d] - gridLow[d])*nPerDim)));
+    };
+    auto getCellNumber = [&](const double* x){
+      int cell = 0;
+      for (int d = 0; d < dim; d++) cell = cell*nPerDim + getCell(x[d], d);
+      return cell;
+    };
+
+    //Every HyperCuboid goes in each cell that it reaches, counted first and
+    //then filled in compressed sparse row form
+
+    int nCells = 1;
+    for (int d = 0; d < dim; d++) nCells *= nPerDim;
+    std::vector<int> firstInCell(nCells + 1, 0);
+    std::vector<int> inCell;
+    std::vector<int> first(dim), last(dim), cell(dim);
+
+    for (int pass = 0; pass < 2; pass++){
+      std::vector<int> filled(firstInCell.begin(), firstInCell.end() - 1);
+      for (int i = 0; i < nBoxes; i++){
+        for (int d = 0; d < dim; d++){
+          first[d] = getCell(boxes[i].low [d], d);
+          last [d] = getCell(boxes[i].high[d], d);
+        }
+        cell = first;
+        while (true){
+          int cellNumber = 0;
+          for (int d = 0; d < dim; d++) cellNumber = cellNumber*nPerDim + cell[d];
+          if (pass == 0) firstInCell[cellNumber + 1]++;
+          else           inCell[filled[cellNumber]++] = i;
+          int d = dim - 1;
+          while (d >= 0 && cell[d] == last[d]) { cell[d] = first[d]; d--; }
+          if (d < 0) break;
+          cell[d]++;
+        }
+      }
+      if (pass == 0){
+        for (int c = 0; c < nCells; c++) firstInCell[c + 1] += firstInCell[c];
+        inCell.resize(firstInCell[nCells]);
+      }
+    }
+
+    for (int c = 0; c < nCells; c++){
+      if (firstInCell[c + 1] - firstInCell[c] < 2) continue;
+      order.assign(inCell.begin() + firstInCell[c], inCell.begin() + firstInCell[c + 1]);
+      sweep([&](const double* x){ return getCellNumber(x) == c; });
+    }
+
+  }
+
+  //Overlaps between the same two HyperVolumes, from different HyperCuboids, are merged
+
+  std::sort(found.begin(), found.end(), [](const Overlap& a, const Overlap& b){
+    return a.first != b.first ? a.first < b.first : a.second < b.second;
+  });
+
+  double total = 0.0;
+  for (unsigned i = 0; i < found.size(); i++){
+    if (i > 0 && found[i].first == found[i - 1].first && found[i].second == found[i - 1].second){
+      results.overlaps.back().volume += found[i].volume;
+    }
+    else{
+      results.overlaps.push_back(Overlap{volumeNumber, members[found[i].first], members[found[i].second], found[i].volume});
+    }
+    total += found[i].volume;
+  }
+  return total;
+
+}
+
+///Cut the HyperCuboids in boxes out of the HyperCuboids of a HyperVolume,
+///and leave what is left in pieces, as low corner followed by high corner.
+///Returns false, with nothing in pieces, if the remainder breaks up into
+///too many pieces.
+bool BinningValidator::findGapRegions(const HyperBinningFrozen& binning, int volumeNumber, const std::vector<Box>& boxes, std::vector<double>& pieces) const{
+
+  int dim       = binning.getDimension();
+  int maxPieces = 64 + 16*_maxRegions;
+
+  pieces.clear();
+  for (int c = 0; c < binning.getNumHyperCuboids(volumeNumber); c++){
+    pieces.insert(pieces.end(), binning.getLowCorner (volumeNumber, c), binning.getLowCorner (volumeNumber, c) + dim);
+    pieces.insert(pieces.end(), binning.getHighCorner(volumeNumber, c), binning.getHighCorner(volumeNumber, c) + dim);
+  }
+
+  std::vector<double> remaining;
+  std::vector<double> piece(2*dim);
+
+  for (const Box& box : boxes){
+    remaining.clear();
+    for (unsigned p = 0; p < pieces.size(); p += 2*dim){
+      const double* low  = pieces.data() + p;
+      const double* high = low + dim;
+      if (getOverlapVolume(low, high, box.low, box.high, dim) == 0.0){
+        remaining.insert(remaining.end(), low, low + 2*dim);
+        continue;
+      }
+      //Peel off the parts of the piece below and above the HyperCuboid in
+      //each dimension in turn. What is left at the end is covered.
+      std::copy(low, low + 2*dim, piece.begin());
+      for (int d = 0; d < dim; d++){
+        if (piece[d] < box.low[d]){
+          size_t start = remaining.size();
+          remaining.insert(remaining.end(), piece.begin(), piece.end());
+          remaining[start + dim + d] = box.low[d];
+          piece[d] = box.low[d];
+        }
+        if (piece[dim + d] > box.high[d]){
+          size_t start = remaining.size();
+          remaining.insert(remaining.end(), piece.begin(), piece.end());
+          remaining[start + d] = box.high[d];
+          piece[dim + d] = box.high[d];
+        }
+      }
+    }
+    pieces.swap(remaining);
+    if ((int)pieces.size() > 2*dim*maxPieces) {
+      pieces.clear();
+      return false;
+    }
+  }
+  return true;
+
+}
+
+///Check the HyperVolumes in members, which are either the HyperVolumes
+///linked from volumeNumber, or the primary volumes if volumeNumber is -1
+void BinningValidator::checkVolume(const HyperBinningFrozen& binning, int volumeNumber, const std::vector<int>& members, std::vector<Box>& boxes, Results& results) const{
+
+  int dim = binning.getDimension();
+
+  boxes.clear();
+  for (unsigned m = 0; m < members.size(); m++){
+    for (int c = 0; c < binning.getNumHyperCuboids(members[m]); c++){
+      boxes.push_back(Box{(int)m, binning.getLowCorner(members[m], c), binning.getHighCorner(members[m], c)});
+    }
+  }
+
+  double overlapVolume = findOverlaps(binning, volumeNumber, members, boxes, results);
+  if (volumeNumber == -1) return;
+
+  //Compare the volume of the HyperVolume with the part of it covered by
+  //each linked HyperVolume
+
+  double volume = 0.0;
+  for (int c = 0; c < binning.getNumHyperCuboids(volumeNumber); c++){
+    volume += HyperCuboid::getVolume(binning.getLowCorner(volumeNumber, c), binning.getHighCorner(volumeNumber, c), dim);
+  }
+
+  std::vector<double> inside(members.size(), 0.0);
+  std::vector<double> total (members.size(), 0.0);
+  for (const Box& box : boxes){
+    total[box.member] += HyperCuboid::getVolume(box.low, box.high, dim);
+    for (int c = 0; c < binning.getNumHyperCuboids(volumeNumber); c++){
+      inside[box.member] += getOverlapVolume(box.low, box.high, binning.getLowCorner(volumeNumber, c), binning.getHighCorner(volumeNumber, c), dim);
+    }
+  }
+
+  double covered = 0.0;
+  for (unsigned m = 0; m < members.size(); m++){
+    if (total[m] - inside[m] > _tolerance*volume) results.overhangs.push_back(Overhang{volumeNumber, members[m], total[m] - inside[m]});
+    covered += inside[m];
+  }
+
+  //Without overlaps, the covered volume is exact, and only if it falls
+  //short are the uncovered regions worked out
+
+  double gapVolume = volume - covered;
+  if (gapVolume <= _tolerance*volume && overlapVolume == 0.0) return;
+
+  Gap gap;
+  std::vector<double> pieces;
+  bool complete = findGapRegions(binning, volumeNumber, boxes, pieces);
+
+  if (complete){
+    int nPieces = pieces.size()/(2*dim);
+    std::vector<double> pieceVolumes(nPieces);
+    std::vector<int>    order(nPieces);
+    gapVolume = 0.0;
+    for (int p = 0; p < nPieces; p++){
+      pieceVolumes[p] = HyperCuboid::getVolume(pieces.data() + 2*dim*p, pieces.data() + 2*dim*p + dim, dim);
+      gapVolume += pieceVolumes[p];
+      order[p] = p;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b){ return pieceVolumes[a] > pieceVolumes[b]; });
+    for (int p = 0; p < std::min(nPieces, _maxRegions); p++){
+      HyperCuboid region(dim);
+      for (int d = 0; d < dim; d++){
+        region.getLowCorner ().at(d) = pieces[2*dim*order[p] + d];
+        region.getHighCorner().at(d) = pieces[2*dim*order[p] + dim + d];
+      }
+      gap.regions.push_back(region);
+    }
+    gap.allRegions = nPieces <= _maxRegions;
+  }
+  else{
+    gap.allRegions = false;
+  }
+
+  if (gapVolume <= _tolerance*volume) return;
+
+  gap.volumeNumber = volumeNumber;
+  gap.volume       = gapVolume;
+  gap.fraction     = volume > 0.0 ? gapVolume/volume : 0.0;
+  results.gaps.push_back(gap);
+
+}
+
+///Check every HyperVolume with links, and the primary volumes, on nThreads
+///threads (or the number of hardware threads if it is zero). Returns true
+///if there are no overlaps, gaps or overhangs. If the uncovered part of a
+///HyperVolume with overlaps breaks up into too many pieces, its gap can't
+///be measured exactly, and the volume it reports is only a lower bound.
+bool BinningValidator::validate(const HyperBinningFrozen& binning, int nThreads){
+
+  nThreads = Threads::getNumThreads(nThreads);
+
+  _overlaps .clear();
+  _gaps     .clear();
+  _overhangs.clear();
+
+  const int nVolumes = binning.getNumHyperVolumes();
+
+  //The primary volumes, or every HyperVolume that nothing links to
+
+  std::vector<int> roots;
+  if (binning.getNumPrimaryVolumes() > 0){
+    for (int i = 0; i < binning.getNumPrimaryVolumes(); i++) roots.push_back(binning.getPrimaryVolumeNumber(i));
+  }
+  else{
+    std::vector<bool> isLinked(nVolumes, false);
+    for (int i = 0; i < nVolumes; i++){
+      for (int j = 0; j < binning.getNumLinkedHyperVolumes(i); j++) isLinked[binning.getLinkedHyperVolume(i, j)] = true;
+    }
+    for (int i = 0; i < nVolumes; i++){
+      if (isLinked[i] == false) roots.push_back(i);
+    }
+  }
+
+  //Each thread takes chunks of HyperVolumes in turn, and keeps its own
+  //results. The primary volumes come first, since they may take longest.
+
+  const int nItems    = nVolumes + 1;
+  const int chunkSize = 256;
+  const int nChunks   = (nItems + chunkSize - 1)/chunkSize;
+  nThreads = std::max(1, std::min(nThreads, nChunks));
+
+  std::vector<Results> threadResults(nThreads);
+
+  Threads::runThreads(nThreads, nChunks, [&](int thread, int chunk) {
+    std::vector<int> members;
+    std::vector<Box> boxes;
+    for (int item = chunk*chunkSize; item < std::min(nItems, (chunk + 1)*chunkSize); item++){
+      if (item == 0) {
+        checkVolume(binning, -1, roots, boxes, threadResults[thread]);
+        continue;
+      }
+      int volumeNumber = item - 1;
+      if (binning.getNumLinkedHyperVolumes(volumeNumber) == 0) continue;
+      members.clear();
+      for (int i = 0; i < binning.getNumLinkedHyperVolumes(volumeNumber); i++) members.push_back(binning.getLinkedHyperVolume(volumeNumber, i));
+      checkVolume(binning, volumeNumber, members, boxes, threadResults[thread]);
+    }
+  });
+
+  for (Results& results : threadResults){
+    _overlaps .insert(_overlaps .end(), results.overlaps .begin(), results.overlaps .end());
+    _gaps     .insert(_gaps     .end(), results.gaps     .begin(), results.gaps     .end());
+    _overhangs.insert(_overhangs.end(), results.overhangs.begin(), results.overhangs.end());
+  }
+
+  std::stable_sort(_overlaps .begin(), _overlaps .end(), [](const Overlap&  a, const Overlap&  b){ return a.volumeNumber < b.volumeNumber; });
+  std::stable_sort(_gaps     .begin(), _gaps     .end(), [](const Gap&      a, const Gap&      b){ return a.volumeNumber < b.volumeNumber; });
+  std::stable_sort(_overhangs.begin(), _overhangs.end(), [](const Overhang& a, const Overhang& b){ return a.volumeNumber < b.volumeNumber; });
+
+  return isValid();
+
+}
@@ -0,0 +1,175 @@
+#include "BoundingVolumeHierarchy.h"
+
+#include <algorithm>
+
+///Construct an empty BoundingVolumeHierarchy
+///
+BoundingVolumeHierarchy::BoundingVolumeHierarchy(int dimension) :
+  _dimension(dimension)
+{
+
+}
+
+///Remove all the boxes
+///
+void BoundingVolumeHierarchy::clear(){
+
+  _nodes    .clear();
+  _nodeBoxes.clear();
+  _items    .clear();
+  _itemBoxes.clear();
+
+}
+
+///Build the tree over nItems boxes, stored back to back in boxes with 
+///2*dimension doubles each (low corner then high corner). Item i is the
+///i-th box. This takes O(n log n) time.
+void BoundingVolumeHierarchy::build(int dimension, const double* boxes, int nItems){
+
+  clear();
+  _dimension = dimension;
+  if (nItems <= 0) return;
+
+  std::vector<int> items(nItems);
+  std::vector<double> centres(nItems);
+  for (int i = 0; i < nItems; i++) items[i] = i;
+
+  _nodes    .resize(1);
+  _nodeBoxes.resize(2*_dimension);
+  buildNode(0, items, centres, boxes, 0, nItems, 0);
+
+  _items = items;
+  _itemBoxes.resize(2*_dimension*nItems);
+  for (int i = 0; i < nItems; i++){
+    std::copy(boxes + 2*_dimension*items[i], boxes + 2*_dimension*(items[i] + 1), _itemBoxes.data() + 2*_dimension*i);
+  }
+
+}
+
+///Fill in node nodeNumber with items[first] to items[last - 1], and build
+///the nodes below it. The two daughters of a node are made next to each 
+///other, before the nodes below either of them.
+void BoundingVolumeHierarchy::buildNode(int nodeNumber, std::vector<int>& items, std::vector<double>& centres, const double* boxes, int first, int last, int depth){
+
+  const int dim = _dimension;
+
+  //The box that surrounds all the items, and the range of their centres
+  double* box = _nodeBoxes.data() + 2*dim*nodeNumber;
+  std::vector<double> centreLow(dim), centreHigh(dim);
+  for (int d = 0; d < dim; d++){
+    box[d]       = boxes[2*dim*items[first] + d];
+    box[dim + d] = boxes[2*dim*items[first] + dim + d];
+    centreLow[d] = centreHigh[d] = box[d] + box[dim + d];
+  }
+  int minItem = items[first];
+  for (int i = first + 1; i < last; i++){
+    const double* itemBox = boxes + 2*dim*items[i];
+    for (int d = 0; d < dim; d++){
+      box[d]       = std::min(box[d]      , itemBox[d]);
+      box[dim + d] = std::max(box[dim + d], itemBox[dim + d]);
+      centreLow [d] = std::min(centreLow [d], itemBox[d] + itemBox[dim + d]);
+      centreHigh[d] = std::max(centreHigh[d], itemBox[d] + itemBox[dim + d]);
+    }
+    minItem = std::min(minItem, items[i]);
+  }
+
+  _nodes[nodeNumber].minItem    = minItem;
+  _nodes[nodeNumber].firstChild = -1;
+  _nodes[nodeNumber].firstItem  = first;
+  _nodes[nodeNumber].nItems     = last - first;
+
+  //Small nodes, or nodes whose items can't be told apart, become leaves.
+  //The items in a leaf are sorted, so a search can stop at the first hit
+  int splitDim = 0;
+  for (int d = 1; d < dim; d++){
+    if (centreHigh[d] - centreLow[d] > centreHigh[splitDim] - centreLow[splitDim]) splitDim = d;
+  }
+  if (last - first <= _maxLeafSize || depth >= _maxDepth || dim == 0 || !(centreHigh[splitDim] > centreLow[splitDim])){
+    std::sort(items.begin() + first, items.begin() + last);
+    return;
+  }
+
+  //Split the items in half by their centres along the longest side
+  for (int i = first; i < last; i++){
+    centres[items[i]] = boxes[2*dim*items[i] + splitDim] + boxes[2*dim*items[i] + dim + splitDim];
+  }
+  const int middle = first + (last - first)/2;
+  std::nth_element(items.begin() + first, items.begin() + middle, items.begin() + last,
+                   [&centres](int a, int b){ return centres[a] < centres[b] || (centres[a] == centres[b] && a < b); });
+
+  const int firstChild = _nodes.size();
+  _nodes[nodeNumber].firstChild = firstChild;
+  _nodes[nodeNumber].nItems     = 0;
+  _nodes    .resize(firstChild + 2);
+  _nodeBoxes.resize(2*dim*(firstChild + 2));
+
+  buildNode(firstChild    , items, centres, boxes, first , middle, depth + 1);
+  buildNode(firstChild + 1, items, centres, boxes, middle, last  , depth + 1);
+
+}
+
+///Write the tree into an image (see MappableArray)
+///
+void BoundingVolumeHierarchy::writeImage(ImageWriter& writer) const{
+
+  writer.write(_dimension);
+  writer.write(_nodes    );
+  writer.write(_nodeBoxes);
+  writer.write(_items    );
+  writer.write(_itemBoxes);
+
+}
+
+///Map the tree onto an image written by writeImage(), without copying it.
+///The image must outlive the tree. Returns false (and leaves the tree 
+///unchanged) if the image is damaged, which includes any item that isn't
+///below nItems, so that a damaged image can never be read out of bounds.
+bool BoundingVolumeHierarchy::readImage(ImageReader& reader, int nItems){
+
+  BoundingVolumeHierarchy tree;
+  reader.read(tree._dimension);
+  reader.read(tree._nodes    );
+  reader.read(tree._nodeBoxes);
+  reader.read(tree._items    );
+  reader.read(tree._itemBoxes);
+
+  const std::size_t dim = tree._dimension;
+  if (reader.isOk() == false || tree._dimension < 0 ||
+      (tree._nodes.size() != 0 && tree._dimension == 0) ||
+      tree._nodeBoxes.size() != 2*dim*tree._nodes.size() ||
+      tree._itemBoxes.size() != 2*dim*tree._items.size() ){
+    return false;
+  }
+
+  //The checks only read the arrays, through const references, since
+  //changing a mapped array would copy it off the image
+
+  const MappableArray<Node>& nodes = tree._nodes;
+  const MappableArray<int>&  items = tree._items;
+
+  for (int item : items){
+    if (item < 0 || item >= nItems) return false;
+  }
+
+  //The daughters of a node always come after it, so the depth of every
+  //node is known before its daughters are reached. The searches keep a
+  //stack that is only big enough for _maxDepth levels.
+
+  const int nNodes = nodes.size();
+  std::vector<int> depth(nNodes, 0);
+  for (int nodeNumber = 0; nodeNumber < nNodes; nodeNumber++){
+    const Node& node = nodes[nodeNumber];
+    if (node.nItems > 0){
+      if (node.firstItem < 0 || (std::size_t)node.firstItem + node.nItems > items.size()) return false;
+      continue;
+    }
+    if (node.nItems < 0 || node.firstChild <= nodeNumber || node.firstChild + 1 >= nNodes) return false;
+    if (depth[nodeNumber] >= _maxDepth) return false;
+    depth[node.firstChild    ] = std::max(depth[node.firstChild    ], depth[nodeNumber] + 1);
+    depth[node.firstChild + 1] = std::max(depth[node.firstChild + 1], depth[nodeNumber] + 1);
+  }
+
+  *this = tree;
+  return true;
+
+}
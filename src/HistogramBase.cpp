@@ -54,6 +54,35 @@ void HistogramBase::loadBase(TString filename){
 
 }
 
+/// Save the contents, sumw2, and bin numbers to a TTree
+/// in the ROOT file specified (opened using UPDATE)
+void HistogramBase::saveBase(TString filename) const{
+
+  TFile file(filename, "UPDATE");
+
+  //The TTree is owned by the file, which deletes it when it's closed
+  TTree* tree = new TTree("HistogramBase", "HistogramBase");
+
+  int    binNumber  = -1;
+  double binContent = 0.0;
+  double sumW2      = 0.0;
+
+  tree->Branch("binNumber" , &binNumber , "binNumber/I" );
+  tree->Branch("binContent", &binContent, "binContent/D");
+  tree->Branch("sumW2"     , &sumW2     , "sumW2/D"     );
+
+  for(int bin = 0; bin <= _nBins; bin++){
+    binNumber  = bin;
+    binContent = _binContents.at(bin);
+    sumW2      = _sumW2      .at(bin);
+    tree->Fill();
+  }
+
+  tree->Write();
+  file.Close();
+
+}
+
 ///Check if it's a valid bin number, if not
 ///return the overflow/underflow bin
 int HistogramBase::checkBinNumber(int bin) const{
@@ -74,3 +103,10 @@ double HistogramBase::getBinContent(int bin) const{
   bin = checkBinNumber(bin); 
   return _binContents[bin];
 }
+
+///Set the content of a bin
+///
+void HistogramBase::setBinContent(int bin, double val){
+  bin = checkBinNumber(bin); 
+  _binContents[bin] = val;
+}
@@ -57,11 +57,20 @@ void HyperBinning::setDimension(int dim){
 int HyperBinning::getBinNum(const HyperPoint& coords) const{
   
   //First check if the HyperPoint is in the HyperCuboid _minmax that
-  //surrounds all the bins.
+  //surrounds all the bins. This is done on the cashed HyperCuboid 
+  //rather than getLimits(), so that nothing is copied.
 
-  if ( getLimits().inVolume(coords) == 0) return -1;
+  if (_minmax.isUpdateNeeded() == true) updateMinMax();
+  if ( _minmax.get().inVolume(coords) == 0) return -1;
   
   int nPrimVols = getNumPrimaryVolumes();
+
+  //If there are many primary volumes (or many HyperVolumes in a flat 
+  //binning), use the spatial index to find the first one that contains 
+  //the HyperPoint
+
+  if (_rootVolumeIndex.isUpdateNeeded() == true) updateRootVolumeIndex();
+  const BoundingVolumeHierarchy& index = _rootVolumeIndex.get();
   
   if ( nPrimVols == 0){
 
@@ -71,14 +80,19 @@ int HyperBinning::getBinNum(const HyperPoint& coords) const{
 
     int volumeNumber = -1;
   
-    for (int i = 0; i < getNumHyperVolumes(); i++){
-      bool inVol = getHyperVolume(i).inVolume(coords);
-      if (inVol == 1) { volumeNumber = i; break; }
+    if (index.getNumItems() == getNumHyperVolumes()){
+      volumeNumber = index.findFirst(coords.data(), [&](int i){ return inHyperVolume(i, coords); });
+    }
+    else{
+      for (int i = 0; i < getNumHyperVolumes(); i++){
+        bool inVol = inHyperVolume(i, coords);
+        if (inVol == 1) { volumeNumber = i; break; }
+      }
     }
      
     if (volumeNumber == -1) return -1;
   
-    if ( getLinkedHyperVolumes(volumeNumber).size() > 0 ) volumeNumber = followBinLinks(coords, volumeNumber);
+    if ( getNumLinkedHyperVolumes(volumeNumber) > 0 ) volumeNumber = followBinLinks(coords, volumeNumber);
   
     return getBinNum(volumeNumber);
   }
@@ -86,21 +100,28 @@ int HyperBinning::getBinNum(const HyperPoint& coords) const{
 
   int primaryVolumeNumber = -1;
 
-  for (int i = 0; i < nPrimVols; i++){
-    int thisVolNum = getPrimaryVolumeNumber(i);
-    bool inVol = getHyperVolume(thisVolNum).inVolume(coords);
-    if (inVol == 1) { primaryVolumeNumber = thisVolNum; break; }
+  if (index.getNumItems() == nPrimVols){
+    int i = index.findFirst(coords.data(), [&](int i){ return inHyperVolume(getPrimaryVolumeNumber(i), coords); });
+    if (i != -1) primaryVolumeNumber = getPrimaryVolumeNumber(i);
+  }
+  else{
+    for (int i = 0; i < nPrimVols; i++){
+      int thisVolNum = getPrimaryVolumeNumber(i);
+      bool inVol = inHyperVolume(thisVolNum, coords);
+      if (inVol == 1) { primaryVolumeNumber = thisVolNum; break; }
+    }
   }
   
-  int volumeNumber = -1;
+  if (primaryVolumeNumber == -1) return -1;
 
-  if ( getLinkedHyperVolumes(primaryVolumeNumber).size() > 0 ) {
+  //A primary volume with no links is a true bin, which happens
+  //when binnings without a hierarchy are merged
+
+  int volumeNumber = primaryVolumeNumber;
+
+  if ( getNumLinkedHyperVolumes(primaryVolumeNumber) > 0 ) {
     volumeNumber = followBinLinks(coords, primaryVolumeNumber);
   }
-  else{
-    std::cerr << "This primary volume has NO links. Not what I expect!!" << std::endl;
-    return getBinNum(primaryVolumeNumber);
-  }
   
   return getBinNum(volumeNumber);
 
@@ -112,15 +133,15 @@ int HyperBinning::getBinNum(const HyperPoint& coords) const{
 ///
 int HyperBinning::followBinLinks(const HyperPoint& coords, int motherVolumeNumber) const{
   
-  //find the linked volumes
-  std::vector<int> linkedVolumes = getLinkedHyperVolumes(motherVolumeNumber);
+  //find the number of linked volumes
+  int nLinkedVolumes = getNumLinkedHyperVolumes(motherVolumeNumber);
   
   int volumeNumber = -1;
   
   //see if the coords falls into any of the linked volumes (it should if there are no bugs)
-  for (unsigned i = 0; i < linkedVolumes.size(); i++){
-    int daughBinNum = linkedVolumes.at(i);
-    bool inVol = getHyperVolume(daughBinNum).inVolume(coords);
+  for (int i = 0; i < nLinkedVolumes; i++){
+    int daughBinNum = getLinkedHyperVolume(motherVolumeNumber, i);
+    bool inVol = inHyperVolume(daughBinNum, coords);
     if (inVol == 1) { volumeNumber = daughBinNum; break; }
   }
   
@@ -131,7 +152,7 @@ int HyperBinning::followBinLinks(const HyperPoint& coords, int motherVolumeNumbe
   
   //now have volumeNumber which contains the next bin in the hierarchy.
   // if this is linked to more bins, keep following the trail!
-  if ( getLinkedHyperVolumes(volumeNumber).size() > 0 ) volumeNumber = followBinLinks(coords, volumeNumber);
+  if ( getNumLinkedHyperVolumes(volumeNumber) > 0 ) volumeNumber = followBinLinks(coords, volumeNumber);
   
   //if not, we have made it to the end. Return the volume number!
   return volumeNumber;
@@ -166,6 +187,7 @@ int HyperBinning::getBinNum(int volumeNumber) const{
   if ( _binNum.isUpdateNeeded() == true ){
     updateBinNumbering(); 
   }  
+  if (volumeNumber == -1) return -1;
   return _binNum.get().at(volumeNumber);
 }
 
@@ -187,6 +209,7 @@ void HyperBinning::updateCash() const{
   _minmax                  .changed();
   _binNum                  .changed();
   _hyperVolumeNumFromBinNum.changed();
+  _rootVolumeIndex         .changed();
 
 }
 
@@ -209,7 +232,7 @@ void HyperBinning::updateBinNumbering() const{
   //then set its bin number to count.
   int count = 0;
   for (int i = 0; i < getNumHyperVolumes(); i++){
-    if ( getLinkedHyperVolumes(i).size() == 0 ) {
+    if ( getNumLinkedHyperVolumes(i) == 0 ) {
       _binNum.get().at(i) = count;
       count++;
     }
@@ -247,19 +270,21 @@ HyperCuboid HyperBinning::getLimits() const{
   return _minmax;
 }
 
+///Get the HyperCuboid that surrounds one of the HyperVolumes. Derived
+///classes that store this should override it, to avoid copying the HyperVolume.
+HyperCuboid HyperBinning::getHyperVolumeLimits(int volumeNumber) const{
+  return getHyperVolume(volumeNumber).getLimits();
+}
+
 ///Update the miniumum and maximum values, _minmax, 
 ///in the cashe. Will usually be called from updateCash().
 void HyperBinning::updateMinMax() const{
   
   int dim = getDimension(); 
 
-  HyperPoint min(dim);
-  HyperPoint max(dim);
-  
-  for (int d = 0; d < dim; d++){
-    min.at(d) = getHyperVolume(0).getMin(d);
-    max.at(d) = getHyperVolume(0).getMax(d);
-  }
+  HyperCuboid firstLimits = getHyperVolumeLimits(0);
+  HyperPoint min = firstLimits.getLowCorner ();
+  HyperPoint max = firstLimits.getHighCorner();
   
   int nPrimVols = getNumPrimaryVolumes();
   
@@ -271,10 +296,10 @@ void HyperBinning::updateMinMax() const{
     }
 
     for(int i = 1; i < getNumHyperVolumes(); i++){
-      HyperVolume thisVol = getHyperVolume(i);
+      HyperCuboid thisLimits = getHyperVolumeLimits(i);
       for (int d = 0; d < dim; d++){
-        if (min.at(d) > thisVol.getMin(d)) min.at(d) = thisVol.getMin(d);
-        if (max.at(d) < thisVol.getMax(d)) max.at(d) = thisVol.getMax(d);
+        if (min.at(d) > thisLimits.getLowCorner ().at(d)) min.at(d) = thisLimits.getLowCorner ().at(d);
+        if (max.at(d) < thisLimits.getHighCorner().at(d)) max.at(d) = thisLimits.getHighCorner().at(d);
       }
     }
 
@@ -283,10 +308,10 @@ void HyperBinning::updateMinMax() const{
   else{
 
     for(int i = 1; i < getNumPrimaryVolumes(); i++){
-      HyperVolume thisVol = getHyperVolume( getPrimaryVolumeNumber(i) );
+      HyperCuboid thisLimits = getHyperVolumeLimits( getPrimaryVolumeNumber(i) );
       for (int d = 0; d < dim; d++){
-        if (min.at(d) > thisVol.getMin(d)) min.at(d) = thisVol.getMin(d);
-        if (max.at(d) < thisVol.getMax(d)) max.at(d) = thisVol.getMax(d);
+        if (min.at(d) > thisLimits.getLowCorner ().at(d)) min.at(d) = thisLimits.getLowCorner ().at(d);
+        if (max.at(d) < thisLimits.getHighCorner().at(d)) max.at(d) = thisLimits.getHighCorner().at(d);
       }
     }    
 
@@ -296,6 +321,128 @@ void HyperBinning::updateMinMax() const{
   _minmax.updated();
 }
 
+///Update the spatial index over the primary volumes, _rootVolumeIndex,
+///in the cashe. A flat binning (no primary volumes and no linked bins) 
+///gets an index over all of its HyperVolumes instead, since getBinNum() 
+///then has to test all of them. If there are no primary volumes but there
+///are linked bins, the first HyperVolume is usually the top of the 
+///hierarchy and is found straight away, so no index is built. It is also
+///left empty if there are only a few volumes to cover.
+void HyperBinning::updateRootVolumeIndex() const{
+
+  int dim       = getDimension();
+  int nPrimVols = getNumPrimaryVolumes();
+  int nRoots    = nPrimVols == 0 ? getNumHyperVolumes() : nPrimVols;
+
+  bool isFlat = true;
+  for (int i = 0; i < getNumHyperVolumes() && nPrimVols == 0 && isFlat; i++){
+    if (getNumLinkedHyperVolumes(i) > 0) isFlat = false;
+  }
+
+  if (nRoots < _minIndexedVolumes || isFlat == false){
+    _rootVolumeIndex.get().clear();
+    _rootVolumeIndex.updated();
+    return;
+  }
+
+  std::vector<double> boxes(2*dim*nRoots);
+  for (int i = 0; i < nRoots; i++){
+    HyperCuboid limits = getHyperVolumeLimits( nPrimVols == 0 ? i : getPrimaryVolumeNumber(i) );
+    for (int d = 0; d < dim; d++){
+      boxes[2*dim*i + d]       = limits.getLowCorner ().at(d);
+      boxes[2*dim*i + dim + d] = limits.getHighCorner().at(d);
+    }
+  }
+
+  _rootVolumeIndex.get().build(dim, boxes.data(), nRoots);
+  _rootVolumeIndex.updated();
+
+}
+
+///Merge another HyperBinning into this one. The HyperVolumes of the other
+///binning are appended to this one, so the bin numbers of this binning
+///don't change, and the bins of the other binning are numbered after them.
+///Both binnings are then reached through primary volumes: the primary volumes
+///of this binning come first, followed by those of the other one. A binning
+///without primary volumes contributes every HyperVolume that isn't linked 
+///from another one. Where the two binnings overlap, this binning wins.
+void HyperBinning::mergeBinnings( const BinningBase& other ){
+
+  const HyperBinning* otherBinning = dynamic_cast<const HyperBinning*>(&other);
+
+  if (otherBinning == 0){
+    std::cerr << "HyperBinning::mergeBinnings - can only merge with another HyperBinning" << std::endl;
+    return;
+  }
+  if (getNumHyperVolumes() != 0 && otherBinning->getDimension() != getDimension()){
+    std::cerr << "HyperBinning::mergeBinnings - the binnings have different dimensions" << std::endl;
+    return;
+  }
+
+  //The primary volumes of a binning, or its top level HyperVolumes if it has none
+  auto primaryVolumes = [](const HyperBinning& binning) {
+    std::vector<int> primary;
+    if (binning.getNumPrimaryVolumes() > 0){
+      for (int i = 0; i < binning.getNumPrimaryVolumes(); i++) primary.push_back(binning.getPrimaryVolumeNumber(i));
+      return primary;
+    }
+    std::vector<bool> isLinked(binning.getNumHyperVolumes(), false);
+    for (int i = 0; i < binning.getNumHyperVolumes(); i++){
+      for (int j = 0; j < binning.getNumLinkedHyperVolumes(i); j++) isLinked.at(binning.getLinkedHyperVolume(i, j)) = true;
+    }
+    for (int i = 0; i < binning.getNumHyperVolumes(); i++){
+      if (isLinked[i] == false) primary.push_back(i);
+    }
+    return primary;
+  };
+
+  std::vector<int> thisPrimary  = primaryVolumes(*this);
+  std::vector<int> otherPrimary = primaryVolumes(*otherBinning);
+
+  int offset = getNumHyperVolumes();
+
+  //Copy the other binning first, in case it is this binning
+  std::vector<HyperVolume>        volumes;
+  std::vector<std::vector<int> >  links;
+  for (int i = 0; i < otherBinning->getNumHyperVolumes(); i++){
+    volumes.push_back( otherBinning->getHyperVolume(i) );
+    links  .push_back( otherBinning->getLinkedHyperVolumes(i) );
+    for (int& link : links.back()) link += offset;
+  }
+
+  if (getNumPrimaryVolumes() == 0){
+    for (int volumeNumber : thisPrimary) addPrimaryVolumeNumber(volumeNumber);
+  }
+  for (unsigned i = 0; i < volumes.size(); i++){
+    addHyperVolume(volumes[i], links[i]);
+  }
+  for (int volumeNumber : otherPrimary) addPrimaryVolumeNumber(volumeNumber + offset);
+
+  //Build the cashe straight away, so that lookups don't write to it
+  updateBinNumbering();
+  updateMinMax();
+  updateRootVolumeIndex();
+
+}
+
+///Make a read-only copy of the binning that is laid out for fast lookups.
+///The bin and HyperVolume numbers are the same as in this binning.
+HyperBinningFrozen HyperBinning::freeze() const{
+
+  HyperBinningFrozen frozen(getDimension());
+
+  for (int i = 0; i < getNumHyperVolumes(); i++){
+    frozen.addHyperVolume( getHyperVolume(i), getLinkedHyperVolumes(i) );
+  }
+  for (int i = 0; i < getNumPrimaryVolumes(); i++){
+    frozen.addPrimaryVolumeNumber( getPrimaryVolumeNumber(i) );
+  }
+  frozen.buildIndex();
+
+  return frozen;
+
+}
+
 ///Look at the tree that contains the HyperBinning and find the dimensionality
 ///
 int HyperBinning::getHyperBinningDimFromTree(TTree* tree){
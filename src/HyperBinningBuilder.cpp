@@ -0,0 +1,212 @@
+#include "HyperBinningBuilder.h"
+
+#include <iostream>
+
+///Construct an empty builder for a binning of a given dimension
+///
+HyperBinningBuilder::HyperBinningBuilder(int dimension) :
+  _dimension  (dimension),
+  _firstCuboid(1, 0),
+  _firstLink  (1, 0)
+{
+}
+
+///Reserve memory for a known number of HyperVolumes, HyperCuboids and links,
+///so that adding them never needs to reallocate
+void HyperBinningBuilder::reserve(int nVolumes, int nCuboids, int nLinks){
+
+  _cuboidCorners.reserve( 2*_dimension*nCuboids );
+  _firstCuboid  .reserve( nVolumes + 1 );
+  _linkedVolumes.reserve( nLinks );
+  _firstLink    .reserve( nVolumes + 1 );
+
+}
+
+///Add a single HyperVolume, and return its volume number
+///
+int HyperBinningBuilder::addHyperVolume(const HyperVolume& hyperVolume, const std::vector<int>& linkedVolumes){
+
+  if (hyperVolume.getDimension() != _dimension){
+    std::cerr << "This HyperVolume has the wrong dimensionality for this HyperBinningBuilder" << std::endl;
+    return -1;
+  }
+
+  for (int i = 0; i < hyperVolume.size(); i++){
+    const HyperCuboid& cuboid = hyperVolume.at(i);
+    const double* low  = cuboid.getLowCorner ().data();
+    const double* high = cuboid.getHighCorner().data();
+    _cuboidCorners.insert(_cuboidCorners.end(), low , low  + _dimension);
+    _cuboidCorners.insert(_cuboidCorners.end(), high, high + _dimension);
+  }
+  _firstCuboid.push_back( _firstCuboid.back() + hyperVolume.size() );
+
+  _linkedVolumes.insert(_linkedVolumes.end(), linkedVolumes.begin(), linkedVolumes.end());
+  _firstLink.push_back( _linkedVolumes.size() );
+
+  return getNumHyperVolumes() - 1;
+
+}
+
+///Add many HyperVolumes and their linked HyperVolumes at once. The 
+///containers are moved in and released as soon as they have been copied.
+void HyperBinningBuilder::addHyperVolumes(std::vector<HyperVolume>&& hyperVolumes, std::vector< std::vector<int> >&& linkedVolumes){
+
+  std::vector<HyperVolume>         volumes(std::move(hyperVolumes));
+  std::vector< std::vector<int> >  links  (std::move(linkedVolumes));
+
+  if (links.size() != 0 && links.size() != volumes.size()){
+    std::cerr << "HyperBinningBuilder::addHyperVolumes - there must be one list of links for each HyperVolume (or none at all)" << std::endl;
+    return;
+  }
+
+  int nCuboids = 0;
+  int nLinks   = 0;
+  for (const HyperVolume& volume : volumes) nCuboids += volume.size();
+  for (const std::vector<int>& link : links) nLinks += link.size();
+  reserve(getNumHyperVolumes() + volumes.size(), _cuboidCorners.size()/(2*_dimension) + nCuboids, _linkedVolumes.size() + nLinks);
+
+  static const std::vector<int> noLinks;
+  for (unsigned i = 0; i < volumes.size(); i++){
+    addHyperVolume(volumes[i], links.size() == 0 ? noLinks : links[i]);
+  }
+
+}
+
+///Add many HyperVolumes at once from flat arrays. HyperVolume i has nCuboids[i]
+///HyperCuboids and nLinks[i] linked HyperVolumes. cuboidCorners holds all the 
+///HyperCuboids one after the other, each one as the low corner followed by the
+///high corner, and linkedVolumes holds all the links one after the other.
+///nLinks and linkedVolumes can be null if there are no links.
+void HyperBinningBuilder::addHyperVolumes(int nVolumes, const int* nCuboids, const double* cuboidCorners, const int* nLinks, const int* linkedVolumes){
+
+  int totalCuboids = 0;
+  int totalLinks   = 0;
+  for (int i = 0; i < nVolumes; i++){
+    totalCuboids += nCuboids[i];
+    if (nLinks != 0) totalLinks += nLinks[i];
+  }
+  reserve(getNumHyperVolumes() + nVolumes, _cuboidCorners.size()/(2*_dimension) + totalCuboids, _linkedVolumes.size() + totalLinks);
+
+  _cuboidCorners.insert(_cuboidCorners.end(), cuboidCorners, cuboidCorners + 2*_dimension*totalCuboids);
+  if (nLinks != 0) _linkedVolumes.insert(_linkedVolumes.end(), linkedVolumes, linkedVolumes + totalLinks);
+
+  for (int i = 0; i < nVolumes; i++){
+    _firstCuboid.push_back( _firstCuboid.back() + nCuboids[i] );
+    _firstLink  .push_back( _firstLink  .back() + (nLinks == 0 ? 0 : nLinks[i]) );
+  }
+
+}
+
+///Add a primary volume number (see HyperBinningMemRes)
+///
+void HyperBinningBuilder::addPrimaryVolumeNumber(int volumeNumber){
+  _primaryVolumeNumbers.push_back(volumeNumber);
+}
+
+///Add several primary volume numbers (see HyperBinningMemRes)
+///
+void HyperBinningBuilder::addPrimaryVolumeNumbers(const std::vector<int>& volumeNumbers){
+  _primaryVolumeNumbers.insert(_primaryVolumeNumbers.end(), volumeNumbers.begin(), volumeNumbers.end());
+}
+
+///Check everything that has been added. This is done once, in a single pass.
+///
+bool HyperBinningBuilder::validate() const{
+
+  int nVolumes = getNumHyperVolumes();
+  int dim      = _dimension;
+
+  if (dim <= 0){
+    std::cerr << "HyperBinningBuilder - the dimension must be positive" << std::endl;
+    return false;
+  }
+
+  if (nVolumes == 0){
+    std::cerr << "HyperBinningBuilder - there are no HyperVolumes" << std::endl;
+    return false;
+  }
+
+  if ((int)_cuboidCorners.size() != 2*dim*_firstCuboid.back()){
+    std::cerr << "HyperBinningBuilder - the number of HyperCuboid corners doesn't match the number of HyperCuboids" << std::endl;
+    return false;
+  }
+
+  for (int v = 0; v < nVolumes; v++){
+    if (_firstCuboid[v + 1] == _firstCuboid[v]){
+      std::cerr << "HyperBinningBuilder - HyperVolume " << v << " has no HyperCuboids" << std::endl;
+      return false;
+    }
+  }
+
+  for (int c = 0; c < _firstCuboid.back(); c++){
+    for (int d = 0; d < dim; d++){
+      if ( !(_cuboidCorners[2*dim*c + d] < _cuboidCorners[2*dim*c + dim + d]) ){
+        std::cerr << "HyperBinningBuilder - HyperCuboid " << c << " has a low corner that isn't lower than its high corner" << std::endl;
+        return false;
+      }
+    }
+  }
+
+  for (int v = 0; v < nVolumes; v++){
+    for (int i = _firstLink[v]; i < _firstLink[v + 1]; i++){
+      int link = _linkedVolumes[i];
+      if (link < 0 || link >= nVolumes || link == v){
+        std::cerr << "HyperBinningBuilder - HyperVolume " << v << " has an invalid link to HyperVolume " << link << std::endl;
+        return false;
+      }
+    }
+  }
+
+  for (int volumeNumber : _primaryVolumeNumbers){
+    if (volumeNumber < 0 || volumeNumber >= nVolumes){
+      std::cerr << "HyperBinningBuilder - primary volume " << volumeNumber << " does not exist" << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+
+}
+
+///Clear everything that has been added, so the builder can be reused
+///
+void HyperBinningBuilder::clear(){
+
+  _cuboidCorners       .clear();
+  _firstCuboid         .assign(1, 0);
+  _linkedVolumes       .clear();
+  _firstLink           .assign(1, 0);
+  _primaryVolumeNumbers.clear();
+
+}
+
+///Validate everything that has been added and build the HyperBinningMemRes,
+///including all of its caches. The builder is empty afterwards. If anything 
+///is invalid, a null pointer is returned and the builder is left unchanged.
+std::unique_ptr<const HyperBinningMemRes> HyperBinningBuilder::finalize(){
+
+  if (validate() == false) return nullptr;
+
+  std::unique_ptr<HyperBinningMemRes> binning(new HyperBinningMemRes());
+  binning->setDimension(_dimension);
+
+  binning->_cuboidCorners        = std::move(_cuboidCorners);
+  binning->_firstCuboid          = std::move(_firstCuboid);
+  binning->_linkedHyperVolumes   = std::move(_linkedVolumes);
+  binning->_firstLink            = std::move(_firstLink);
+  binning->_primaryVolumeNumbers = std::move(_primaryVolumeNumbers);
+  clear();
+
+  binning->_volumeLimits.resize( 2*_dimension*binning->getNumHyperVolumes() );
+  for (int v = 0; v < binning->getNumHyperVolumes(); v++){
+    binning->updateVolumeLimits(v);
+  }
+
+  binning->updateCash();
+  binning->updateBinNumbering();
+  binning->updateMinMax();
+  binning->updateRootVolumeIndex();
+
+  return std::unique_ptr<const HyperBinningMemRes>(std::move(binning));
+
+}
@@ -0,0 +1,1210 @@
+#include "HyperBinningFrozen.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+///Construct an empty HyperBinningFrozen with a given dimension
+///
+HyperBinningFrozen::HyperBinningFrozen(int dimension) :
+  _dimension    (dimension),
+  _allLimits    (2*dimension),
+  _primaryLimits(2*dimension),
+  _nBins        (0),
+  _hasLabels    (false),
+  _outsideLabel (0)
+{
+  for (int d = 0; d < _dimension; d++){
+    _allLimits    [d] = _primaryLimits[d] =  std::numeric_limits<double>::infinity();
+    _allLimits[_dimension + d] = _primaryLimits[_dimension + d] = -std::numeric_limits<double>::infinity();
+  }
+}
+
+///Add a HyperVolume and its linked HyperVolumes. HyperVolumes must be added 
+///in order of their volume number. Those with no linked HyperVolumes are true 
+///bins, and they are numbered in the order they are added, like in HyperBinning.
+void HyperBinningFrozen::addHyperVolume(const HyperVolume& hyperVolume, const std::vector<int>& linkedVolumes){
+
+  if (hyperVolume.getDimension() != _dimension){
+    std::cerr << "This HyperVolume has the wrong dimensionality for this HyperBinningFrozen" << std::endl;
+    return;
+  }
+
+  HyperVolume sortedVolume(hyperVolume);
+  sortedVolume.sortHyperCuboids();
+
+  Node node;
+  node.firstCuboid = _cuboidCorners.size()/(2*_dimension);
+  node.nCuboids    = sortedVolume.size();
+  node.firstLink   = _linkedVolumes.size();
+  node.nLinks      = linkedVolumes.size();
+  node.binNumber   = linkedVolumes.size() == 0 ? _nBins++ : -1;
+  node.label       = 0;
+
+  for (int i = 0; i < sortedVolume.size(); i++){
+    const HyperCuboid& cuboid = sortedVolume.at(i);
+    for (int d = 0; d < _dimension; d++) _cuboidCorners.push_back(cuboid.getLowCorner ().at(d));
+    for (int d = 0; d < _dimension; d++) _cuboidCorners.push_back(cuboid.getHighCorner().at(d));
+  }
+  HyperCuboid limits = sortedVolume.getLimits();
+  for (int d = 0; d < _dimension; d++) _volumeLimits.push_back(limits.getLowCorner ().at(d));
+  for (int d = 0; d < _dimension; d++) _volumeLimits.push_back(limits.getHighCorner().at(d));
+  _linkedVolumes.append(linkedVolumes.data(), linkedVolumes.data() + linkedVolumes.size());
+
+  _nodes.push_back(node);
+  extendLimits(_allLimits, _nodes.size() - 1);
+  _rootIndex.clear();
+  _rootVolumes.clear();
+  _binsInDepthOrder.clear();
+  _binsBelow.clear();
+
+}
+
+///Add a primary volume number (see HyperBinningMemRes). The HyperVolume
+///must already have been added.
+void HyperBinningFrozen::addPrimaryVolumeNumber(int volumeNumber){
+
+  if (volumeNumber < 0 || volumeNumber >= getNumHyperVolumes()){
+    std::cerr << "HyperBinningFrozen::addPrimaryVolumeNumber - HyperVolume " << volumeNumber << " does not exist" << std::endl;
+    return;
+  }
+
+  _primaryVolumeNumbers.push_back(volumeNumber);
+  extendLimits(_primaryLimits, volumeNumber);
+  _rootIndex.clear();
+  _rootVolumes.clear();
+  _binsInDepthOrder.clear();
+  _binsBelow.clear();
+
+}
+
+///Set the bin labels from the bin contents of a histogram, with the 
+///underflow/overflow bin at the end (like HistogramBase). Every bin content 
+///must be an integer that fits into 16 bits, otherwise no labels are set.
+bool HyperBinningFrozen::setLabels(const std::vector<double>& binContents){
+
+  if ((int)binContents.size() != _nBins + 1){
+    std::cerr << "HyperBinningFrozen::setLabels - expected " << _nBins + 1 << " bin contents, but got " << binContents.size() << std::endl;
+    return false;
+  }
+
+  for (double content : binContents){
+    if (content != std::round(content) || 
+        content < std::numeric_limits<std::int16_t>::min() || 
+        content > std::numeric_limits<std::int16_t>::max()){
+      std::cerr << "HyperBinningFrozen::setLabels - bin content " << content << " is not a 16-bit integer" << std::endl;
+      return false;
+    }
+  }
+
+  for (Node& node : _nodes){
+    if (node.binNumber != -1) node.label = (std::int16_t)binContents[node.binNumber];
+  }
+  _outsideLabel = (std::int16_t)binContents[_nBins];
+  _hasLabels = true;
+  return true;
+
+}
+
+///Build the index over the primary volumes (or all the volumes of a flat
+///binning, which has no primary volumes and no links), once they have all
+///been added. With only a few of them, testing them in turn is just as 
+///fast, so no index is built. See HyperBinning::updateRootVolumeIndex().
+void HyperBinningFrozen::buildIndex(){
+
+  _rootIndex.clear();
+  _rootVolumes.clear();
+  _binsInDepthOrder.clear();
+  _binsBelow.clear();
+
+  const int nPrimVols = _primaryVolumeNumbers.size();
+
+  //Region queries of a binning with links but no primary volumes start
+  //from the HyperVolumes that aren't linked to by any other
+
+  if (nPrimVols == 0 && _linkedVolumes.size() != 0){
+    std::vector<char> isLinked(getNumHyperVolumes(), 0);
+    for (int volumeNumber : _linkedVolumes) isLinked[volumeNumber] = 1;
+    for (int i = 0; i < getNumHyperVolumes(); i++){
+      if (isLinked[i] == 0) _rootVolumes.push_back(i);
+    }
+  }
+
+  //List the bins in the order of a depth-first walk from the roots, so that
+  //the bins below every HyperVolume form a range
+
+  _binsBelow.resize(2*getNumHyperVolumes());
+  std::fill(_binsBelow.begin(), _binsBelow.end(), 0);
+  _binsInDepthOrder.reserve(_nBins);
+
+  const int nRootVolumes = nPrimVols > 0 ? nPrimVols : _rootVolumes.size() > 0 ? _rootVolumes.size() : getNumHyperVolumes();
+  std::vector<std::pair<int, int> > stack; //HyperVolume, and the next of its links to visit
+  for (int r = 0; r < nRootVolumes; r++){
+    int root = nPrimVols > 0 ? _primaryVolumeNumbers[r] : _rootVolumes.size() > 0 ? _rootVolumes[r] : r;
+    stack.push_back(std::make_pair(root, 0));
+    _binsBelow[2*root] = _binsInDepthOrder.size();
+    while (stack.size() > 0){
+      const int volumeNumber = stack.back().first;
+      const Node& node = _nodes[volumeNumber];
+      if (node.binNumber != -1 && stack.back().second == 0) _binsInDepthOrder.push_back(node.binNumber);
+      if (stack.back().second < node.nLinks){
+        int daughter = _linkedVolumes[node.firstLink + stack.back().second++];
+        _binsBelow[2*daughter] = _binsInDepthOrder.size();
+        stack.push_back(std::make_pair(daughter, 0));
+        continue;
+      }
+      _binsBelow[2*volumeNumber + 1] = _binsInDepthOrder.size() - _binsBelow[2*volumeNumber];
+      stack.pop_back();
+    }
+  }
+  const int nRoots    = nPrimVols == 0 ? getNumHyperVolumes() : nPrimVols;
+  if (nRoots < _minIndexedVolumes) return;
+  if (nPrimVols == 0 && _linkedVolumes.size() != 0) return;
+
+  if (nPrimVols == 0){
+    _rootIndex.build(_dimension, _volumeLimits.data(), nRoots);
+    return;
+  }
+
+  std::vector<double> boxes;
+  boxes.reserve(2*_dimension*nPrimVols);
+  for (int volumeNumber : _primaryVolumeNumbers){
+    boxes.insert(boxes.end(), getVolumeLimits(volumeNumber), getVolumeLimits(volumeNumber) + 2*_dimension);
+  }
+  _rootIndex.build(_dimension, boxes.data(), nPrimVols);
+
+}
+
+///Write the binning, including its labels and index, into an image.
+///The image starts with ImageVersion and the size of a node, so that an
+///image from an incompatible build is never mapped.
+void HyperBinningFrozen::writeImage(ImageWriter& writer) const{
+
+  writer.write(ImageVersion);
+  writer.write<std::uint32_t>(sizeof(Node));
+  writer.write(_dimension);
+  writer.write(_nBins);
+  writer.write(_hasLabels);
+  writer.write(_outsideLabel);
+  writer.write(_nodes);
+  writer.write(_cuboidCorners);
+  writer.write(_volumeLimits);
+  writer.write(_linkedVolumes);
+  writer.write(_primaryVolumeNumbers);
+  writer.write(_allLimits);
+  writer.write(_primaryLimits);
+  writer.write(_rootVolumes);
+  writer.write(_binsInDepthOrder);
+  writer.write(_binsBelow);
+  _rootIndex.writeImage(writer);
+
+}
+
+///Map the binning onto an image written by writeImage(), without copying
+///it. The image must outlive the binning, and any copies of it. Returns 
+///false (and leaves the binning unchanged) if the image is damaged or was
+///written by an incompatible build.
+bool HyperBinningFrozen::readImage(ImageReader& reader){
+
+  std::uint32_t version  = 0;
+  std::uint32_t nodeSize = 0;
+  reader.read(version);
+  reader.read(nodeSize);
+  if (version != ImageVersion || nodeSize != sizeof(Node)){
+    std::cerr << "HyperBinningFrozen::readImage - the image has version " << version << " and a node size of " << nodeSize;
+    std::cerr << ", but version " << ImageVersion << " and a node size of " << sizeof(Node) << " are needed" << std::endl;
+    return false;
+  }
+
+  HyperBinningFrozen binning;
+  reader.read(binning._dimension);
+  reader.read(binning._nBins);
+  reader.read(binning._hasLabels);
+  reader.read(binning._outsideLabel);
+  reader.read(binning._nodes);
+  reader.read(binning._cuboidCorners);
+  reader.read(binning._volumeLimits);
+  reader.read(binning._linkedVolumes);
+  reader.read(binning._primaryVolumeNumbers);
+  reader.read(binning._allLimits);
+  reader.read(binning._primaryLimits);
+  reader.read(binning._rootVolumes);
+  reader.read(binning._binsInDepthOrder);
+  reader.read(binning._binsBelow);
+  const int nIndexed = binning._primaryVolumeNumbers.size() > 0 ? binning._primaryVolumeNumbers.size() : binning._nodes.size();
+  bool indexOk = binning._rootIndex.readImage(reader, nIndexed);
+
+  const std::size_t dim = binning._dimension;
+  bool isOk = reader.isOk() && indexOk && binning._dimension > 0 &&
+              binning._volumeLimits .size() == 2*dim*binning._nodes.size() &&
+              binning._allLimits    .size() == 2*dim &&
+              binning._primaryLimits.size() == 2*dim &&
+              binning._cuboidCorners.size() %  (2*dim) == 0 &&
+              (binning._binsBelow.size() == 0 || binning._binsBelow.size() == 2*binning._nodes.size()) &&
+              (binning._rootIndex.getNumItems() == 0 || binning._rootIndex.getDimension() == binning._dimension) &&
+              binning.checkIndices();
+
+  if (isOk == false){
+    std::cerr << "HyperBinningFrozen::readImage - the image is damaged" << std::endl;
+    return false;
+  }
+
+  *this = binning;
+  return true;
+
+}
+
+///Check if every array of the binning is mapped onto an image, i.e. if
+///none of them has been copied since it was read with readImage()
+bool HyperBinningFrozen::isMapped() const{
+
+  return _nodes               .isMapped() && _cuboidCorners   .isMapped() &&
+         _volumeLimits        .isMapped() && _linkedVolumes   .isMapped() &&
+         _primaryVolumeNumbers.isMapped() && _allLimits       .isMapped() &&
+         _primaryLimits       .isMapped() && _rootVolumes     .isMapped() &&
+         _binsInDepthOrder    .isMapped() && _binsBelow       .isMapped() &&
+         _rootIndex           .isMapped();
+
+}
+
+///Check that every index stored in the arrays points inside the array it
+///refers to, and that the links never lead back to where they started, so
+///that a binning read from a damaged image can't be read out of bounds or
+///send a lookup round in circles
+bool HyperBinningFrozen::checkIndices() const{
+
+  const long nNodes   = _nodes.size();
+  const long nCuboids = _cuboidCorners.size()/(2*_dimension);
+  const long nLinks   = _linkedVolumes.size();
+
+  if (_nBins < 0) return false;
+
+  for (const Node& node : _nodes){
+    if (node.firstCuboid < 0 || node.nCuboids < 0 || (long)node.firstCuboid + node.nCuboids > nCuboids) return false;
+    if (node.firstLink   < 0 || node.nLinks   < 0 || (long)node.firstLink   + node.nLinks   > nLinks  ) return false;
+    if (node.binNumber < -1 || node.binNumber >= _nBins) return false;
+  }
+
+  for (int volumeNumber : _linkedVolumes       ) if (volumeNumber < 0 || volumeNumber >= nNodes) return false;
+  for (int volumeNumber : _primaryVolumeNumbers) if (volumeNumber < 0 || volumeNumber >= nNodes) return false;
+  for (int volumeNumber : _rootVolumes         ) if (volumeNumber < 0 || volumeNumber >= nNodes) return false;
+  for (int binNumber    : _binsInDepthOrder    ) if (binNumber    < 0 || binNumber    >= _nBins) return false;
+
+  for (std::size_t i = 0; i < _binsBelow.size(); i += 2){
+    if (_binsBelow[i] < 0 || _binsBelow[i + 1] < 0 || (long)_binsBelow[i] + _binsBelow[i + 1] > (long)_binsInDepthOrder.size()) return false;
+  }
+
+  //Look for a loop in the links with a depth-first walk, where a HyperVolume
+  //is on the stack (1) until everything below it has been visited (2)
+
+  std::vector<char> state(nNodes, 0);
+  std::vector<std::pair<int, int> > stack; //HyperVolume, and the next of its links to visit
+  for (int root = 0; root < nNodes; root++){
+    if (state[root] != 0) continue;
+    state[root] = 1;
+    stack.push_back(std::make_pair(root, 0));
+    while (stack.size() > 0){
+      const Node& node = _nodes[stack.back().first];
+      if (stack.back().second < node.nLinks){
+        int daughter = _linkedVolumes[node.firstLink + stack.back().second++];
+        if (state[daughter] == 1) return false;
+        if (state[daughter] == 2) continue;
+        state[daughter] = 1;
+        stack.push_back(std::make_pair(daughter, 0));
+        continue;
+      }
+      state[stack.back().first] = 2;
+      stack.pop_back();
+    }
+  }
+
+  return true;
+
+}
+
+namespace {
+
+  const char FileMagic[8] = {'H', 'B', 'F', 'R', 'O', 'Z', 'E', 'N'};
+
+}
+
+///Save the binning into a binary scheme file, which is a short header 
+///followed by the image of the binning (see writeImage())
+bool HyperBinningFrozen::save(const std::string& filename) const{
+
+  ImageWriter counter;
+  writeImage(counter);
+
+  std::vector<char> contents(_fileHeaderSize + counter.getSize(), 0);
+  const std::uint64_t imageSize = counter.getSize();
+  std::memcpy(contents.data(), FileMagic, sizeof(FileMagic));
+  std::memcpy(contents.data() + 8 , &FileVersion, sizeof(FileVersion));
+  std::memcpy(contents.data() + 16, &imageSize  , sizeof(imageSize  ));
+
+  ImageWriter writer(contents.data() + _fileHeaderSize);
+  writeImage(writer);
+
+  std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+  file.write(contents.data(), contents.size());
+  file.close();
+
+  if (!file){
+    std::cerr << "HyperBinningFrozen::save - could not write " << filename << std::endl;
+    return false;
+  }
+  return true;
+
+}
+
+///Load a binning from a binary scheme file written by save(). The file is 
+///read into memory once, and the binning is mapped onto it, so nothing is 
+///copied after that. Returns false (and leaves the binning unchanged) if the
+///file can't be read, or was written by an incompatible build.
+bool HyperBinningFrozen::load(const std::string& filename){
+
+  std::ifstream file(filename, std::ios::binary | std::ios::ate);
+  if (!file){
+    std::cerr << "HyperBinningFrozen::load - could not open " << filename << std::endl;
+    return false;
+  }
+  const std::size_t fileSize = file.tellg();
+  file.seekg(0);
+
+  //The arrays of the image start on cache lines, so the image has to as well
+
+  std::shared_ptr<char> buffer(new char[fileSize + ImageWriter::Alignment], std::default_delete<char[]>());
+  char* contents = buffer.get() + (ImageWriter::Alignment - (std::uintptr_t)buffer.get() % ImageWriter::Alignment) % ImageWriter::Alignment;
+  file.read(contents, fileSize);
+
+  std::uint32_t version   = 0;
+  std::uint64_t imageSize = 0;
+  if (file && fileSize >= _fileHeaderSize){
+    std::memcpy(&version  , contents + 8 , sizeof(version  ));
+    std::memcpy(&imageSize, contents + 16, sizeof(imageSize));
+  }
+  if (!file || fileSize < _fileHeaderSize || std::memcmp(contents, FileMagic, sizeof(FileMagic)) != 0 || version != FileVersion ||
+      imageSize > fileSize - _fileHeaderSize){
+    std::cerr << "HyperBinningFrozen::load - " << filename << " is not a binary scheme file of this version" << std::endl;
+    return false;
+  }
+
+  HyperBinningFrozen binning;
+  ImageReader reader(contents + _fileHeaderSize, imageSize);
+  if (binning.readImage(reader) == false) return false;
+
+  binning._file = std::shared_ptr<const char>(buffer, contents);
+  *this = binning;
+  return true;
+
+}
+
+///Extend limits (low corner then high corner) so that they 
+///surround a node
+void HyperBinningFrozen::extendLimits(MappableArray<double>& limits, int volumeNumber) const{
+
+  const double* low  = _volumeLimits.data() + 2*_dimension*volumeNumber;
+  const double* high = low + _dimension;
+  for (int d = 0; d < _dimension; d++){
+    if (limits[d]              > low [d]) limits[d]              = low [d];
+    if (limits[_dimension + d] < high[d]) limits[_dimension + d] = high[d];
+  }
+
+}
+
+///Get the HyperCuboid that surrounds the binning, in the same way
+///as HyperBinning::getLimits()
+HyperCuboid HyperBinningFrozen::getLimits() const{
+
+  const MappableArray<double>& limits = _primaryVolumeNumbers.size() == 0 ? _allLimits : _primaryLimits;
+
+  HyperCuboid cuboid(_dimension);
+  for (int d = 0; d < _dimension; d++){
+    cuboid.getLowCorner ().at(d) = limits[d];
+    cuboid.getHighCorner().at(d) = limits[_dimension + d];
+  }
+  return cuboid;
+
+}
+
+///Get a copy of one of the HyperVolumes
+///
+HyperVolume HyperBinningFrozen::getHyperVolume(int volumeNumber) const{
+
+  HyperVolume hyperVolume(_dimension);
+  for (int i = 0; i < getNumHyperCuboids(volumeNumber); i++){
+    HyperCuboid cuboid(_dimension);
+    for (int d = 0; d < _dimension; d++){
+      cuboid.getLowCorner ().at(d) = getLowCorner (volumeNumber, i)[d];
+      cuboid.getHighCorner().at(d) = getHighCorner(volumeNumber, i)[d];
+    }
+    hyperVolume.addHyperCuboid(cuboid);
+  }
+  return hyperVolume;
+
+}
+
+///Get a 64-bit hash of the layout of the binning: its HyperCuboids, links,
+///bin numbers and primary volumes, but not its labels. Files derived from a
+///binning (see BinAdjacency) store it to check that they still match.
+std::uint64_t HyperBinningFrozen::getFingerprint() const{
+
+  //FNV-1a over the bytes of every value
+  std::uint64_t hash = 14695981039346656037ull;
+  auto add = [&](const void* data, std::size_t nBytes){
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < nBytes; i++) hash = (hash ^ bytes[i])*1099511628211ull;
+  };
+
+  add(&_dimension, sizeof(_dimension));
+  for (const Node& node : _nodes){
+    add(&node.nCuboids , sizeof(node.nCuboids ));
+    add(&node.nLinks   , sizeof(node.nLinks   ));
+    add(&node.binNumber, sizeof(node.binNumber));
+  }
+  add(_cuboidCorners       .data(), _cuboidCorners       .size()*sizeof(double));
+  add(_linkedVolumes       .data(), _linkedVolumes       .size()*sizeof(int   ));
+  add(_primaryVolumeNumbers.data(), _primaryVolumeNumbers.size()*sizeof(int   ));
+  return hash;
+
+}
+
+///Check if coords falls inside the limits of the binning
+///
+bool HyperBinningFrozen::inLimits(const double* coords) const{
+
+  const double* limits = _primaryVolumeNumbers.size() == 0 ? _allLimits.data() : _primaryLimits.data();
+  for (int d = 0; d < _dimension; d++){
+    if ( !(limits[d] < coords[d] && coords[d] <= limits[_dimension + d]) ) return false;
+  }
+  return true;
+
+}
+
+///Check if coords falls in any of the HyperCuboids of a node. If there is
+///more than one, first check the HyperCuboid that surrounds them.
+bool HyperBinningFrozen::inNode(int volumeNumber, const double* coords) const{
+
+  const Node& node = _nodes[volumeNumber];
+
+  if (node.nCuboids > 1){
+    const double* low  = _volumeLimits.data() + 2*_dimension*volumeNumber;
+    const double* high = low + _dimension;
+    for (int d = 0; d < _dimension; d++){
+      if ( !(low[d] < coords[d] && coords[d] <= high[d]) ) return false;
+    }
+  }
+
+  const double* low = _cuboidCorners.data() + 2*_dimension*node.firstCuboid;
+  for (int c = 0; c < node.nCuboids; c++, low += 2*_dimension){
+    const double* high = low + _dimension;
+    bool inCuboid = true;
+    for (int d = 0; d < _dimension; d++){
+      if ( !(low[d] < coords[d] && coords[d] <= high[d]) ) { inCuboid = false; break; }
+    }
+    if (inCuboid) return true;
+  }
+  return false;
+
+}
+
+///Find the first primary volume (or any volume, if there are no
+///primary volumes) that contains coords, or -1 if there is none
+int HyperBinningFrozen::findPrimaryVolume(const double* coords) const{
+
+  if (inLimits(coords) == false) return -1;
+
+  if (_rootIndex.getNumItems() > 0){
+    if (_primaryVolumeNumbers.size() == 0){
+      return _rootIndex.findFirst(coords, [&](int i){ return inNode(i, coords); });
+    }
+    int i = _rootIndex.findFirst(coords, [&](int i){ return inNode(_primaryVolumeNumbers[i], coords); });
+    return i == -1 ? -1 : _primaryVolumeNumbers[i];
+  }
+
+  int nRoots = _primaryVolumeNumbers.size() == 0 ? getNumHyperVolumes() : _primaryVolumeNumbers.size();
+  for (int i = 0; i < nRoots; i++){
+    int thisVolNum = _primaryVolumeNumbers.size() == 0 ? i : _primaryVolumeNumbers[i];
+    if (inNode(thisVolNum, coords)) return thisVolNum;
+  }
+  return -1;
+
+}
+
+///Follow the linked HyperVolumes from volumeNumber, which must contain 
+///coords, down to the true bin that contains coords. Returns -1 if the 
+///trail goes cold, or if volumeNumber is -1.
+int HyperBinningFrozen::followLinks(int volumeNumber, const double* coords) const{
+
+  while (volumeNumber != -1 && _nodes[volumeNumber].nLinks > 0){
+    const Node& mother = _nodes[volumeNumber];
+    volumeNumber = -1;
+    for (int i = mother.firstLink; i < mother.firstLink + mother.nLinks; i++){
+      int daughter = _linkedVolumes[i];
+      if (inNode(daughter, coords)) { volumeNumber = daughter; break; }
+    }
+  }
+
+  return volumeNumber;
+
+}
+
+///Follow the linked HyperVolumes from volumeNumber, like above, but stop
+///after maxDepth steps, or at the first HyperVolume with at most maxBins
+///bins below it (see getNumBinsBelow()), whichever comes first
+int HyperBinningFrozen::followLinks(int volumeNumber, const double* coords, int maxDepth, int maxBins) const{
+
+  for (int depth = 0; depth < maxDepth && volumeNumber != -1 && _nodes[volumeNumber].nLinks > 0; depth++){
+    if (_binsBelow.size() != 0 && _binsBelow[2*volumeNumber + 1] <= maxBins) break;
+    const Node& mother = _nodes[volumeNumber];
+    volumeNumber = -1;
+    for (int i = mother.firstLink; i < mother.firstLink + mother.nLinks; i++){
+      int daughter = _linkedVolumes[i];
+      if (inNode(daughter, coords)) { volumeNumber = daughter; break; }
+    }
+  }
+
+  return volumeNumber;
+
+}
+
+///Get the number of the HyperVolume (with no linked HyperVolumes) that 
+///coords falls into, or -1 if it's outside the binning. This follows 
+///the same steps as HyperBinning::getBinNum().
+int HyperBinningFrozen::getVolumeNumber(const double* coords) const{
+
+  return followLinks(findPrimaryVolume(coords), coords);
+
+}
+
+///Get the number of the HyperVolume that coords falls into at a given 
+///depth of the hierarchy, where the primary volumes are at depth zero. If 
+///coords reaches a bin at a smaller depth, that bin is returned. Returns -1
+///if coords is outside the binning, or falls through a gap in the hierarchy.
+int HyperBinningFrozen::getVolumeNumberAtDepth(const double* coords, int depth) const{
+
+  return followLinks(findPrimaryVolume(coords), coords, depth, 0);
+
+}
+
+///Get the number of the first HyperVolume on the way down to the bin that
+///coords falls into with at most maxBins bins below it. This needs 
+///buildIndex(), without it the lookup goes all the way down to the bin.
+int HyperBinningFrozen::getVolumeNumberAtSize(const double* coords, int maxBins) const{
+
+  return followLinks(findPrimaryVolume(coords), coords, std::numeric_limits<int>::max(), maxBins);
+
+}
+
+///Get the label of a HyperVolume that is a true bin, or of the outside of
+///the binning if volumeNumber is -1. If no labels are set, this is the bin
+///number, like getLabel().
+int HyperBinningFrozen::getLabelOfVolume(int volumeNumber) const{
+
+  if (_hasLabels == false) return getBinNum(volumeNumber);
+  if (volumeNumber == -1) return _outsideLabel;
+  return _nodes[volumeNumber].label;
+
+}
+
+///Get the distance from coords to the nearest face of the HyperCuboid of 
+///a HyperVolume that contains it, where volumeNumber is usually the result
+///of a lookup. For a bin made of a single HyperCuboid, this is the distance
+///to the nearest bin boundary. For a bin made of several, the faces between
+///its HyperCuboids are counted as well, so it is a lower bound. Returns -1 
+///if volumeNumber is -1, or coords isn't inside the HyperVolume.
+double HyperBinningFrozen::getDistanceToBoundary(int volumeNumber, const double* coords) const{
+
+  if (volumeNumber == -1) return -1.0;
+
+  const Node& node = _nodes[volumeNumber];
+  for (int i = 0; i < node.nCuboids; i++){
+    const double* low  = _cuboidCorners.data() + 2*_dimension*(node.firstCuboid + i);
+    const double* high = low + _dimension;
+    double distance = std::numeric_limits<double>::infinity();
+    for (int d = 0; d < _dimension && distance >= 0.0; d++){
+      if ( !(low[d] < coords[d] && coords[d] <= high[d]) ) distance = -1.0;
+      else distance = std::min(distance, std::min(coords[d] - low[d], high[d] - coords[d]));
+    }
+    if (distance >= 0.0) return distance;
+  }
+  return -1.0;
+
+}
+
+///Check if any of the HyperCuboids of a node overlaps the region from 
+///low to high (including its faces)
+bool HyperBinningFrozen::overlapsNode(int volumeNumber, const double* low, const double* high) const{
+
+  const Node& node = _nodes[volumeNumber];
+
+  const double* limits = _volumeLimits.data() + 2*_dimension*volumeNumber;
+  for (int d = 0; d < _dimension; d++){
+    if ( !(limits[d] < high[d] && low[d] <= limits[_dimension + d]) ) return false;
+  }
+  if (node.nCuboids == 1) return true;
+
+  const double* cuboidLow = _cuboidCorners.data() + 2*_dimension*node.firstCuboid;
+  for (int c = 0; c < node.nCuboids; c++, cuboidLow += 2*_dimension){
+    const double* cuboidHigh = cuboidLow + _dimension;
+    bool overlaps = true;
+    for (int d = 0; d < _dimension; d++){
+      if ( !(cuboidLow[d] < high[d] && low[d] <= cuboidHigh[d]) ) { overlaps = false; break; }
+    }
+    if (overlaps) return true;
+  }
+  return false;
+
+}
+
+///Find the HyperVolumes that are true bins and overlap the region from
+///low to high. Only the branches of the bin hierarchy that overlap the 
+///region are followed. The volume numbers are in no particular order.
+void HyperBinningFrozen::getVolumesInRegion(const double* low, const double* high, std::vector<int>& volumeNumbers) const{
+
+  volumeNumbers.clear();
+
+  const int nPrimVols = _primaryVolumeNumbers.size();
+  std::vector<int> stack;
+
+  //Start from the primary volumes (or the volumes of a flat binning) that
+  //overlap the region. A binning with links but no primary volumes starts
+  //from the HyperVolumes that aren't linked to by any other, which takes a
+  //pass over all of them if buildIndex() hasn't found them yet
+
+  if (_rootIndex.getNumItems() > 0){
+    _rootIndex.findOverlapping(low, high, [&](int i){ stack.push_back(nPrimVols == 0 ? i : _primaryVolumeNumbers[i]); });
+  }
+  else if (nPrimVols > 0){
+    stack.assign(_primaryVolumeNumbers.begin(), _primaryVolumeNumbers.end());
+  }
+  else if (_linkedVolumes.size() == 0){
+    for (int i = getNumHyperVolumes() - 1; i >= 0; i--) stack.push_back(i);
+  }
+  else if (_rootVolumes.size() != 0){
+    stack.assign(_rootVolumes.begin(), _rootVolumes.end());
+  }
+  else {
+    std::vector<char> isLinked(getNumHyperVolumes(), 0);
+    for (int volumeNumber : _linkedVolumes) isLinked[volumeNumber] = 1;
+    for (int i = getNumHyperVolumes() - 1; i >= 0; i--){
+      if (isLinked[i] == 0) stack.push_back(i);
+    }
+  }
+
+  while (stack.size() > 0){
+
+    const int volumeNumber = stack.back();
+    stack.pop_back();
+    if (overlapsNode(volumeNumber, low, high) == false) continue;
+
+    const Node& node = _nodes[volumeNumber];
+    if (node.nLinks == 0) { volumeNumbers.push_back(volumeNumber); continue; }
+    for (int i = node.firstLink + node.nLinks - 1; i >= node.firstLink; i--) stack.push_back(_linkedVolumes[i]);
+
+  }
+
+}
+
+///Find the bins that overlap the region from low to high, sorted by bin 
+///number. If overlapFractions is given, it is filled with the fraction of
+///the volume of each bin that is inside the region.
+void HyperBinningFrozen::getBinsInRegion(const double* low, const double* high, std::vector<int>& binNumbers, std::vector<double>* overlapFractions) const{
+
+  std::vector<int> volumeNumbers;
+  getVolumesInRegion(low, high, volumeNumbers);
+  std::sort(volumeNumbers.begin(), volumeNumbers.end(), [&](int a, int b){ return getBinNum(a) < getBinNum(b); });
+
+  binNumbers.resize(volumeNumbers.size());
+  for (unsigned i = 0; i < volumeNumbers.size(); i++) binNumbers[i] = getBinNum(volumeNumbers[i]);
+
+  if (overlapFractions == 0) return;
+  overlapFractions->resize(volumeNumbers.size());
+  for (unsigned i = 0; i < volumeNumbers.size(); i++) (*overlapFractions)[i] = getOverlapFraction(volumeNumbers[i], low, high);
+
+}
+
+///Find the bins that overlap a HyperCuboid, see above
+///
+void HyperBinningFrozen::getBinsInRegion(const HyperCuboid& region, std::vector<int>& binNumbers, std::vector<double>* overlapFractions) const{
+
+  if (region.getDimension() != _dimension) {
+    std::cerr << "HyperBinningFrozen::getBinsInRegion - HyperCuboid has the wrong dimension" << std::endl;
+    binNumbers.clear();
+    if (overlapFractions != 0) overlapFractions->clear();
+    return;
+  }
+  getBinsInRegion(region.getLowCorner().data(), region.getHighCorner().data(), binNumbers, overlapFractions);
+
+}
+
+///Get the fraction of the volume of a HyperVolume that is inside the 
+///region from low to high. This is zero for a slice.
+double HyperBinningFrozen::getOverlapFraction(int volumeNumber, const double* low, const double* high) const{
+
+  double volume  = 0.0;
+  double overlap = 0.0;
+
+  for (int c = 0; c < getNumHyperCuboids(volumeNumber); c++){
+    const double* cuboidLow  = getLowCorner (volumeNumber, c);
+    const double* cuboidHigh = getHighCorner(volumeNumber, c);
+    double cuboidVolume  = 1.0;
+    double cuboidOverlap = 1.0;
+    for (int d = 0; d < _dimension; d++){
+      cuboidVolume  *= cuboidHigh[d] - cuboidLow[d];
+      cuboidOverlap *= std::max(0.0, std::min(cuboidHigh[d], high[d]) - std::max(cuboidLow[d], low[d]));
+    }
+    volume  += cuboidVolume;
+    overlap += cuboidOverlap;
+  }
+
+  return volume > 0.0 ? overlap/volume : 0.0;
+
+}
+
+namespace {
+
+  ///Get the pixels first <= i < last whose centres, at 
+  ///rasterLow + (i + 0.5)*width, fall in (low, high]
+  void getPixelRange(double low, double high, int nPixels, double rasterLow, double width, int& first, int& last){
+
+    auto centre = [&](int i){ return rasterLow + (i + 0.5)*width; };
+
+    first = (int)std::max(0.0, std::min((double)nPixels, std::ceil ((low  - rasterLow)/width - 0.5)    ));
+    last  = (int)std::max(0.0, std::min((double)nPixels, std::floor((high - rasterLow)/width - 0.5) + 1));
+
+    //Correct for rounding, so that the pixels are exactly the ones a 
+    //lookup at their centres would put inside
+    while (first < nPixels && centre(first) <= low) first++;
+    while (first > 0 && centre(first - 1) > low) first--;
+    while (last > 0 && centre(last - 1) > high) last--;
+    while (last < nPixels && centre(last) <= high) last++;
+
+  }
+
+}
+
+///Fill labels with the label at the centre of each pixel of a slice through
+///dimensions dimX and dimY, with the other dimensions fixed at coords (whose
+///elements dimX and dimY are ignored). The slice has nX pixels from lowX to 
+///highX, and nY pixels from lowY to highY, and pixel (i, j) is stored in 
+///labels[j*nX + i]. Pixels outside the binning get the outside label. If no
+///labels are set, the bin numbers are filled in instead, like getLabel().
+///Where HyperVolumes overlap, a pixel gets the bin that a lookup tests
+///first, once buildIndex() has been called. Each pixel matches a lookup at
+///its centre as long as the linked HyperVolumes of every HyperVolume stay
+///inside it and leave no gaps (see BinningValidator), as a lookup gives up
+///on a point that falls into a gap, and never finds the part of a linked
+///HyperVolume that sticks out.
+bool HyperBinningFrozen::rasteriseSlice(const double* coords, int dimX, int nX, double lowX, double highX,
+                                                              int dimY, int nY, double lowY, double highY, int* labels) const{
+
+  if (dimX < 0 || dimX >= _dimension || dimY < 0 || dimY >= _dimension || dimX == dimY){
+    std::cerr << "HyperBinningFrozen::rasteriseSlice - the slice needs two different dimensions of the binning" << std::endl;
+    return false;
+  }
+  if (nX <= 0 || nY <= 0 || !(highX > lowX) || !(highY > lowY)){
+    std::cerr << "HyperBinningFrozen::rasteriseSlice - the slice needs at least one pixel, and a positive width" << std::endl;
+    return false;
+  }
+
+  std::fill(labels, labels + (std::size_t)nX*nY, getLabelOfVolume(-1));
+
+  const double widthX = (highX - lowX)/nX;
+  const double widthY = (highY - lowY)/nY;
+
+  //The region spanned by the pixel centres
+
+  std::vector<double> low (coords, coords + _dimension);
+  std::vector<double> high(coords, coords + _dimension);
+  low [dimX] = lowX + 0.5*widthX;
+  high[dimX] = lowX + (nX - 0.5)*widthX;
+  low [dimY] = lowY + 0.5*widthY;
+  high[dimY] = lowY + (nY - 0.5)*widthY;
+
+  std::vector<int> volumeNumbers;
+  getVolumesInRegion(low.data(), high.data(), volumeNumbers);
+
+  //The bins are tested in the order of a depth-first walk through the
+  //hierarchy, so fill them in that order, and skip the pixels that an
+  //earlier bin has already filled
+
+  if (_binsBelow.size() != 0){
+    std::sort(volumeNumbers.begin(), volumeNumbers.end(), [&](int a, int b){ return _binsBelow[2*a] < _binsBelow[2*b]; });
+  }
+  std::vector<char> isFilled((std::size_t)nX*nY, 0);
+
+  for (int volumeNumber : volumeNumbers){
+
+    const int label = getLabelOfVolume(volumeNumber);
+
+    for (int c = 0; c < getNumHyperCuboids(volumeNumber); c++){
+      const double* cuboidLow  = getLowCorner (volumeNumber, c);
+      const double* cuboidHigh = getHighCorner(volumeNumber, c);
+
+      bool inSlice = true;
+      for (int d = 0; d < _dimension && inSlice; d++){
+        if (d == dimX || d == dimY) continue;
+        if ( !(cuboidLow[d] < coords[d] && coords[d] <= cuboidHigh[d]) ) inSlice = false;
+      }
+      if (inSlice == false) continue;
+
+      int firstX = 0, lastX = 0, firstY = 0, lastY = 0;
+      getPixelRange(cuboidLow[dimX], cuboidHigh[dimX], nX, lowX, widthX, firstX, lastX);
+      getPixelRange(cuboidLow[dimY], cuboidHigh[dimY], nY, lowY, widthY, firstY, lastY);
+      if (firstX >= lastX) continue;
+
+      for (int j = firstY; j < lastY; j++){
+        for (std::size_t pixel = (std::size_t)j*nX + firstX; pixel < (std::size_t)j*nX + lastX; pixel++){
+          if (isFilled[pixel]) continue;
+          isFilled[pixel] = 1;
+          labels[pixel]   = label;
+        }
+      }
+    }
+
+  }
+
+  return true;
+
+}
+
+namespace {
+
+  ///Ask for the memory from begin to begin + nBytes to be brought into 
+  ///the cache, without waiting for it
+  inline void prefetch(const void* begin, std::size_t nBytes){
+#if defined(__GNUC__)
+    const char* address = static_cast<const char*>(begin);
+    for (std::size_t i = 0; i < nBytes; i += 64) __builtin_prefetch(address + i);
+    __builtin_prefetch(address + nBytes - 1);
+#else
+    (void)begin; (void)nBytes;
+#endif
+  }
+
+}
+
+///Start the lookup of the next point in the batch. Points that are 
+///outside the binning, or whose primary volume is a true bin, are finished
+///straight away. Returns false if there are no points left.
+bool HyperBinningFrozen::startLookup(Lookup& lookup, int& nextPoint, int nPoints, const double* coords, int* volumeNumbers) const{
+
+  while (nextPoint < nPoints){
+    int point = nextPoint++;
+    int volumeNumber = findPrimaryVolume(coords + (std::size_t)point*_dimension);
+    if (volumeNumber != -1 && _nodes[volumeNumber].nLinks > 0){
+      lookup.point        = point;
+      lookup.volumeNumber = volumeNumber;
+      return true;
+    }
+    volumeNumbers[point] = volumeNumber;
+  }
+  return false;
+
+}
+
+///Prefetch the list of HyperVolumes linked to a node
+///
+void HyperBinningFrozen::prefetchLinks(int volumeNumber) const{
+
+  const Node& mother = _nodes[volumeNumber];
+  prefetch(_linkedVolumes.data() + mother.firstLink, mother.nLinks*sizeof(int));
+
+}
+
+///Prefetch the nodes of the HyperVolumes linked to a node
+///
+void HyperBinningFrozen::prefetchLinkedNodes(int volumeNumber) const{
+
+  const Node& mother = _nodes[volumeNumber];
+  for (int i = mother.firstLink; i < mother.firstLink + mother.nLinks; i++){
+    prefetch(&_nodes[_linkedVolumes[i]], sizeof(Node));
+  }
+
+}
+
+///Prefetch what inNode() reads first for each HyperVolume linked to a node
+///
+void HyperBinningFrozen::prefetchLinkedCuboids(int volumeNumber) const{
+
+  const Node& mother = _nodes[volumeNumber];
+  for (int i = mother.firstLink; i < mother.firstLink + mother.nLinks; i++){
+    const Node& daughter = _nodes[_linkedVolumes[i]];
+    if (daughter.nCuboids > 1) prefetch(_volumeLimits .data() + 2*_dimension*_linkedVolumes[i] , 2*_dimension*sizeof(double));
+    else                       prefetch(_cuboidCorners.data() + 2*_dimension*daughter.firstCuboid, 2*_dimension*sizeof(double));
+  }
+
+}
+
+///Move a lookup one level down the bin hierarchy, testing the linked 
+///HyperVolumes in the same order as getVolumeNumber(). Returns false once
+///the lookup is finished and its volume number has been written.
+bool HyperBinningFrozen::descend(Lookup& lookup, const double* coords, int* volumeNumbers) const{
+
+  const Node&   mother = _nodes[lookup.volumeNumber];
+  const double* point  = coords + (std::size_t)lookup.point*_dimension;
+
+  int volumeNumber = -1;
+  for (int i = mother.firstLink; i < mother.firstLink + mother.nLinks; i++){
+    if (inNode(_linkedVolumes[i], point)) { volumeNumber = _linkedVolumes[i]; break; }
+  }
+
+  if (volumeNumber == -1 || _nodes[volumeNumber].nLinks == 0){
+    volumeNumbers[lookup.point] = volumeNumber;
+    return false;
+  }
+  lookup.volumeNumber = volumeNumber;
+  return true;
+
+}
+
+///Walk a batch of points down the bin hierarchy, in the order they are 
+///given. groupSize points are walked down at the same time (see the 
+///class description). Each level is done in four passes over the group:
+///prefetch the links, prefetch the linked nodes, prefetch their 
+///HyperCuboids, and finally test them and move down. Once a point is 
+///finished, the next one in the batch takes its place.
+void HyperBinningFrozen::walkBatch(const double* coords, int nPoints, int* volumeNumbers, int groupSize) const{
+
+  if (groupSize <= 1){
+    for (int i = 0; i < nPoints; i++) volumeNumbers[i] = getVolumeNumber(coords + (std::size_t)i*_dimension);
+    return;
+  }
+  if (groupSize > MaxGroupSize) groupSize = MaxGroupSize;
+
+  Lookup group[MaxGroupSize];
+  int nextPoint = 0;
+  int nInFlight = 0;
+  while (nInFlight < groupSize && startLookup(group[nInFlight], nextPoint, nPoints, coords, volumeNumbers)) nInFlight++;
+
+  while (nInFlight > 0){
+    for (int i = 0; i < nInFlight; i++) prefetchLinks        (group[i].volumeNumber);
+    for (int i = 0; i < nInFlight; i++) prefetchLinkedNodes  (group[i].volumeNumber);
+    for (int i = 0; i < nInFlight; i++) prefetchLinkedCuboids(group[i].volumeNumber);
+    for (int i = 0; i < nInFlight; ){
+      if (descend    (group[i], coords, volumeNumbers))                     { i++; continue; }
+      if (startLookup(group[i], nextPoint, nPoints, coords, volumeNumbers)) { i++; continue; }
+      group[i] = group[--nInFlight];
+    }
+  }
+
+}
+
+///Get the volume numbers of nPoints points, stored back to back in coords.
+///The result is the same as calling getVolumeNumber() for each point. If 
+///the order is MortonOrder or HilbertOrder, the points are first sorted
+///along that curve (see sortPoints()), looked up in the sorted order, and
+///the volume numbers are put back in the order of the input.
+void HyperBinningFrozen::getVolumeNumbers(const double* coords, int nPoints, int* volumeNumbers, int groupSize, PointOrder order) const{
+
+  if (order == InputOrder || nPoints < 2){
+    walkBatch(coords, nPoints, volumeNumbers, groupSize);
+    return;
+  }
+
+  std::vector<int> permutation;
+  sortPoints(coords, nPoints, order, permutation);
+
+  std::vector<double> sortedCoords((std::size_t)nPoints*_dimension);
+  for (int i = 0; i < nPoints; i++){
+    std::copy_n(coords + (std::size_t)permutation[i]*_dimension, _dimension, sortedCoords.data() + (std::size_t)i*_dimension);
+  }
+
+  std::vector<int> sortedVolumeNumbers(nPoints);
+  walkBatch(sortedCoords.data(), nPoints, sortedVolumeNumbers.data(), groupSize);
+  for (int i = 0; i < nPoints; i++) volumeNumbers[permutation[i]] = sortedVolumeNumbers[i];
+
+}
+
+namespace {
+
+  ///Turn the coordinates of a point, each with nBits bits, into the 
+  ///"transposed" form of its distance along a Hilbert curve, using the 
+  ///algorithm of J. Skilling, AIP Conf. Proc. 707, 381 (2004). Interleaving
+  ///the bits of the result gives the distance along the curve.
+  void hilbertTranspose(std::uint32_t* x, int nDim, int nBits){
+
+    const std::uint32_t m = 1u << (nBits - 1);
+
+    //x[0] is kept in a local variable, as every step depends on it
+    std::uint32_t x0 = x[0];
+    for (std::uint32_t q = m; q > 1; q >>= 1){
+      const std::uint32_t p = q - 1;
+      x0 ^= p & (0u - ((x0 & q) != 0));
+      for (int i = 1; i < nDim; i++){
+        //If bit q of x[i] is set, invert the low bits of x[0], 
+        //otherwise swap the low bits of x[0] and x[i]. Written 
+        //without branches, as the bits are effectively random
+        const std::uint32_t set = 0u - ((x[i] & q) != 0);
+        const std::uint32_t t   = (x0 ^ x[i]) & p & ~set;
+        x0   ^= (p & set) | t;
+        x[i] ^= t;
+      }
+    }
+    x[0] = x0;
+
+    for (int i = 1; i < nDim; i++) x[i] ^= x[i - 1];
+    std::uint32_t t = 0;
+    for (std::uint32_t q = m; q > 1; q >>= 1){
+      t ^= (q - 1) & (0u - ((x[nDim - 1] & q) != 0));
+    }
+    for (int i = 0; i < nDim; i++) x[i] ^= t;
+
+  }
+
+  ///Interleave the bits of the coordinates, so that bit b of x[i] becomes 
+  ///bit b*nDim + nDim - 1 - i of the key. spread[j] holds the bits of the 
+  ///byte j spread out in this way.
+  std::uint64_t interleaveBits(const std::uint32_t* x, int nDim, int nBits, const std::uint64_t* spread){
+
+    std::uint64_t key = 0;
+    for (int i = 0; i < nDim; i++){
+      for (int byte = 0; 8*byte < nBits; byte++){
+        key |= spread[(x[i] >> 8*byte) & 0xff] << (8*byte*nDim + nDim - 1 - i);
+      }
+    }
+    return key;
+
+  }
+
+}
+
+///Find the order in which to visit nPoints points, stored back to back in
+///coords, so that they follow a Morton or Hilbert curve. Each coordinate 
+///is scaled to an integer with 63/getDimension() bits within the limits 
+///of the binning. At most 10 bits are used, which is already much finer
+///than the bins of any realistic binning, and points outside the limits 
+///are moved onto them. Points with the same key are kept in their input 
+///order. After this, permutation[i] is the index of the i-th point along
+///the curve. The InputOrder leaves the points as they are.
+void HyperBinningFrozen::sortPoints(const double* coords, int nPoints, PointOrder order, std::vector<int>& permutation) const{
+
+  permutation.resize(nPoints);
+  for (int i = 0; i < nPoints; i++) permutation[i] = i;
+  if (order == InputOrder || nPoints < 2 || _dimension == 0) return;
+
+  const int nBits = std::max(1, std::min(10, 63/_dimension));
+  const double maxCell = (double)((1u << nBits) - 1);
+
+  const double* limits = _primaryVolumeNumbers.size() == 0 ? _allLimits.data() : _primaryLimits.data();
+  std::vector<double> scale(_dimension);
+  for (int d = 0; d < _dimension; d++){
+    const double width = limits[_dimension + d] - limits[d];
+    scale[d] = width > 0.0 && std::isfinite(width) ? (maxCell + 1.0)/width : 0.0;
+  }
+
+  //Only the nBits bits that are used are spread out, so that no shift
+  //goes past the 64 bits of the key
+
+  std::vector<std::uint64_t> spread(256, 0);
+  for (int j = 0; j < 256; j++){
+    for (int b = 0; b < 8 && b < nBits; b++) spread[j] |= (std::uint64_t)((j >> b) & 1) << (b*_dimension);
+  }
+
+  std::vector<std::uint64_t> keys(nPoints);
+  std::vector<std::uint32_t> cell(_dimension);
+  for (int i = 0; i < nPoints; i++){
+    const double* point = coords + (std::size_t)i*_dimension;
+    for (int d = 0; d < _dimension; d++){
+      double x = (point[d] - limits[d])*scale[d];
+      x = x < 0.0 ? 0.0 : (x > maxCell ? maxCell : x);
+      cell[d] = x == x ? (std::uint32_t)x : 0;
+    }
+    if (order == HilbertOrder) hilbertTranspose(cell.data(), _dimension, nBits);
+    keys[i] = interleaveBits(cell.data(), _dimension, nBits, spread.data());
+  }
+
+  //Small batches are sorted by comparison, with ties broken by the input order
+  if (nPoints < 4096){
+    std::sort(permutation.begin(), permutation.end(), [&keys](int a, int b){
+      return keys[a] < keys[b] || (keys[a] == keys[b] && a < b);
+    });
+    return;
+  }
+
+  //Large batches are sorted by a least significant digit radix sort, 11 bits
+  //at a time. Digits that are the same for every key are skipped
+  const int digitBits = 11;
+  const int nDigits   = (nBits*_dimension + digitBits - 1)/digitBits;
+  std::vector<std::uint64_t> keysTmp(nPoints);
+  std::vector<int>           permutationTmp(nPoints);
+  std::vector<int>           count(1 << digitBits);
+  for (int digit = 0; digit < nDigits; digit++){
+    const int shift = digit*digitBits;
+    std::fill(count.begin(), count.end(), 0);
+    for (int i = 0; i < nPoints; i++) count[(keys[i] >> shift) & ((1u << digitBits) - 1)]++;
+    if (*std::max_element(count.begin(), count.end()) == nPoints) continue;
+    int sum = 0;
+    for (int& c : count){ int n = c; c = sum; sum += n; }
+    for (int i = 0; i < nPoints; i++){
+      int position = count[(keys[i] >> shift) & ((1u << digitBits) - 1)]++;
+      keysTmp       [position] = keys[i];
+      permutationTmp[position] = permutation[i];
+    }
+    keys.swap(keysTmp);
+    permutation.swap(permutationTmp);
+  }
+
+}
+
+///Get the bin numbers of nPoints points, stored back to back in coords.
+///See getVolumeNumbers().
+void HyperBinningFrozen::getBinNums(const double* coords, int nPoints, int* binNumbers, int groupSize, PointOrder order) const{
+
+  getVolumeNumbers(coords, nPoints, binNumbers, groupSize, order);
+  for (int i = 0; i < nPoints; i++) binNumbers[i] = getBinNum(binNumbers[i]);
+
+}
+
+///Get the labels of nPoints points, stored back to back in coords.
+///See getVolumeNumbers() and getLabel().
+void HyperBinningFrozen::getLabels(const double* coords, int nPoints, int* labels, int groupSize, PointOrder order) const{
+
+  getVolumeNumbers(coords, nPoints, labels, groupSize, order);
+  for (int i = 0; i < nPoints; i++) labels[i] = getLabelOfVolume(labels[i]);
+
+}
+
+///Get the bin number that coords falls into, or -1 if it's outside
+///the binning. coords must have getDimension() elements.
+int HyperBinningFrozen::getBinNum(const double* coords) const{
+
+  return getBinNum(getVolumeNumber(coords));
+
+}
+
+///Get the bin number that a HyperPoint falls into
+///
+int HyperBinningFrozen::getBinNum(const HyperPoint& coords) const{
+
+  if (coords.getDimension() != _dimension) {
+    std::cerr << "HyperBinningFrozen::getBinNum - HyperPoint has the wrong dimension" << std::endl;
+    return -1;
+  }
+  return getBinNum(coords.data());
+
+}
+
+///Get the label of the bin that coords falls into. This is the same as
+///HyperHistogram::getVal(), but without the conversion from double. If
+///no labels are set, the bin number is returned instead.
+int HyperBinningFrozen::getLabel(const double* coords) const{
+
+  return getLabelOfVolume(getVolumeNumber(coords));
+
+}
+
+///Get the label of the bin that a HyperPoint falls into
+///
+int HyperBinningFrozen::getLabel(const HyperPoint& coords) const{
+
+  if (coords.getDimension() != _dimension) {
+    std::cerr << "HyperBinningFrozen::getLabel - HyperPoint has the wrong dimension" << std::endl;
+    return _outsideLabel;
+  }
+  return getLabel(coords.data());
+
+}
@@ -1,5 +1,12 @@
 #include "HyperBinningMemRes.h"
 
+///Construct an empty HyperBinningMemRes
+///
+HyperBinningMemRes::HyperBinningMemRes() :
+  _firstCuboid(1, 0),
+  _firstLink  (1, 0)
+{
+}
 
 ///Set the dimension of the HyperBinningMemRes. This can only be 
 ///called once, when it is known what dimesnion it is.
@@ -13,7 +20,58 @@ void HyperBinningMemRes::setDimension(int dim){
 
 std::vector<int> HyperBinningMemRes::getLinkedHyperVolumes( int volumeNumber ) const{
 
-  return _linkedHyperVolumes.at(volumeNumber);
+  return std::vector<int>(_linkedHyperVolumes.begin() + _firstLink.at(volumeNumber), 
+                          _linkedHyperVolumes.begin() + _firstLink.at(volumeNumber + 1));
+
+}
+
+///Get the number of HyperVolumes linked to a HyperVolume
+///
+int HyperBinningMemRes::getNumLinkedHyperVolumes( int volumeNumber ) const{
+
+  return _firstLink[volumeNumber + 1] - _firstLink[volumeNumber];
+
+}
+
+///Get the i-th HyperVolume linked to a HyperVolume
+///
+int HyperBinningMemRes::getLinkedHyperVolume( int volumeNumber, int i ) const{
+
+  return _linkedHyperVolumes[_firstLink[volumeNumber] + i];
+
+}
+
+///Check if a HyperPoint falls in one of the HyperVolumes. This reads the 
+///HyperCuboids straight from the arena, so nothing is copied.
+bool HyperBinningMemRes::inHyperVolume(int volumeNumber, const HyperPoint& coords) const{
+
+  int dim = getDimension();
+  if (coords.size() != dim) {
+    std::cerr << "HyperPoints are of different dimension i.e. not compatible!!!"; 
+    return false;
+  }
+
+  const double* x = coords.data();
+
+  //if there's more than one HyperCuboid, first check the surrounding HyperCuboid
+  if (_firstCuboid[volumeNumber + 1] - _firstCuboid[volumeNumber] > 1){
+    const double* low  = _volumeLimits.data() + 2*dim*volumeNumber;
+    const double* high = low + dim;
+    for (int d = 0; d < dim; d++){
+      if ( !(low[d] < x[d] && x[d] <= high[d]) ) return false;
+    }
+  }
+
+  for (int c = _firstCuboid[volumeNumber]; c < _firstCuboid[volumeNumber + 1]; c++){
+    const double* low  = _cuboidCorners.data() + 2*dim*c;
+    const double* high = low + dim;
+    bool inCuboid = true;
+    for (int d = 0; d < dim; d++){
+      if ( !(low[d] < x[d] && x[d] <= high[d]) ) { inCuboid = false; break; }
+    }
+    if (inCuboid) return true;
+  }
+  return false;
 
 }
 
@@ -27,12 +85,13 @@ BinningBase* HyperBinningMemRes::clone() const{
 ///
 void HyperBinningMemRes::addPrimaryVolumeNumber(int volumeNumber){
   _primaryVolumeNumbers.push_back(volumeNumber);
+  updateCash();
 }
 
 ///get the number of HyperVolumes
 ///
 int HyperBinningMemRes::getNumHyperVolumes() const{
-  return _hyperVolumes.size();
+  return _firstCuboid.size() - 1;
 }
 
 int HyperBinningMemRes::getNumPrimaryVolumes  () const{
@@ -43,18 +102,90 @@ int HyperBinningMemRes::getPrimaryVolumeNumber(int i) const{
   return _primaryVolumeNumbers.at(i);
 }
 
+///Add a HyperCuboid to the end of the arena. It becomes part of the 
+///HyperVolume that is being built, until endHyperVolume() is called. 
+///Like in HyperCuboid, if the low corner isn't lower than the high
+///corner in every dimension, both corners are set to zero.
+void HyperBinningMemRes::addHyperCuboid(const double* lowCorner, const double* highCorner){
+
+  int dim = getDimension();
+
+  bool valid = true;
+  for (int d = 0; d < dim; d++){
+    if (lowCorner[d] >= highCorner[d]) valid = false;
+  }
+
+  for (int d = 0; d < dim; d++) _cuboidCorners.push_back(valid ? lowCorner [d] : 0.0);
+  for (int d = 0; d < dim; d++) _cuboidCorners.push_back(valid ? highCorner[d] : 0.0);
+
+}
+
+///Finish the HyperVolume made up from the HyperCuboids added since the 
+///last call, and give it its linked HyperVolumes.
+void HyperBinningMemRes::endHyperVolume(const int* linkedVolumes, int nLinkedVolumes){
+
+  _firstCuboid.push_back( _cuboidCorners.size()/(2*getDimension()) );
+  _linkedHyperVolumes.insert(_linkedHyperVolumes.end(), linkedVolumes, linkedVolumes + nLinkedVolumes);
+  _firstLink.push_back( _linkedHyperVolumes.size() );
+
+  _volumeLimits.resize( 2*getDimension()*getNumHyperVolumes() );
+  updateVolumeLimits( getNumHyperVolumes() - 1 );
+
+}
+
+///Sort the HyperCuboids of a HyperVolume from largest to smallest volume,
+///and store the HyperCuboid that surrounds them in _volumeLimits (which
+///must already be big enough).
+void HyperBinningMemRes::updateVolumeLimits(int volumeNumber){
+
+  int dim = getDimension();
+  int firstCuboid = _firstCuboid[volumeNumber];
+  int nCuboids    = _firstCuboid[volumeNumber + 1] - firstCuboid;
+  double* corners = _cuboidCorners.data() + 2*dim*firstCuboid;
+  double* limits  = _volumeLimits .data() + 2*dim*volumeNumber;
+
+  if (nCuboids > 1){
+    std::vector<double> volumes(nCuboids, 1.0);
+    for (int c = 0; c < nCuboids; c++){
+      for (int d = 0; d < dim; d++) volumes[c] *= corners[2*dim*c + dim + d] - corners[2*dim*c + d];
+    }
+    std::vector<int> order(nCuboids);
+    for (int c = 0; c < nCuboids; c++) order[c] = c;
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b){ return volumes[a] > volumes[b]; });
+    std::vector<double> sorted;
+    sorted.reserve(2*dim*nCuboids);
+    for (int c : order) sorted.insert(sorted.end(), corners + 2*dim*c, corners + 2*dim*(c + 1));
+    std::copy(sorted.begin(), sorted.end(), corners);
+  }
+
+  for (int d = 0; d < dim; d++){
+    double low = nCuboids == 0 ? 0.0 : corners[d];
+    for (int c = 1; c < nCuboids; c++) low = std::min(low, corners[2*dim*c + d]);
+    limits[d] = low;
+  }
+  for (int d = 0; d < dim; d++){
+    double high = nCuboids == 0 ? 0.0 : corners[dim + d];
+    for (int c = 1; c < nCuboids; c++) high = std::max(high, corners[2*dim*c + dim + d]);
+    limits[dim + d] = high;
+  }
+
+}
+
 ///Add a HyperVolume to the HyperBinningMemRes and add a set of empty
 ///HyperVolume links.
-bool HyperBinningMemRes::addHyperVolume(const HyperVolume& hyperVolume, std::vector<int> linkedVolumes){
+bool HyperBinningMemRes::addHyperVolume(const HyperVolume& hyperVolume, const std::vector<int>& linkedVolumes){
   
   //If this is the first volume that has been added, use it to set the dimension
-  if (_hyperVolumes.size() == 0){
+  if (getNumHyperVolumes() == 0){
     setDimension( hyperVolume.getDimension() );
   }
 
   if (hyperVolume.getDimension() == getDimension()) {
-    _hyperVolumes.push_back(hyperVolume); 
-    _linkedHyperVolumes.push_back(linkedVolumes);
+    for (int i = 0; i < hyperVolume.size(); i++){
+      const HyperCuboid& cuboid = hyperVolume.at(i);
+      addHyperCuboid(cuboid.getLowCorner().data(), cuboid.getHighCorner().data());
+    }
+    endHyperVolume(linkedVolumes.data(), linkedVolumes.size());
     updateCash();
     return true;
   }
@@ -88,6 +219,65 @@ void HyperBinningMemRes::loadPrimaryVolumeNumbers(TFile* file) {
   
 }
 
+///Save the HyperBinningMemRes to a file, in the same format that load()
+///reads. Each HyperCuboid is one entry in the TTree "HyperBinning", and
+///the primary volume numbers go in the TTree "PrimaryVolumeNumbers".
+void HyperBinningMemRes::save(TString filename) const{
+
+  TFile file(filename, "RECREATE");
+
+  if (file.IsZombie()){
+    std::cerr << "Could not open TFile in HyperBinningMemRes::save(" << filename << ")";
+    return;
+  }
+
+  int dim = getDimension();
+
+  //The TTrees are owned by the file, which deletes them when it's closed
+  TTree* tree = new TTree("HyperBinning", "HyperBinning");
+
+  int binNumber = -1;
+  std::vector<double> lowCorner (dim);
+  std::vector<double> highCorner(dim);
+  std::vector<int>* linkedBins = new std::vector<int>();
+
+  tree->Branch("binNumber", &binNumber, "binNumber/I");
+  tree->Branch("linkedBins", &linkedBins);
+  for (int i = 0; i < dim; i++) {
+    TString lowCornerName  = "lowCorner_"; lowCornerName += i; 
+    TString highCornerName = "highCorner_"; highCornerName += i;
+    tree->Branch(lowCornerName , &lowCorner [i], lowCornerName  + "/D");
+    tree->Branch(highCornerName, &highCorner[i], highCornerName + "/D");
+  }
+
+  for (int v = 0; v < getNumHyperVolumes(); v++){
+    binNumber = v;
+    linkedBins->assign(_linkedHyperVolumes.begin() + _firstLink[v], _linkedHyperVolumes.begin() + _firstLink[v + 1]);
+    for (int c = _firstCuboid[v]; c < _firstCuboid[v + 1]; c++){
+      for (int d = 0; d < dim; d++){
+        lowCorner [d] = _cuboidCorners[2*dim*c + d];
+        highCorner[d] = _cuboidCorners[2*dim*c + dim + d];
+      }
+      tree->Fill();
+    }
+  }
+
+  tree->Write();
+
+  TTree* primaryTree = new TTree("PrimaryVolumeNumbers", "PrimaryVolumeNumbers");
+  int volumeNumber = -1;
+  primaryTree->Branch("volumeNumber", &volumeNumber, "volumeNumber/I");
+  for (int primaryVolumeNumber : _primaryVolumeNumbers){
+    volumeNumber = primaryVolumeNumber;
+    primaryTree->Fill();
+  }
+  primaryTree->Write();
+
+  file.Close();
+  delete linkedBins;
+
+}
+
 ///Set branch addresses for loading HyperBinningMemRes
 ///from a file.
 void HyperBinningMemRes::setBranchAddresses(TTree* tree, int* binNumber, double* lowCorner, double* highCorner, std::vector<int>** linkedBins) const{
@@ -103,8 +293,38 @@ void HyperBinningMemRes::setBranchAddresses(TTree* tree, int* binNumber, double*
 
 }
 
+///Get one of the HyperVolumes. This builds a new HyperVolume from the
+///arena, so it should be avoided when speed matters.
 HyperVolume HyperBinningMemRes::getHyperVolume(int volumeNumber) const{
-  return _hyperVolumes.at(volumeNumber);
+
+  int dim = getDimension();
+  HyperVolume hyperVolume(dim);
+
+  for (int c = _firstCuboid.at(volumeNumber); c < _firstCuboid.at(volumeNumber + 1); c++){
+    HyperCuboid cuboid(dim);
+    for (int d = 0; d < dim; d++){
+      cuboid.getLowCorner ().at(d) = _cuboidCorners[2*dim*c + d];
+      cuboid.getHighCorner().at(d) = _cuboidCorners[2*dim*c + dim + d];
+    }
+    hyperVolume.addHyperCuboid(cuboid);
+  }
+
+  return hyperVolume;
+}
+
+///Get the HyperCuboid that surrounds one of the HyperVolumes. This is
+///stored, so it doesn't need to be worked out from the HyperCuboids.
+HyperCuboid HyperBinningMemRes::getHyperVolumeLimits(int volumeNumber) const{
+
+  int dim = getDimension();
+  HyperCuboid limits(dim);
+
+  for (int d = 0; d < dim; d++){
+    limits.getLowCorner ().at(d) = _volumeLimits.at(2*dim*volumeNumber + d);
+    limits.getHighCorner().at(d) = _volumeLimits.at(2*dim*volumeNumber + dim + d);
+  }
+
+  return limits;
 }
 
 ///Load HyperBinningMemRes from a file
@@ -144,67 +364,50 @@ void HyperBinningMemRes::load(TString filename, TString option){
   setBranchAddresses(tree, &binNumber, lowCorner, highCorner, &linkedBins);
   
 
-  //Loop over the TTree and fill the HyperBinningMemRes
+  //Loop over the TTree and fill the HyperBinningMemRes. Each entry is
+  //one HyperCuboid, and consecutive entries with the same bin number
+  //make up one HyperVolume. These are written straight into the arena.
   int nEntries = tree->GetEntries();
 
+  _cuboidCorners.reserve( _cuboidCorners.size() + 2*getDimension()*nEntries );
+  _firstCuboid  .reserve( _firstCuboid  .size() + nEntries );
+  _firstLink    .reserve( _firstLink    .size() + nEntries );
+
   int currentBinNumber = -1;
-  HyperVolume* currentHyperVolume = new HyperVolume(getDimension());
   std::vector<int> currentLinkedVolumes;
 
-  //_verbose = true;
-
   for(int ent = 0; ent < nEntries; ent++){
     tree->GetEntry(ent);
     
-    //If the bin number hasn't changed, need to
-    //add HyperCube to previous HyperVolume
-    if(ent == 0 || currentBinNumber == binNumber){
-      currentBinNumber = binNumber;
-      currentLinkedVolumes = *linkedBins;
-      HyperPoint lowCornerVect (getDimension());
-      HyperPoint highCornerVect(getDimension());
-      for (int i = 0; i < getDimension(); i++){
-        lowCornerVect .at(i) = lowCorner [i];
-        highCornerVect.at(i) = highCorner[i];
-      }
-      currentHyperVolume->addHyperCuboid(lowCornerVect, highCornerVect);
+    //if the bin number has changed, need to finish 
+    //the previous HyperVolume
+    if (ent != 0 && currentBinNumber != binNumber){
+      endHyperVolume(currentLinkedVolumes.data(), currentLinkedVolumes.size());
     }
 
-    //if the bin number has changed, need to add
-    //previous HyperVolume to HyperBinningMemRes
-    //and start a new HyperVolume
-    else {
-      this->addHyperVolume(*currentHyperVolume, currentLinkedVolumes);
-      delete currentHyperVolume;
-      currentHyperVolume = new HyperVolume(getDimension());
-      currentLinkedVolumes = *linkedBins;
-      currentBinNumber = binNumber;
-      HyperPoint lowCornerVect (getDimension());
-      HyperPoint highCornerVect(getDimension());
-      for (int i = 0; i < getDimension(); i++){
-        lowCornerVect .at(i) = lowCorner [i];
-        highCornerVect.at(i) = highCorner[i];
-      }
-      currentHyperVolume->addHyperCuboid(lowCornerVect, highCornerVect);
-      
-    }
+    currentBinNumber     = binNumber;
+    currentLinkedVolumes = *linkedBins;
+    addHyperCuboid(lowCorner, highCorner);
 
-    //if it's the final iteration, need to add the final HyperVolume
-    if (ent == nEntries - 1) {
-      this->addHyperVolume(*currentHyperVolume);
-    }
   }
-  
 
-  //_verbose = false;
+  //need to finish the final HyperVolume
+  if (nEntries > 0) {
+    endHyperVolume(currentLinkedVolumes.data(), currentLinkedVolumes.size());
+  }
 
-  delete currentHyperVolume;
-  delete lowCorner;
-  delete highCorner;
+  delete[] lowCorner;
+  delete[] highCorner;
   delete linkedBins;
 
   updateCash();
 
+  //Build the cashe straight away, so that lookups in a loaded binning
+  //never write to it, and can be shared between threads
+  updateBinNumbering();
+  updateMinMax();
+  updateRootVolumeIndex();
+
   file->Close();
 
 }
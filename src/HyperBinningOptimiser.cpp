@@ -0,0 +1,335 @@
+#include "HyperBinningOptimiser.h"
+#include "HyperBinningBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+///Get the HyperVolumes that a lookup starts from: the primary volumes, or
+///every HyperVolume that isn't linked from another one if there are none
+std::vector<int> getRootVolumes(const HyperBinning& binning){
+
+  std::vector<int> roots;
+  if (binning.getNumPrimaryVolumes() > 0){
+    for (int i = 0; i < binning.getNumPrimaryVolumes(); i++) roots.push_back(binning.getPrimaryVolumeNumber(i));
+    return roots;
+  }
+  std::vector<bool> isLinked(binning.getNumHyperVolumes(), false);
+  for (int i = 0; i < binning.getNumHyperVolumes(); i++){
+    for (int j = 0; j < binning.getNumLinkedHyperVolumes(i); j++) isLinked.at(binning.getLinkedHyperVolume(i, j)) = true;
+  }
+  for (int i = 0; i < binning.getNumHyperVolumes(); i++){
+    if (isLinked[i] == false) roots.push_back(i);
+  }
+  return roots;
+
+}
+
+}
+
+///Construct the optimiser. Each new HyperVolume gets fanOut linked
+///HyperVolumes where possible. If maxDepth is positive, there are never
+///more than maxDepth links between a primary volume and a bin.
+HyperBinningOptimiser::HyperBinningOptimiser(int fanOut, int maxDepth) :
+  _fanOut  (fanOut),
+  _maxDepth(maxDepth)
+{
+  if (_fanOut < 2) {
+    std::cerr << "HyperBinningOptimiser - fan-out must be at least 2, setting to 4" << std::endl;
+    _fanOut = 4;
+  }
+  if (_maxDepth < 0) _maxDepth = 0;
+}
+
+///Split a group of bins in two, with a plane that none of the bins cross.
+///Of all such planes, the one that splits the group most evenly is used.
+///The bins below the plane stay in bins, and those above it are moved to
+///otherBins. Returns false, leaving bins as they are, if there's no plane.
+bool HyperBinningOptimiser::splitInTwo(const std::vector<double>& binLimits, int dim, std::vector<int>& bins, std::vector<int>& otherBins) const{
+
+  int nBins = bins.size();
+  auto low  = [&](int bin, int d){ return binLimits[2*dim*bin + d]; };
+  auto high = [&](int bin, int d){ return binLimits[2*dim*bin + dim + d]; };
+
+  //Sort the bins by their low edge. A plane can go in front of bin i if
+  //none of the bins before it reach past its low edge.
+
+  auto sortByLow = [&](std::vector<int>& order, int d){
+    order = bins;
+    std::sort(order.begin(), order.end(), [&](int a, int b){ return low(a, d) < low(b, d) || (low(a, d) == low(b, d) && a < b); });
+  };
+
+  int bestDim   = -1;
+  int bestIndex = -1;
+  int bestSize  = nBins;
+  std::vector<int> order;
+
+  for (int d = 0; d < dim; d++){
+    sortByLow(order, d);
+    double maxHigh = high(order[0], d);
+    for (int i = 1; i < nBins; i++){
+      if (maxHigh <= low(order[i], d) && std::max(i, nBins - i) < bestSize){
+        bestDim   = d;
+        bestIndex = i;
+        bestSize  = std::max(i, nBins - i);
+      }
+      maxHigh = std::max(maxHigh, high(order[i], d));
+    }
+  }
+
+  if (bestDim == -1) return false;
+
+  sortByLow(order, bestDim);
+  bins     .assign(order.begin(), order.begin() + bestIndex);
+  otherBins.assign(order.begin() + bestIndex, order.end());
+  return true;
+
+}
+
+///Build a new HyperVolume over a group of bins, and the HyperVolumes below
+///it, and return its node number. A single bin is returned as -(volume
+///number + 1). depthLeft is the number of links that may still be used,
+///or 0 for no limit.
+int HyperBinningOptimiser::buildNode(const std::vector<double>& binLimits, int dim, std::vector<int>& bins, int depthLeft, std::vector<Node>& nodes) const{
+
+  int nBins = bins.size();
+  if (nBins == 1) return -(bins[0] + 1);
+
+  //Raise the fan-out if the bins wouldn't fit in the depth that is left,
+  //even if every split were even
+
+  int fanOut = _fanOut;
+  if (depthLeft == 1) fanOut = nBins;
+  if (depthLeft >  1) fanOut = std::max(fanOut, (int)std::ceil(std::pow((double)nBins, 1.0/depthLeft) - 1e-9));
+
+  //Keep splitting the largest group, until there are enough groups, or
+  //none of them can be split
+
+  std::vector< std::vector<int> > groups(1, bins);
+  std::vector<bool> canSplit(1, true);
+
+  if (nBins <= fanOut) {
+    groups.clear();
+    for (int bin : bins) groups.push_back(std::vector<int>(1, bin));
+  }
+
+  while ((int)groups.size() < fanOut){
+    int largest = -1;
+    for (unsigned g = 0; g < groups.size(); g++){
+      if (canSplit[g] && groups[g].size() > 1 && (largest == -1 || groups[g].size() > groups[largest].size())) largest = g;
+    }
+    if (largest == -1) break;
+
+    std::vector<int> otherBins;
+    if (splitInTwo(binLimits, dim, groups[largest], otherBins) == false){
+      canSplit[largest] = false;
+      continue;
+    }
+    groups  .push_back(otherBins);
+    canSplit.push_back(true);
+  }
+
+  //If the bins can't be split at all, they are all linked from here
+
+  if (groups.size() == 1){
+    groups.clear();
+    for (int bin : bins) groups.push_back(std::vector<int>(1, bin));
+  }
+
+  int nodeNumber = nodes.size();
+  nodes.push_back(Node());
+
+  std::vector<double> limits(binLimits.begin() + 2*dim*bins[0], binLimits.begin() + 2*dim*(bins[0] + 1));
+  for (int bin : bins){
+    for (int d = 0; d < dim; d++){
+      limits[d]       = std::min(limits[d]      , binLimits[2*dim*bin + d]);
+      limits[dim + d] = std::max(limits[dim + d], binLimits[2*dim*bin + dim + d]);
+    }
+  }
+
+  std::vector<int> children;
+  for (std::vector<int>& group : groups){
+    children.push_back( buildNode(binLimits, dim, group, depthLeft == 0 ? 0 : depthLeft - 1, nodes) );
+  }
+
+  //Test the largest HyperVolumes first, since they are the most likely to
+  //hold the point
+
+  auto getVolume = [&](int child){
+    const double* corners = child >= 0 ? nodes[child].limits.data() : binLimits.data() + 2*dim*(-child - 1);
+    return HyperCuboid::getVolume(corners, corners + dim, dim);
+  };
+  std::stable_sort(children.begin(), children.end(), [&](int a, int b){ return getVolume(a) > getVolume(b); });
+
+  nodes[nodeNumber].limits   = limits;
+  nodes[nodeNumber].children = children;
+
+  return nodeNumber;
+
+}
+
+///Make a copy of the binning with a new bin hierarchy. The bins and their
+///numbers stay the same, and so does the bin that every point falls into.
+///The HyperVolumes of the hierarchy come first, followed by the bins.
+std::unique_ptr<const HyperBinningMemRes> HyperBinningOptimiser::optimise(const HyperBinning& binning) const{
+
+  int dim      = binning.getDimension();
+  int nVolumes = binning.getNumHyperVolumes();
+
+  if (nVolumes == 0){
+    std::cerr << "HyperBinningOptimiser::optimise - the binning is empty" << std::endl;
+    return nullptr;
+  }
+
+  //The HyperCuboid surrounding each bin, and the new volume numbers of the bins
+
+  std::vector<double> binLimits(2*dim*nVolumes, 0.0);
+  std::vector<int>    binVolumes;
+  for (int v = 0; v < nVolumes; v++){
+    if (binning.getNumLinkedHyperVolumes(v) > 0) continue;
+    HyperCuboid limits = binning.getHyperVolumeLimits(v);
+    for (int d = 0; d < dim; d++){
+      binLimits[2*dim*v + d]       = limits.getLowCorner ().at(d);
+      binLimits[2*dim*v + dim + d] = limits.getHighCorner().at(d);
+    }
+    binVolumes.push_back(v);
+  }
+
+  //Rebuild the hierarchy below each primary volume from the bins it reaches
+
+  std::vector<Node> nodes;
+  std::vector<int>  rootOfNode;
+  std::vector<int>  primaries;
+  std::vector<int>  visitedFrom(nVolumes, -1);
+
+  std::vector<int> roots = getRootVolumes(binning);
+
+  for (unsigned r = 0; r < roots.size(); r++){
+
+    if (binning.getNumLinkedHyperVolumes(roots[r]) == 0){
+      primaries.push_back(-(roots[r] + 1));
+      continue;
+    }
+
+    std::vector<int> bins;
+    std::vector<int> stack(1, roots[r]);
+    visitedFrom[roots[r]] = r;
+    while (stack.size() > 0){
+      int volumeNumber = stack.back();
+      stack.pop_back();
+      if (binning.getNumLinkedHyperVolumes(volumeNumber) == 0) bins.push_back(volumeNumber);
+      for (int i = 0; i < binning.getNumLinkedHyperVolumes(volumeNumber); i++){
+        int linked = binning.getLinkedHyperVolume(volumeNumber, i);
+        if (visitedFrom[linked] == (int)r) continue;
+        visitedFrom[linked] = r;
+        stack.push_back(linked);
+      }
+    }
+    std::sort(bins.begin(), bins.end());
+
+    //A primary volume that only leads to one bin is replaced by that bin
+    if (bins.size() == 0) continue;
+    if (bins.size() == 1) {
+      primaries.push_back(-(bins[0] + 1));
+      continue;
+    }
+
+    int nodeNumber = buildNode(binLimits, dim, bins, _maxDepth, nodes);
+    rootOfNode.resize(nodes.size(), -1);
+    rootOfNode[nodeNumber] = roots[r];
+    primaries.push_back(nodeNumber);
+
+  }
+  rootOfNode.resize(nodes.size(), -1);
+
+  //Write out the new HyperVolumes, then the bins in their old order
+
+  int nNodes = nodes.size();
+  std::vector<int> newVolumeNumber(nVolumes, -1);
+  for (unsigned i = 0; i < binVolumes.size(); i++) newVolumeNumber[binVolumes[i]] = nNodes + i;
+
+  auto getVolumeNumber = [&](int child){ return child >= 0 ? child : newVolumeNumber[-child - 1]; };
+
+  HyperBinningBuilder builder(dim);
+
+  for (int n = 0; n < nNodes; n++){
+    std::vector<int> links;
+    for (int child : nodes[n].children) links.push_back( getVolumeNumber(child) );
+
+    if (rootOfNode[n] != -1){
+      builder.addHyperVolume(binning.getHyperVolume(rootOfNode[n]), links);
+      continue;
+    }
+    HyperPoint low(dim), high(dim);
+    for (int d = 0; d < dim; d++){
+      low .at(d) = nodes[n].limits[d];
+      high.at(d) = nodes[n].limits[dim + d];
+    }
+    HyperVolume hyperVolume(dim);
+    hyperVolume.addHyperCuboid(HyperCuboid(low, high));
+    builder.addHyperVolume(hyperVolume, links);
+  }
+
+  for (int volumeNumber : binVolumes){
+    builder.addHyperVolume(binning.getHyperVolume(volumeNumber));
+  }
+
+  for (int primary : primaries){
+    builder.addPrimaryVolumeNumber( getVolumeNumber(primary) );
+  }
+
+  return builder.finalize();
+
+}
+
+///Count the HyperVolumes that are tested on the way to each bin, i.e. the
+///position of each HyperVolume on the path among the HyperVolumes linked
+///from the same HyperVolume, plus one for the primary volume. Bins that
+///can't be reached from a primary volume aren't counted.
+HyperBinningOptimiser::LookupCost HyperBinningOptimiser::getLookupCost(const HyperBinning& binning){
+
+  int nVolumes = binning.getNumHyperVolumes();
+
+  std::vector<int> tests(nVolumes, -1);
+  std::vector<int> depth(nVolumes, -1);
+  std::vector<int> stack;
+
+  for (int root : getRootVolumes(binning)){
+    if (tests[root] != -1) continue;
+    tests[root] = 1;
+    depth[root] = 0;
+    stack.push_back(root);
+    while (stack.size() > 0){
+      int volumeNumber = stack.back();
+      stack.pop_back();
+      for (int i = 0; i < binning.getNumLinkedHyperVolumes(volumeNumber); i++){
+        int linked = binning.getLinkedHyperVolume(volumeNumber, i);
+        if (tests[linked] != -1) continue;
+        tests[linked] = tests[volumeNumber] + i + 1;
+        depth[linked] = depth[volumeNumber] + 1;
+        stack.push_back(linked);
+      }
+    }
+  }
+
+  LookupCost cost = {0.0, 0, 0.0, 0, 0};
+  int nReached = 0;
+  for (int v = 0; v < nVolumes; v++){
+    if (binning.getNumLinkedHyperVolumes(v) > 0) { cost.nHierarchy++; continue; }
+    if (tests[v] == -1) continue;
+    cost.averageTests += tests[v];
+    cost.averageDepth += depth[v];
+    cost.maxTests = std::max(cost.maxTests, tests[v]);
+    cost.maxDepth = std::max(cost.maxDepth, depth[v]);
+    nReached++;
+  }
+  if (nReached > 0){
+    cost.averageTests /= nReached;
+    cost.averageDepth /= nReached;
+  }
+
+  return cost;
+
+}
@@ -91,3 +91,23 @@ bool HyperCuboid::inVolume(const HyperPoint& coords, std::vector<int> dims) cons
   return true;
 
 }
+
+///Get the volume of the HyperCuboid
+///
+double HyperCuboid::getVolume() const{
+
+  return getVolume(getLowCorner().data(), getHighCorner().data(), _dimension);
+
+}
+
+///Get the volume of the HyperCuboid from low to high, given as plain arrays
+///of dimension doubles each
+double HyperCuboid::getVolume(const double* low, const double* high, int dimension){
+
+  double volume = 1.0;
+  for (int i = 0; i < dimension; i++){
+    volume *= high[i] - low[i];
+  }
+  return volume;
+
+}
@@ -12,6 +12,16 @@ HyperHistogram::HyperHistogram(TString filename, TString option) :
 
 }
 
+/**
+Make an empty HyperHistogram with a copy of the given binning
+*/
+HyperHistogram::HyperHistogram(const BinningBase& binning) :
+  HistogramBase(binning.getNumBins()),
+  _binning(binning.clone())
+{
+
+}
+
 /**
 Get the bin content where the given HyperPoint lies
 */
@@ -22,6 +32,124 @@ double HyperHistogram::getVal(const HyperPoint& point) const{
 
 }
 
+/**
+Make a read-only copy of the binning, where each bin holds its bin content
+as an integer label. This only works if every bin content is an integer,
+which is the case for binning schemes where the content is the bin number.
+Otherwise an empty HyperBinningFrozen is returned, which can be checked
+with hasLabels(). After this the HyperHistogram is no longer needed for 
+lookups.
+*/
+HyperBinningFrozen HyperHistogram::freeze() const{
+
+  const HyperBinning* hyperBinning = dynamic_cast<const HyperBinning*>(_binning);
+
+  if (hyperBinning == 0){
+    std::cerr << "HyperHistogram::freeze - only a HyperBinning can be frozen" << std::endl;
+    return HyperBinningFrozen();
+  }
+
+  HyperBinningFrozen frozen = hyperBinning->freeze();
+  if (frozen.setLabels(_binContents) == false){
+    std::cerr << "HyperHistogram::freeze - the bin contents can't be stored as labels" << std::endl;
+    return HyperBinningFrozen();
+  }
+  return frozen;
+
+}
+
+namespace {
+
+/**
+Fill indices with the label (or bin number, if the binning has no labels)
+at the centre of each pixel of a slice through dimensions dimX and dimY,
+over the limits of the binning, and make an empty TH2D with the same 
+pixels. Returns false if the slice can't be made.
+*/
+bool rasteriseSlice(const HyperBinningFrozen& binning, const HyperPoint& point, int dimX, int dimY, int nBinsX, int nBinsY, TString name, std::vector<int>& indices, TH2D& slice){
+
+  if (point.getDimension() != binning.getDimension()){
+    std::cerr << "HyperHistogram::getSlice - HyperPoint has the wrong dimension" << std::endl;
+    return false;
+  }
+  if (dimX < 0 || dimX >= binning.getDimension() || dimY < 0 || dimY >= binning.getDimension() || dimX == dimY){
+    std::cerr << "HyperHistogram::getSlice - the slice needs two different dimensions of the binning" << std::endl;
+    return false;
+  }
+
+  HyperCuboid limits = binning.getLimits();
+  double lowX  = limits.getLowCorner ().at(dimX);
+  double highX = limits.getHighCorner().at(dimX);
+  double lowY  = limits.getLowCorner ().at(dimY);
+  double highY = limits.getHighCorner().at(dimY);
+
+  indices.resize((std::size_t)nBinsX*nBinsY);
+  if (binning.rasteriseSlice(point.data(), dimX, nBinsX, lowX, highX, dimY, nBinsY, lowY, highY, indices.data()) == false){
+    return false;
+  }
+
+  slice = TH2D(name, name, nBinsX, lowX, highX, nBinsY, lowY, highY);
+  slice.SetDirectory(0);
+  return true;
+
+}
+
+}
+
+/**
+Get a 2D slice of the HyperHistogram through dimensions dimX and dimY, at the
+point where the other dimensions are fixed. Each bin of the TH2D holds the 
+bin content at its centre, and the axes span the limits of the binning. 
+This freezes the binning (without labels) first, so for many slices of an 
+integer-valued HyperHistogram it is faster to freeze it once and use the 
+other getSlice().
+*/
+TH2D HyperHistogram::getSlice(const HyperPoint& point, int dimX, int dimY, int nBinsX, int nBinsY, TString name) const{
+
+  const HyperBinning* hyperBinning = dynamic_cast<const HyperBinning*>(_binning);
+
+  if (hyperBinning == 0){
+    std::cerr << "HyperHistogram::getSlice - only a HyperBinning can be sliced" << std::endl;
+    return TH2D();
+  }
+
+  std::vector<int> binNumbers;
+  TH2D slice;
+  if (rasteriseSlice(hyperBinning->freeze(), point, dimX, dimY, nBinsX, nBinsY, name, binNumbers, slice) == false){
+    return TH2D();
+  }
+
+  for (int j = 0; j < nBinsY; j++){
+    for (int i = 0; i < nBinsX; i++){
+      slice.SetBinContent(i + 1, j + 1, getBinContent(binNumbers[(std::size_t)j*nBinsX + i]));
+    }
+  }
+  return slice;
+
+}
+
+/**
+Get a 2D slice of a frozen binning through dimensions dimX and dimY, at the
+point where the other dimensions are fixed. Each bin of the TH2D holds the 
+label at its centre, see HyperBinningFrozen::rasteriseSlice().
+*/
+TH2D HyperHistogram::getSlice(const HyperBinningFrozen& binning, const HyperPoint& point, int dimX, int dimY, int nBinsX, int nBinsY, TString name){
+
+  std::vector<int> labels;
+  TH2D slice;
+  if (rasteriseSlice(binning, point, dimX, dimY, nBinsX, nBinsY, name, labels, slice) == false){
+    return TH2D();
+  }
+
+  for (int j = 0; j < nBinsY; j++){
+    for (int i = 0; i < nBinsX; i++){
+      slice.SetBinContent(i + 1, j + 1, labels[(std::size_t)j*nBinsX + i]);
+    }
+  }
+  return slice;
+
+}
+
 int HyperHistogram::getDimension() const{
 
   if (_binning == 0){
@@ -88,12 +216,27 @@ void HyperHistogram::load(TString filename, TString option){
 
 }
 
+/**
+Save the HyperHistogram to a TFile, so that it can be loaded again
+*/
+void HyperHistogram::save(TString filename) const{
+
+  if (_binning == 0){
+    std::cerr << "HyperHistogram::save - cannot save, binning not set." << std::endl;
+    return;
+  }
+
+  _binning->save(filename);
+  this->saveBase(filename);
+
+}
+
 /**
 Destructor
 */
 HyperHistogram::~HyperHistogram(){
 
-  if (!_binning){
+  if (_binning){
     delete _binning;
     _binning = nullptr;
   }
@@ -1,17 +1,26 @@
 #include "HyperVolume.h"
 
+#include <algorithm>
+
 ///Simple constuctor that only takes the dimensionality of 
 ///the HyperVolume.
 ///
 HyperVolume::HyperVolume(int dimension) : 
-  _dimension ( dimension )
+  _dimension ( dimension ),
+  _limits    ( HyperCuboid(dimension) )
 { 
+  _limits.updated();
 }
 
-///Check to see if a HyperPoint is within the HyperVolume
-///
+///Check to see if a HyperPoint is within the HyperVolume. If there is more
+///than one HyperCuboid, first check the HyperCuboid that surrounds them all.
 bool HyperVolume::inVolume(const HyperPoint& coords) const{
 
+  if (_hyperCuboids.size() > 1){
+    if (_limits.isUpdateNeeded() == true) updateLimits();
+    if (_limits.get().inVolume(coords) == 0) return 0;
+  }
+
   for(unsigned int i = 0; i < _hyperCuboids.size(); i++){
     if(_hyperCuboids.at(i).inVolume(coords)==1) return 1;
   }
@@ -29,21 +38,48 @@ void HyperVolume::addHyperCuboid(const HyperPoint& lowCorner,const HyperPoint& h
 ///add a HyperCuboid to the HyperVolume
 ///
 void HyperVolume::addHyperCuboid(const HyperCuboid& hyperCuboid){
-  if (hyperCuboid.getDimension() == _dimension) _hyperCuboids.push_back(hyperCuboid);
+  if (hyperCuboid.getDimension() == _dimension) {
+    _hyperCuboids.push_back(hyperCuboid);
+    if (_limits.isUpdateNeeded() == true) {
+      updateLimits();
+      return;
+    }
+    HyperCuboid& limits = _limits.get();
+    for (int i = 0; i < _dimension; i++){
+      double low  = hyperCuboid.getLowCorner ().at(i);
+      double high = hyperCuboid.getHighCorner().at(i);
+      if (_hyperCuboids.size() == 1 || limits.getLowCorner ().at(i) > low ) limits.getLowCorner ().at(i) = low;
+      if (_hyperCuboids.size() == 1 || limits.getHighCorner().at(i) < high) limits.getHighCorner().at(i) = high;
+    }
+  }
   else std::cerr << "The HyperCuboid you are adding to this HyperVolume has the wrong dimension";
 }
 
+///Update the HyperCuboid that surrounds all the HyperCuboids. This is only
+///needed if one of the HyperCuboids has been changed through at().
+void HyperVolume::updateLimits() const{
+
+  HyperCuboid limits(_dimension);
+  for (unsigned int c = 0; c < _hyperCuboids.size(); c++){
+    for (int i = 0; i < _dimension; i++){
+      double low  = _hyperCuboids.at(c).getLowCorner ().at(i);
+      double high = _hyperCuboids.at(c).getHighCorner().at(i);
+      if (c == 0 || limits.getLowCorner ().at(i) > low ) limits.getLowCorner ().at(i) = low;
+      if (c == 0 || limits.getHighCorner().at(i) < high) limits.getHighCorner().at(i) = high;
+    }
+  }
+  _limits = limits;
+  _limits.updated();
+
+}
+
 ///Find the Minimum value in a given dimension.
 ///
 double HyperVolume::getMin(int dimension) const{
 
   if (dimension < _dimension) {
-    double min = _hyperCuboids.at(0).getLowCorner().at(dimension);
-    for(unsigned int i = 1; i < _hyperCuboids.size(); i++){
-      double temp = _hyperCuboids.at(i).getLowCorner().at(dimension);
-      if (min > temp) min = temp;
-    }
-    return min;
+    if (_limits.isUpdateNeeded() == true) updateLimits();
+    return _limits.get().getLowCorner().at(dimension);
   }
 
   std::cerr << "You are requesting a dimensionality that does not exist in this HyperVolume";
@@ -56,12 +92,8 @@ double HyperVolume::getMin(int dimension) const{
 double HyperVolume::getMax(int dimension) const{
 
   if (dimension < _dimension) {
-    double max = _hyperCuboids.at(0).getHighCorner().at(dimension);
-    for(unsigned int i = 1; i < _hyperCuboids.size(); i++){
-      double temp = _hyperCuboids.at(i).getHighCorner().at(dimension);
-      if (max < temp) max = temp;
-    }
-    return max;
+    if (_limits.isUpdateNeeded() == true) updateLimits();
+    return _limits.get().getHighCorner().at(dimension);
   }
 
   std::cerr << "You are requesting a dimensionality that does not exist in this HyperVolume";
@@ -72,10 +104,16 @@ double HyperVolume::getMax(int dimension) const{
 ///get the limits of the HyperVolume
 ///
 HyperCuboid HyperVolume::getLimits() const{
-  HyperCuboid limits(getDimension());
-  for (int i = 0; i < getDimension(); i++){
-    limits.getLowCorner ().at(i) = getMin(i);
-    limits.getHighCorner().at(i) = getMax(i);
-  }
-  return limits;
+  if (_limits.isUpdateNeeded() == true) updateLimits();
+  return _limits.get();
+}
+
+///Sort the HyperCuboids from largest to smallest volume, so that inVolume()
+///tests the HyperCuboids most likely to contain a HyperPoint first. This
+///doesn't change which HyperPoints are in the HyperVolume.
+void HyperVolume::sortHyperCuboids(){
+
+  std::stable_sort(_hyperCuboids.begin(), _hyperCuboids.end(), 
+    [](const HyperCuboid& a, const HyperCuboid& b){ return a.getVolume() > b.getVolume(); });
+
 }
@@ -0,0 +1,102 @@
+#include "MigrationMatrix.h"
+
+#include "Threads.h"
+
+#include <algorithm>
+
+///Construct an empty MigrationMatrix
+///
+MigrationMatrix::MigrationMatrix(const ParallelBinner& binner, Index index) :
+  _binner(binner),
+  _index (index)
+{
+
+}
+
+///Get the bin number or label of a HyperVolume, or of the outside
+///of the binning if volumeNumber is -1
+int MigrationMatrix::getIndex(const HyperBinningFrozen& binning, int volumeNumber) const{
+  return _index == Labels ? binning.getLabelOfVolume(volumeNumber) : binning.getBinNum(volumeNumber);
+}
+
+///Pack a (true, reconstructed) pair into a single key
+///
+std::uint64_t MigrationMatrix::getKey(int trueIndex, int recoIndex){
+  return ((std::uint64_t)(std::uint32_t)trueIndex << 32) | (std::uint32_t)recoIndex;
+}
+
+///Add nPoints events to the matrix. The true and reconstructed coordinates
+///of event i are stored in trueCoords and recoCoords, with the dimension of
+///the binning doubles each, back to back. weights can be zero, in which
+///case every event has a weight of one. If trueDistances or recoDistances
+///are given, they are filled with the distance of each point to the
+///nearest boundary of its bin (or -1 if it is outside the binning).
+void MigrationMatrix::fill(const double* trueCoords, const double* recoCoords, int nPoints, const double* weights,
+                           double* trueDistances, double* recoDistances){
+
+  if (nPoints <= 0) return;
+
+  std::vector<int> trueVolumes(nPoints);
+  std::vector<int> recoVolumes(nPoints);
+  _binner.getVolumeNumbers(trueCoords, nPoints, trueVolumes.data());
+  _binner.getVolumeNumbers(recoCoords, nPoints, recoVolumes.data());
+
+  //Each thread adds a contiguous range of the events to its own cells,
+  //which are then merged into the matrix
+
+  const int nThreads = std::max(1, std::min(_binner.getNumThreads(), nPoints/_binner.getChunkSize()));
+  std::vector<Cells> threadCells(nThreads);
+
+  Threads::runThreads(nThreads, [&](int thread) {
+    const HyperBinningFrozen& binning = _binner.getLocalBinning();
+    const int dim   = binning.getDimension();
+    const int first = (long long)nPoints*thread/nThreads;
+    const int last  = (long long)nPoints*(thread + 1)/nThreads;
+    Cells& cells = threadCells[thread];
+    for (int i = first; i < last; i++){
+      const double weight = weights == 0 ? 1.0 : weights[i];
+      const int trueIndex = getIndex(binning, trueVolumes[i]);
+      const int recoIndex = getIndex(binning, recoVolumes[i]);
+      Entry& entry = cells.emplace(getKey(trueIndex, recoIndex), Entry{trueIndex, recoIndex, 0, 0.0, 0.0}).first->second;
+      entry.nEvents++;
+      entry.sumW  += weight;
+      entry.sumW2 += weight*weight;
+      if (trueDistances != 0) trueDistances[i] = binning.getDistanceToBoundary(trueVolumes[i], trueCoords + (std::size_t)i*dim);
+      if (recoDistances != 0) recoDistances[i] = binning.getDistanceToBoundary(recoVolumes[i], recoCoords + (std::size_t)i*dim);
+    }
+  });
+
+  for (const Cells& cells : threadCells){
+    for (const auto& cell : cells){
+      Entry& entry = _cells.emplace(cell.first, Entry{cell.second.trueIndex, cell.second.recoIndex, 0, 0.0, 0.0}).first->second;
+      entry.nEvents += cell.second.nEvents;
+      entry.sumW    += cell.second.sumW;
+      entry.sumW2   += cell.second.sumW2;
+    }
+  }
+
+}
+
+///Get the entry of a (true, reconstructed) pair, which is empty if
+///the pair has never been filled
+MigrationMatrix::Entry MigrationMatrix::getEntry(int trueIndex, int recoIndex) const{
+
+  Cells::const_iterator cell = _cells.find(getKey(trueIndex, recoIndex));
+  if (cell == _cells.end()) return Entry{trueIndex, recoIndex, 0, 0.0, 0.0};
+  return cell->second;
+
+}
+
+///Get all the pairs that have been filled, sorted by true index and
+///then by reconstructed index
+std::vector<MigrationMatrix::Entry> MigrationMatrix::getEntries() const{
+
+  std::vector<Entry> entries;
+  entries.reserve(_cells.size());
+  for (const auto& cell : _cells) entries.push_back(cell.second);
+  std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b){
+    return a.trueIndex < b.trueIndex || (a.trueIndex == b.trueIndex && a.recoIndex < b.recoIndex);
+  });
+  return entries;
+
+}
@@ -0,0 +1,237 @@
+#include "ParallelBinner.h"
+
+#include "Threads.h"
+
+#include <algorithm>
+#include <iostream>
+#include <queue>
+#include <utility>
+
+///Construct the ParallelBinner. If nThreads is zero, the number of hardware
+///threads is used. In the Chunked schedule, the chunk size sets the 
+///granularity of the work split between threads. In the SubtreeAffinity
+///schedule it is the granularity of the routing pass.
+ParallelBinner::ParallelBinner(const HyperBinningFrozen& binning, int nThreads, Schedule schedule, int chunkSize) :
+  _binning  (binning),
+  _replicas (0),
+  _nThreads (nThreads),
+  _schedule (schedule),
+  _chunkSize(chunkSize),
+  _groupSize(HyperBinningFrozen::DefaultGroupSize)
+{
+  _nThreads = Threads::getNumThreads(_nThreads);
+  if (_chunkSize <= 0) {
+    std::cerr << "ParallelBinner - chunk size must be positive, setting to 10000" << std::endl;
+    _chunkSize = 10000;
+  }
+  if (_schedule == SubtreeAffinity) makeSubtrees();
+}
+
+///Construct the ParallelBinner from copies of a binning on each NUMA node.
+///Every thread then looks up its points in the copy on its own node.
+ParallelBinner::ParallelBinner(const ReplicatedBinning& binning, int nThreads, Schedule schedule, int chunkSize) :
+  ParallelBinner(binning.getBinning(0), nThreads, schedule, chunkSize)
+{
+  _replicas = &binning;
+}
+
+///Cut the bin hierarchy into subtrees. Starting from the primary volumes,
+///the subtree with the most HyperVolumes is replaced by the subtrees of 
+///its linked HyperVolumes, until there are at least eight subtrees per 
+///thread, or only true bins are left to split. The subtrees are numbered
+///in order of their root HyperVolume, so neighbouring subtrees usually 
+///share a mother.
+void ParallelBinner::makeSubtrees(){
+
+  const int nVolumes = _binning.getNumHyperVolumes();
+  if (_binning.getNumPrimaryVolumes() == 0 || nVolumes == 0) return;
+
+  //Count the HyperVolumes below each HyperVolume, visiting the linked
+  //HyperVolumes before their mother
+  std::vector<long long> size(nVolumes, 0);
+  std::vector<std::pair<int, bool> > stack;
+  for (int i = 0; i < _binning.getNumPrimaryVolumes(); i++) stack.emplace_back(_binning.getPrimaryVolumeNumber(i), false);
+  while (stack.size() > 0){
+    std::pair<int, bool> entry = stack.back();
+    stack.pop_back();
+    int volumeNumber = entry.first;
+    if (entry.second){
+      size[volumeNumber] = 1;
+      for (int i = 0; i < _binning.getNumLinkedHyperVolumes(volumeNumber); i++) size[volumeNumber] += size[_binning.getLinkedHyperVolume(volumeNumber, i)];
+      continue;
+    }
+    if (size[volumeNumber] != 0) continue;
+    size[volumeNumber] = -1;
+    stack.emplace_back(volumeNumber, true);
+    for (int i = 0; i < _binning.getNumLinkedHyperVolumes(volumeNumber); i++){
+      int daughter = _binning.getLinkedHyperVolume(volumeNumber, i);
+      if (size[daughter] == 0) stack.emplace_back(daughter, false);
+    }
+  }
+
+  //Split the largest subtree until there are enough of them
+  const int nWanted = 8*_nThreads;
+  std::priority_queue<std::pair<long long, int> > largest;
+  std::vector<int> roots;
+  std::vector<bool> isRoot(nVolumes, false);
+  for (int i = 0; i < _binning.getNumPrimaryVolumes(); i++){
+    int volumeNumber = _binning.getPrimaryVolumeNumber(i);
+    if (isRoot[volumeNumber]) continue;
+    isRoot[volumeNumber] = true;
+    largest.emplace(size[volumeNumber], volumeNumber);
+  }
+  int nRoots = largest.size();
+  while (nRoots < nWanted && largest.size() > 0 && largest.top().first > 1){
+    int volumeNumber = largest.top().second;
+    largest.pop();
+    isRoot[volumeNumber] = false;
+    nRoots--;
+    for (int i = 0; i < _binning.getNumLinkedHyperVolumes(volumeNumber); i++){
+      int daughter = _binning.getLinkedHyperVolume(volumeNumber, i);
+      if (isRoot[daughter]) continue;
+      isRoot[daughter] = true;
+      largest.emplace(size[daughter], daughter);
+      nRoots++;
+    }
+  }
+
+  _subtreeNumber.assign(nVolumes, -1);
+  for (int volumeNumber = 0; volumeNumber < nVolumes; volumeNumber++){
+    if (isRoot[volumeNumber] == false) continue;
+    _subtreeNumber[volumeNumber] = _subtreeRoots.size();
+    _subtreeRoots.push_back(volumeNumber);
+  }
+
+}
+
+///Walk a point down the top of the bin hierarchy, until it reaches the 
+///root of a subtree. Returns the number of the subtree, or -1 if the point 
+///is finished before it gets there, in which case volumeNumber is set to 
+///its volume number.
+int ParallelBinner::routePoint(const HyperBinningFrozen& binning, const double* coords, int& volumeNumber) const{
+
+  volumeNumber = binning.findPrimaryVolume(coords);
+  while (volumeNumber != -1 && _subtreeNumber[volumeNumber] == -1 && binning.getNumLinkedHyperVolumes(volumeNumber) > 0){
+    int mother = volumeNumber;
+    volumeNumber = -1;
+    for (int i = 0; i < binning.getNumLinkedHyperVolumes(mother); i++){
+      int daughter = binning.getLinkedHyperVolume(mother, i);
+      if (binning.inHyperVolume(daughter, coords)) { volumeNumber = daughter; break; }
+    }
+  }
+  return volumeNumber == -1 ? -1 : _subtreeNumber[volumeNumber];
+
+}
+
+///Look up the points in chunks, which the threads take in turn
+///
+void ParallelBinner::getVolumeNumbersChunked(const double* coords, int nPoints, int* volumeNumbers) const{
+
+  const int dim     = _binning.getDimension();
+  const int nChunks = (nPoints + _chunkSize - 1)/_chunkSize;
+
+  Threads::runThreads(std::min(_nThreads, nChunks), nChunks, [&](int, int chunk) {
+    const HyperBinningFrozen& binning = getLocalBinning();
+    int first = chunk*_chunkSize;
+    int size  = std::min(_chunkSize, nPoints - first);
+    binning.getVolumeNumbers(coords + (std::size_t)first*dim, size, volumeNumbers + first, _groupSize);
+  });
+
+}
+
+///Look up the points by subtree. This takes three passes: route the points
+///to their subtrees and count them, sort the points by subtree, and 
+///finish the lookups with each thread working on its own range of subtrees.
+///The first two passes are split into chunks in the same way as the 
+///Chunked schedule.
+void ParallelBinner::getVolumeNumbersSubtree(const double* coords, int nPoints, int* volumeNumbers) const{
+
+  const int dim       = _binning.getDimension();
+  const int nSubtrees = _subtreeRoots.size();
+  const int nChunks   = (nPoints + _chunkSize - 1)/_chunkSize;
+  const int nThreads  = std::min(_nThreads, nChunks);
+
+  //Route the points, counting how many in each chunk go to each subtree
+  std::vector<int> subtree(nPoints);
+  std::vector<int> offset((std::size_t)nChunks*nSubtrees, 0);
+  Threads::runThreads(nThreads, nChunks, [&](int, int chunk) {
+    const HyperBinningFrozen& binning = getLocalBinning();
+    int* count = offset.data() + (std::size_t)chunk*nSubtrees;
+    for (int i = chunk*_chunkSize; i < std::min(nPoints, (chunk + 1)*_chunkSize); i++){
+      subtree[i] = routePoint(binning, coords + (std::size_t)i*dim, volumeNumbers[i]);
+      if (subtree[i] != -1) count[subtree[i]]++;
+    }
+  });
+
+  //Turn the counts into the position of the first point of each chunk and
+  //subtree in the sorted order, which is by subtree, then by input order
+  std::vector<int> firstOfSubtree(nSubtrees + 1, 0);
+  int nRouted = 0;
+  for (int s = 0; s < nSubtrees; s++){
+    firstOfSubtree[s] = nRouted;
+    for (int chunk = 0; chunk < nChunks; chunk++){
+      int& count = offset[(std::size_t)chunk*nSubtrees + s];
+      int n = count;
+      count = nRouted;
+      nRouted += n;
+    }
+  }
+  firstOfSubtree[nSubtrees] = nRouted;
+
+  std::vector<int> sorted(nRouted);
+  Threads::runThreads(nThreads, nChunks, [&](int, int chunk) {
+    int* position = offset.data() + (std::size_t)chunk*nSubtrees;
+    for (int i = chunk*_chunkSize; i < std::min(nPoints, (chunk + 1)*_chunkSize); i++){
+      if (subtree[i] != -1) sorted[position[subtree[i]]++] = i;
+    }
+  });
+
+  //Give each thread a contiguous range of subtrees, with about the same 
+  //number of points, and finish the lookups
+  std::vector<int> firstOfThread(nThreads + 1, nRouted);
+  firstOfThread[0] = 0;
+  for (int t = 1, s = 0; t < nThreads; t++){
+    const long long target = (long long)nRouted*t/nThreads;
+    while (s < nSubtrees && firstOfSubtree[s + 1] <= target) s++;
+    firstOfThread[t] = std::max(firstOfThread[t - 1], firstOfSubtree[s]);
+  }
+
+  Threads::runThreads(nThreads, [&](int thread) {
+    const HyperBinningFrozen& binning = getLocalBinning();
+    for (int j = firstOfThread[thread]; j < firstOfThread[thread + 1]; j++){
+      const int i = sorted[j];
+      volumeNumbers[i] = binning.followLinks(_subtreeRoots[subtree[i]], coords + (std::size_t)i*dim);
+    }
+  });
+
+}
+
+///Get the volume numbers of nPoints points, stored back to back in coords.
+///The result is the same as HyperBinningFrozen::getVolumeNumbers().
+void ParallelBinner::getVolumeNumbers(const double* coords, int nPoints, int* volumeNumbers) const{
+
+  if (nPoints <= 0) return;
+  if (getSchedule() == SubtreeAffinity) getVolumeNumbersSubtree(coords, nPoints, volumeNumbers);
+  else                                  getVolumeNumbersChunked(coords, nPoints, volumeNumbers);
+
+}
+
+///Get the bin numbers of nPoints points, stored back to back in coords.
+///
+void ParallelBinner::getBinNums(const double* coords, int nPoints, int* binNumbers) const{
+
+  getVolumeNumbers(coords, nPoints, binNumbers);
+  const HyperBinningFrozen& binning = getLocalBinning();
+  for (int i = 0; i < nPoints; i++) binNumbers[i] = binning.getBinNum(binNumbers[i]);
+
+}
+
+///Get the labels of nPoints points, stored back to back in coords.
+///
+void ParallelBinner::getLabels(const double* coords, int nPoints, int* labels) const{
+
+  getVolumeNumbers(coords, nPoints, labels);
+  const HyperBinningFrozen& binning = getLocalBinning();
+  for (int i = 0; i < nPoints; i++) labels[i] = binning.getLabelOfVolume(labels[i]);
+
+}
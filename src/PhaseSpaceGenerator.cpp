@@ -0,0 +1,104 @@
+#include "PhaseSpaceGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+
+///Set up the decay of a parent with four-momentum parent into daughters
+///with the given masses. The decay must be kinematically allowed.
+PhaseSpaceGenerator::PhaseSpaceGenerator(const TLorentzVector& parent, const std::vector<double>& masses) :
+  _parent   (parent),
+  _masses   (masses),
+  _kineticEnergy( parent.M() - std::accumulate(masses.begin(), masses.end(), 0.0) ),
+  _maxWeight(1.0),
+  _daughters(masses.size()),
+  _random   (masses.size()),
+  _invMass  (masses.size()),
+  _momentum (masses.size())
+{
+
+  if (_masses.size() < 2 || _kineticEnergy <= 0.0){
+    std::cerr << "PhaseSpaceGenerator - this decay is not kinematically allowed" << std::endl;
+    return;
+  }
+
+  //The maximum weight is reached when each intermediate state has the maximum
+  //available energy
+  double emmax = _kineticEnergy + _masses[0];
+  double emmin = 0.0;
+  double wtmax = 1.0;
+  for (unsigned n = 1; n < _masses.size(); n++){
+    emmin += _masses[n - 1];
+    emmax += _masses[n];
+    wtmax *= twoBodyMomentum(emmax, emmin, _masses[n]);
+  }
+  _maxWeight = 1.0/wtmax;
+
+}
+
+///Momentum of the daughters in the two-body decay a -> b c
+///
+double PhaseSpaceGenerator::twoBodyMomentum(double a, double b, double c){
+  double x = (a - b - c)*(a + b + c)*(a - b + c)*(a + b - c);
+  return x > 0.0 ? std::sqrt(x)/(2.0*a) : 0.0;
+}
+
+///Generate a phase space event using the random number generator random.
+///The four-momenta are available from getDecay() until the next call.
+double PhaseSpaceGenerator::generate(TRandom& random){
+
+  int nDaughters = getNumDaughters();
+
+  //Generate the intermediate invariant masses
+  _random[0] = 0.0;
+  for (int n = 1; n < nDaughters - 1; n++) _random[n] = random.Rndm();
+  std::sort(_random.begin() + 1, _random.begin() + nDaughters - 1);
+  _random[nDaughters - 1] = 1.0;
+
+  double sum = 0.0;
+  for (int n = 0; n < nDaughters; n++){
+    sum        += _masses[n];
+    _invMass[n] = _random[n]*_kineticEnergy + sum;
+  }
+
+  double weight = _maxWeight;
+  for (int n = 0; n < nDaughters - 1; n++){
+    _momentum[n] = twoBodyMomentum(_invMass[n + 1], _invMass[n], _masses[n + 1]);
+    weight *= _momentum[n];
+  }
+
+  //Build up the decay chain one two-body decay at a time, with each
+  //step randomly rotated and then boosted into the next rest frame
+  _daughters[0].SetPxPyPzE(0.0, _momentum[0], 0.0, std::sqrt(_momentum[0]*_momentum[0] + _masses[0]*_masses[0]));
+
+  for (int i = 1; ; i++){
+    _daughters[i].SetPxPyPzE(0.0, -_momentum[i - 1], 0.0, std::sqrt(_momentum[i - 1]*_momentum[i - 1] + _masses[i]*_masses[i]));
+
+    double cZ   = 2.0*random.Rndm() - 1.0;
+    double sZ   = std::sqrt(1.0 - cZ*cZ);
+    double angY = 2.0*M_PI*random.Rndm();
+    double cY   = std::cos(angY);
+    double sY   = std::sin(angY);
+    for (int j = 0; j <= i; j++){
+      double x = _daughters[j].Px();
+      double y = _daughters[j].Py();
+      double z = _daughters[j].Pz();
+      double xRotZ = cZ*x - sZ*y;
+      double yRotZ = sZ*x + cZ*y;
+      _daughters[j].SetPxPyPzE(cY*xRotZ - sY*z, yRotZ, sY*xRotZ + cY*z, _daughters[j].E());
+    }
+
+    if (i == nDaughters - 1) break;
+
+    double beta = _momentum[i]/std::sqrt(_momentum[i]*_momentum[i] + _invMass[i]*_invMass[i]);
+    for (int j = 0; j <= i; j++) _daughters[j].Boost(TVector3(0.0, beta, 0.0));
+  }
+
+  //Final boost into the frame of the parent
+  TVector3 boost = _parent.BoostVector();
+  for (int n = 0; n < nDaughters; n++) _daughters[n].Boost(boost);
+
+  return weight;
+
+}
@@ -0,0 +1,189 @@
+#include "PhaseSpaceIntegrator.h"
+#include "PhaseSpaceGenerator.h"
+#include "Utilities.h"
+
+#include "TRandom3.h"
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+///Add the sums from another bin
+///
+PhaseSpaceBinSum& PhaseSpaceBinSum::operator+=(const PhaseSpaceBinSum& other){
+  sumW    += other.sumW;
+  sumW2   += other.sumW2;
+  nEvents += other.nEvents;
+  return *this;
+}
+
+///Construct an empty integral
+///
+PhaseSpaceIntegral::PhaseSpaceIntegral() :
+  _nGenerated(0)
+{
+}
+
+///Add the sums from some events that fall in binNumber
+///
+void PhaseSpaceIntegral::add(int binNumber, const PhaseSpaceBinSum& binSum){
+  _binSums[binNumber] += binSum;
+  _total              += binSum;
+}
+
+///Increase the number of generated events. This includes events
+///that fall outside the binning, so it is kept separate from add()
+void PhaseSpaceIntegral::addGenerated(long long nGenerated){
+  _nGenerated += nGenerated;
+}
+
+///Get all bin numbers that have at least one event, in ascending order
+///
+std::vector<int> PhaseSpaceIntegral::getBinNumbers() const{
+  std::vector<int> binNumbers;
+  binNumbers.reserve(_binSums.size());
+  for (const auto& binSum : _binSums) binNumbers.push_back(binSum.first);
+  return binNumbers;
+}
+
+///Get the sums for a bin. Bins with no events return zero sums.
+///
+const PhaseSpaceBinSum& PhaseSpaceIntegral::getBinSum(int binNumber) const{
+  static const PhaseSpaceBinSum empty;
+  auto binSum = _binSums.find(binNumber);
+  if (binSum == _binSums.end()) return empty;
+  return binSum->second;
+}
+
+///Get the Monte Carlo estimate of the phase space integral over a bin,
+///normalised such that the integral over the full phase space is the
+///average event weight.
+double PhaseSpaceIntegral::getIntegral(int binNumber) const{
+  if (_nGenerated == 0) return 0.0;
+  return getBinSum(binNumber).sumW/_nGenerated;
+}
+
+///Get the statistical uncertainty on getIntegral()
+///
+double PhaseSpaceIntegral::getIntegralError(int binNumber) const{
+  if (_nGenerated < 2) return 0.0;
+  double mean   = getIntegral(binNumber);
+  double meanW2 = getBinSum(binNumber).sumW2/_nGenerated;
+  double var    = (meanW2 - mean*mean)/(_nGenerated - 1);
+  return var > 0.0 ? std::sqrt(var) : 0.0;
+}
+
+///Get the fraction of the binned phase space that falls in a bin
+///
+double PhaseSpaceIntegral::getFraction(int binNumber) const{
+  if (_total.sumW == 0.0) return 0.0;
+  return getBinSum(binNumber).sumW/_total.sumW;
+}
+
+///Get the statistical uncertainty on getFraction(), taking into account
+///that the numerator and denominator are correlated
+double PhaseSpaceIntegral::getFractionError(int binNumber) const{
+  if (_total.sumW == 0.0) return 0.0;
+  const PhaseSpaceBinSum& binSum = getBinSum(binNumber);
+  double f   = binSum.sumW/_total.sumW;
+  double var = (binSum.sumW2*(1.0 - 2.0*f) + f*f*_total.sumW2)/(_total.sumW*_total.sumW);
+  return var > 0.0 ? std::sqrt(var) : 0.0;
+}
+
+///Construct the integrator. If nThreads is zero, the number of hardware
+///threads is used. The chunk size sets the granularity of the work
+///split between threads, and together with the seed it fixes the result.
+PhaseSpaceIntegrator::PhaseSpaceIntegrator(const HyperHistogram& hyperHistogram, int nThreads, int chunkSize) :
+  _hyperHistogram(hyperHistogram),
+  _nThreads      (nThreads),
+  _chunkSize     (chunkSize)
+{
+  if (_nThreads <= 0) _nThreads = std::max(1u, std::thread::hardware_concurrency());
+  if (_chunkSize <= 0) {
+    std::cerr << "PhaseSpaceIntegrator - chunk size must be positive, setting to 100000" << std::endl;
+    _chunkSize = 100000;
+  }
+}
+
+///Get the seed of the random number stream used for one chunk. This is
+///a SplitMix64 hash of the global seed and chunk index, so the streams of
+///neighbouring chunks are uncorrelated.
+unsigned int PhaseSpaceIntegrator::getChunkSeed(unsigned int seed, long long chunk){
+  unsigned long long z = ((unsigned long long)seed << 32) + (unsigned long long)chunk + 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z =  z ^ (z >> 31);
+  unsigned int chunkSeed = (unsigned int)(z >> 32);
+  //TRandom3 interprets a seed of zero as "seed from the clock"
+  return chunkSeed == 0 ? 1 : chunkSeed;
+}
+
+///Generate and bin nEvents with one random number stream
+///
+PhaseSpaceIntegral PhaseSpaceIntegrator::integrateChunk(long long nEvents, unsigned int seed) const{
+
+  const double PionMass = 0.13957039;
+  const TLorentzVector P_D(0.0, 0.0, 0.0, 1.86483);
+
+  TRandom3 random(seed);
+  PhaseSpaceGenerator phaseSpace(P_D, std::vector<double>(4, PionMass));
+
+  std::array<TLorentzVector, 4> daughters;
+  HyperPoint hyperPoint(5);
+
+  //Sum in a map first, so the total is only updated once per bin
+  std::map<int, PhaseSpaceBinSum> binSums;
+
+  for (long long n = 0; n < nEvents; n++){
+    double weight = phaseSpace.generate(random);
+    for (int i = 0; i < 4; i++) daughters[i] = phaseSpace.getDecay(i);
+
+    bool flip = Utilities::getBinningCoordinates(daughters, P_D, hyperPoint);
+    int binNumber = (int)std::lround(_hyperHistogram.getVal(hyperPoint))*(flip ? -1 : 1);
+
+    PhaseSpaceBinSum& binSum = binSums[binNumber];
+    binSum.sumW  += weight;
+    binSum.sumW2 += weight*weight;
+    binSum.nEvents++;
+  }
+
+  PhaseSpaceIntegral integral;
+  integral.addGenerated(nEvents);
+  for (const auto& binSum : binSums) integral.add(binSum.first, binSum.second);
+  return integral;
+
+}
+
+///Generate nEvents phase space events and integrate over each bin. The
+///result only depends on nEvents, the seed, and the chunk size.
+PhaseSpaceIntegral PhaseSpaceIntegrator::integrate(long long nEvents, unsigned int seed) const{
+
+  long long nChunks = (nEvents + _chunkSize - 1)/_chunkSize;
+
+  std::vector<PhaseSpaceIntegral> chunks(nChunks);
+  std::atomic<long long> nextChunk(0);
+
+  auto worker = [&]() {
+    for (long long chunk = nextChunk++; chunk < nChunks; chunk = nextChunk++){
+      long long nChunkEvents = std::min<long long>(_chunkSize, nEvents - chunk*_chunkSize);
+      chunks[chunk] = integrateChunk(nChunkEvents, getChunkSeed(seed, chunk));
+    }
+  };
+
+  int nThreads = (int)std::min<long long>(_nThreads, std::max(nChunks, 1LL));
+  std::vector<std::thread> threads;
+  for (int i = 1; i < nThreads; i++) threads.emplace_back(worker);
+  worker();
+  for (auto& thread : threads) thread.join();
+
+  //Sum the chunks in order, so the floating point sums don't depend on
+  //which thread finished first
+  PhaseSpaceIntegral integral;
+  for (const auto& chunk : chunks){
+    integral.addGenerated(chunk.getNumGenerated());
+    for (int binNumber : chunk.getBinNumbers()) integral.add(binNumber, chunk.getBinSum(binNumber));
+  }
+  return integral;
+
+}
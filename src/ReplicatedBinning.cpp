@@ -0,0 +1,200 @@
+#include "ReplicatedBinning.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+  //From linux/mempolicy.h, which isn't always installed
+  const int MpolPreferred = 1;
+
+}
+
+///Make the copies of a binning. With replicate, there is one copy on each
+///NUMA node, otherwise there is a single one, which isn't bound to any
+///node. With hugePages, the copies are advised to use transparent huge
+///pages, and otherwise advised not to, so that they stay on small pages
+///even if the kernel uses huge pages wherever it can. The binning isn't
+///needed afterwards.
+ReplicatedBinning::ReplicatedBinning(const HyperBinningFrozen& binning, bool replicate, bool hugePages)
+{
+
+  std::vector<int> nodes = getNumaNodes();
+  if (replicate == false || nodes.size() <= 1) nodes.assign(1, nodes.size() == 1 ? nodes[0] : 0);
+  const bool bind = nodes.size() > 1;
+
+  _replicas.reserve(nodes.size());
+  for (int node : nodes){
+    if (makeReplica(binning, node, bind, hugePages) == false) break;
+  }
+
+  //If a copy couldn't be made, fall back to a single copy
+  if (_replicas.size() != nodes.size()){
+    std::cerr << "ReplicatedBinning - could only make " << _replicas.size() << " of " << nodes.size() << " copies" << std::endl;
+    if (_replicas.size() == 0 && makeReplica(binning, 0, false, hugePages) == false){
+      std::cerr << "ReplicatedBinning - could not make any copies, using a plain copy of the binning" << std::endl;
+      _replicas.push_back(Replica{0, 0, 0, false, binning});
+    }
+  }
+
+  for (unsigned i = 0; i < _replicas.size(); i++){
+    int node = _replicas[i].node;
+    if (node >= (int)_replicaOfNode.size()) _replicaOfNode.resize(node + 1, -1);
+    _replicaOfNode[node] = i;
+  }
+
+}
+
+///Release the copies
+///
+ReplicatedBinning::~ReplicatedBinning(){
+
+  for (Replica& replica : _replicas){
+    replica.binning = HyperBinningFrozen();
+    if (replica.memory != 0) munmap(replica.memory, replica.size);
+  }
+
+}
+
+///Write a copy of the binning into memory placed on a NUMA node. The
+///memory is bound and advised before it is first written, since that is
+///when the pages are allocated.
+bool ReplicatedBinning::makeReplica(const HyperBinningFrozen& binning, int node, bool bind, bool hugePages){
+
+  ImageWriter counter;
+  binning.writeImage(counter);
+  const std::size_t size = (counter.getSize() + _hugePageSize - 1)/_hugePageSize*_hugePageSize;
+
+  //Map one huge page more than needed, and cut it down to an aligned range
+
+  char* mapping = static_cast<char*>( mmap(0, size + _hugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) );
+  if (mapping == MAP_FAILED) return false;
+
+  char* memory = mapping + (_hugePageSize - (std::uintptr_t)mapping % _hugePageSize) % _hugePageSize;
+  if (memory > mapping) munmap(mapping, memory - mapping);
+  if (mapping + size + _hugePageSize > memory + size) munmap(memory + size, mapping + size + _hugePageSize - (memory + size));
+
+#ifdef MADV_HUGEPAGE
+  if (hugePages) madvise(memory, size, MADV_HUGEPAGE);
+#endif
+#ifdef MADV_NOHUGEPAGE
+  if (hugePages == false) madvise(memory, size, MADV_NOHUGEPAGE);
+#endif
+
+  bool isBound = false;
+#ifdef SYS_mbind
+  if (bind){
+    std::vector<unsigned long> nodeMask(node/(8*sizeof(unsigned long)) + 1, 0);
+    nodeMask[node/(8*sizeof(unsigned long))] = 1ul << (node % (8*sizeof(unsigned long)));
+    isBound = syscall(SYS_mbind, memory, size, MpolPreferred, nodeMask.data(), 8*sizeof(unsigned long)*nodeMask.size() + 1, 0) == 0;
+  }
+#endif
+
+  ImageWriter writer(memory);
+  binning.writeImage(writer);
+  mprotect(memory, size, PROT_READ);
+
+  //Every array has to stay mapped onto the memory of the node, as a copy
+  //would be made on the heap of the calling thread instead
+
+  Replica replica{node, memory, size, isBound, HyperBinningFrozen()};
+  ImageReader reader(memory, counter.getSize());
+  if (replica.binning.readImage(reader) == false || replica.binning.isMapped() == false){
+    std::cerr << "ReplicatedBinning - the copy on node " << node << " could not be mapped onto its memory" << std::endl;
+    replica.binning = HyperBinningFrozen();
+    munmap(memory, size);
+    return false;
+  }
+
+  _replicas.push_back(replica);
+  return true;
+
+}
+
+///Get the copy on the NUMA node of the calling thread, or the first one
+///if there is none on that node
+const HyperBinningFrozen& ReplicatedBinning::getBinning() const{
+
+  if (_replicas.size() == 1) return _replicas[0].binning;
+
+  int node = getCurrentNode();
+  int replica = node >= 0 && node < (int)_replicaOfNode.size() ? _replicaOfNode[node] : -1;
+  return _replicas[replica == -1 ? 0 : replica].binning;
+
+}
+
+///Get the number of bytes of a copy that are on transparent huge pages,
+///from /proc/self/smaps. This is zero if the kernel gave none, or if it
+///can't be found out.
+std::size_t ReplicatedBinning::getHugePageBytes(int replica) const{
+
+  const std::uintptr_t start = (std::uintptr_t)_replicas[replica].memory;
+  const std::uintptr_t end   = start + _replicas[replica].size;
+
+  std::ifstream smaps("/proc/self/smaps");
+  std::string line;
+  std::size_t bytes = 0;
+  bool inside = false;
+
+  //Each mapping starts with a line "start-end permissions ...", followed
+  //by lines "Field: value kB"
+
+  while (std::getline(smaps, line)){
+    unsigned long long low = 0, high = 0;
+    if (std::sscanf(line.c_str(), "%llx-%llx ", &low, &high) == 2 && line.find(':') > line.find(' ')){
+      inside = low >= start && high <= end;
+      continue;
+    }
+    std::size_t kB = 0;
+    if (inside && std::sscanf(line.c_str(), "AnonHugePages: %zu kB", &kB) == 1) bytes += 1024*kB;
+  }
+
+  return bytes;
+
+}
+
+///Get the NUMA nodes that are online, from /sys/devices/system/node/online,
+///which holds a list like "0-1" or "0,2-3". Returns {0} if it can't be read.
+std::vector<int> ReplicatedBinning::getNumaNodes(){
+
+  std::vector<int> nodes;
+
+  std::ifstream online("/sys/devices/system/node/online");
+  std::string list;
+  if (std::getline(online, list)){
+    std::stringstream ranges(list);
+    std::string range;
+    while (std::getline(ranges, range, ',')){
+      int first = 0, last = 0;
+      int n = std::sscanf(range.c_str(), "%d-%d", &first, &last);
+      if (n == 1) last = first;
+      if (n < 1 || first < 0 || last < first) continue;
+      for (int node = first; node <= last; node++) nodes.push_back(node);
+    }
+  }
+
+  if (nodes.size() == 0) nodes.push_back(0);
+  return nodes;
+
+}
+
+///Get the NUMA node of the CPU that the calling thread is running on, or
+///-1 if it can't be found out
+int ReplicatedBinning::getCurrentNode(){
+
+#ifdef SYS_getcpu
+  unsigned cpu = 0, node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, 0) == 0) return node;
+#endif
+  return -1;
+
+}
@@ -0,0 +1,368 @@
+#include "SharedBinning.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+///Construct a SharedBinning that isn't attached to anything
+///
+SharedBinning::SharedBinning() :
+  _fd         (-1),
+  _segment    (0),
+  _segmentSize(0),
+  _version    (0),
+  _isPublisher(false)
+{
+
+}
+
+///Detach, and remove the segment if no other process is using it
+///
+SharedBinning::~SharedBinning(){
+  detach();
+}
+
+///Publish a binning into a new segment, and attach to it. Fails if a
+///segment with this name already exists.
+bool SharedBinning::publish(const std::string& name, const HyperBinningFrozen& binning, std::uint64_t version){
+
+  detach();
+
+  bool exists = false;
+  if (create(name, binning, version, exists)) return true;
+
+  if (exists){
+    std::cerr << "SharedBinning::publish - there is already a shared binning called " << name << std::endl;
+  }
+  return false;
+
+}
+
+///Attach to a segment published by another process. If the segment is
+///still being written, this waits until it is complete. Fails if there is
+///no such segment, or if it holds a different version of the binning.
+bool SharedBinning::attach(const std::string& name, std::uint64_t version){
+
+  detach();
+
+  Status status = open(name, version);
+
+  if (status == Missing) std::cerr << "SharedBinning::attach - there is no shared binning called " << name << std::endl;
+  if (status == Stale  ) std::cerr << "SharedBinning::attach - the shared binning called " << name << " was never completed" << std::endl;
+
+  return status == Attached;
+
+}
+
+///Attach to a segment, or publish one if there isn't one yet. makeBinning
+///is only called by the process that publishes the segment, so the binning
+///scheme is only loaded once per machine. Half-written segments left behind
+///by crashed processes, and unused segments that hold a different version,
+///are replaced. Fails if the segment holds a different version and is in use.
+bool SharedBinning::attachOrPublish(const std::string& name, const std::function<HyperBinningFrozen()>& makeBinning, std::uint64_t version){
+
+  detach();
+
+  std::unique_ptr<HyperBinningFrozen> binning;
+
+  //Other processes can publish, detach and remove segments at any time,
+  //so keep trying until one of the two succeeds
+
+  for (int attempt = 0; attempt < 1000; attempt++){
+
+    Status status = open(name, version);
+    if (status == Attached) return true;
+    if (status == Failed  ) return false;
+
+    if (status == Missing){
+      if (binning == 0) binning.reset(new HyperBinningFrozen(makeBinning()));
+      bool exists = false;
+      if (create(name, *binning, version, exists)) return true;
+      if (exists == false) return false;
+    }
+
+    //The segment is stale or holds the wrong version, or another process
+    //has just created it, or it was retired by a process that crashed
+    //before removing it. Remove it if nobody is using it, otherwise wait
+    //for a moment (a stale segment is only locked while someone else is
+    //looking at it, or just being created)
+
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd == -1) continue;
+    bool removed = removeIfUnused(fd, name);
+    close(fd);
+
+    if (removed == false){
+      if (status == WrongVersion){
+        std::cerr << "SharedBinning::attachOrPublish - the shared binning called " << name << " holds a different version, and is in use" << std::endl;
+        return false;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+  }
+
+  std::cerr << "SharedBinning::attachOrPublish - gave up on the shared binning called " << name << std::endl;
+  return false;
+
+}
+
+///Detach from the segment. If no other process is attached, the segment
+///is removed.
+void SharedBinning::detach(){
+
+  if (_fd == -1) return;
+
+  _binning = HyperBinningFrozen();
+  if (_segment != 0) munmap(_segment, _segmentSize);
+  _segment     = 0;
+  _segmentSize = 0;
+
+  removeIfUnused(_fd, _name);
+  release();
+
+}
+
+///Remove a segment, whether or not it is in use. Processes that are
+///attached to it keep their mapping, but nobody else can attach to it.
+bool SharedBinning::remove(const std::string& name){
+  return shm_unlink(name.c_str()) == 0;
+}
+
+///Open an existing segment, wait until nobody is writing it, and attach to
+///it if it is complete and holds the right version
+SharedBinning::Status SharedBinning::open(const std::string& name, std::uint64_t version){
+
+  //The publisher holds an exclusive lock until the segment is complete.
+  //A segment smaller than the header has only just been created, and its
+  //publisher is about to lock it, so wait for it with a growing backoff.
+  //It is only stale if it stays that way for _creatingTimeout.
+
+  struct stat info;
+  for (int waited = 0, wait = 1; ; waited += wait, wait *= 2){
+
+    _fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (_fd == -1){
+      if (errno == ENOENT) return Missing;
+      std::cerr << "SharedBinning - could not open " << name << ": " << std::strerror(errno) << std::endl;
+      return Failed;
+    }
+    _name = name;
+
+    while (flock(_fd, LOCK_SH) == -1){
+      if (errno != EINTR){
+        std::cerr << "SharedBinning - could not lock " << name << ": " << std::strerror(errno) << std::endl;
+        release();
+        return Failed;
+      }
+    }
+
+    if (fstat(_fd, &info) == -1){
+      std::cerr << "SharedBinning - could not look at " << name << ": " << std::strerror(errno) << std::endl;
+      release();
+      return Failed;
+    }
+    if ((std::size_t)info.st_size >= _imageOffset) break;
+
+    release();
+    if (waited >= _creatingTimeout) return Stale;
+    std::this_thread::sleep_for(std::chrono::milliseconds(wait));
+
+  }
+
+  _segmentSize = info.st_size;
+  _segment     = mmap(0, _segmentSize, PROT_READ, MAP_SHARED, _fd, 0);
+  if (_segment == MAP_FAILED){
+    std::cerr << "SharedBinning - could not map " << name << ": " << std::strerror(errno) << std::endl;
+    _segment = 0;
+    release();
+    return Failed;
+  }
+
+  const Header& header = *static_cast<const Header*>(_segment);
+
+  Status status = Attached;
+  if      (std::memcmp(header.magic, "HBSHARED", 8) != 0) status = Stale;
+  else if (header.state == Retired) status = Missing;
+  else if (header.state != Ready  ) status = Stale;
+  else if (header.formatVersion != FormatVersion || header.imageVersion != HyperBinningFrozen::ImageVersion){
+    std::cerr << "SharedBinning - the shared binning called " << name << " was written by an incompatible build" << std::endl;
+    status = WrongVersion;
+  }
+  else if (header.version != version){
+    std::cerr << "SharedBinning - the shared binning called " << name << " has version " << header.version << ", not " << version << std::endl;
+    status = WrongVersion;
+  }
+  else if (header.imageSize > _segmentSize - _imageOffset || mapImage() == false) status = Failed;
+
+  if (status != Attached){
+    munmap(_segment, _segmentSize);
+    _segment     = 0;
+    _segmentSize = 0;
+    release();
+    return status;
+  }
+
+  _version     = version;
+  _isPublisher = false;
+  return Attached;
+
+}
+
+///Create a new segment, write the binning into it, and attach to it.
+///exists is set if there already is a segment with this name.
+bool SharedBinning::create(const std::string& name, const HyperBinningFrozen& binning, std::uint64_t version, bool& exists){
+
+  exists = false;
+
+  _fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (_fd == -1){
+    exists = errno == EEXIST;
+    if (exists == false) std::cerr << "SharedBinning - could not create " << name << ": " << std::strerror(errno) << std::endl;
+    return false;
+  }
+  _name = name;
+
+  //Hold an exclusive lock while writing, so that other processes wait
+  //for the segment to be complete. Until the lock is taken, another process
+  //may have taken the segment for stale and removed it, in which case
+  //it is given up, and exists is set so that attachOrPublish() tries again.
+
+  while (flock(_fd, LOCK_EX) == -1){
+    if (errno != EINTR){
+      std::cerr << "SharedBinning - could not lock " << name << ": " << std::strerror(errno) << std::endl;
+      shm_unlink(name.c_str());
+      release();
+      return false;
+    }
+  }
+
+  if (hasName(_fd, name) == false){
+    release();
+    exists = true;
+    return false;
+  }
+
+  ImageWriter counter;
+  binning.writeImage(counter);
+
+  _segmentSize = _imageOffset + counter.getSize();
+  if (ftruncate(_fd, _segmentSize) == -1){
+    std::cerr << "SharedBinning - could not make " << name << " large enough: " << std::strerror(errno) << std::endl;
+    shm_unlink(name.c_str());
+    release();
+    return false;
+  }
+
+  _segment = mmap(0, _segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+  if (_segment == MAP_FAILED){
+    std::cerr << "SharedBinning - could not map " << name << ": " << std::strerror(errno) << std::endl;
+    _segment = 0;
+    shm_unlink(name.c_str());
+    release();
+    return false;
+  }
+
+  Header& header = *static_cast<Header*>(_segment);
+  std::memcpy(header.magic, "HBSHARED", 8);
+  header.formatVersion = FormatVersion;
+  header.imageVersion  = HyperBinningFrozen::ImageVersion;
+  header.version       = version;
+  header.imageSize     = counter.getSize();
+  header.state         = Writing;
+
+  ImageWriter writer(static_cast<char*>(_segment) + _imageOffset);
+  binning.writeImage(writer);
+
+  header.state = Ready;
+
+  //From now on, nobody writes to the segment
+
+  mprotect(_segment, _segmentSize, PROT_READ);
+  while (flock(_fd, LOCK_SH) == -1){
+    if (errno != EINTR){
+      std::cerr << "SharedBinning - could not share the lock on " << name << ": " << std::strerror(errno) << std::endl;
+      break;
+    }
+  }
+
+  _version     = version;
+  _isPublisher = true;
+  if (mapImage() == false){
+    detach();
+    return false;
+  }
+  return true;
+
+}
+
+///Point the binning at the image in the segment. Every array has to stay
+///mapped onto it, or this process would hold a copy of its own.
+bool SharedBinning::mapImage(){
+
+  const Header& header = *static_cast<const Header*>(_segment);
+  ImageReader reader(static_cast<const char*>(_segment) + _imageOffset, header.imageSize);
+  if (_binning.readImage(reader) == false) return false;
+
+  if (_binning.isMapped() == false){
+    std::cerr << "SharedBinning - the binning in " << _name << " was copied out of the segment" << std::endl;
+    _binning = HyperBinningFrozen();
+    return false;
+  }
+  return true;
+
+}
+
+///Close the segment, which releases the lock
+///
+void SharedBinning::release(){
+
+  if (_fd != -1) close(_fd);
+  _fd          = -1;
+  _isPublisher = false;
+  _name.clear();
+
+}
+
+///Remove a segment if no other process holds a lock on it. It is first
+///marked as retired, for processes that have opened it but not looked at
+///it yet, and the name is only removed if it still refers to this segment.
+bool SharedBinning::removeIfUnused(int fd, const std::string& name){
+
+  if (flock(fd, LOCK_EX | LOCK_NB) == -1) return false;
+
+  struct stat info;
+  if (fstat(fd, &info) == 0 && (std::size_t)info.st_size >= _imageOffset){
+    const std::uint32_t state = Retired;
+    if (pwrite(fd, &state, sizeof(state), offsetof(Header, state)) != sizeof(state)) return false;
+  }
+
+  return hasName(fd, name) && shm_unlink(name.c_str()) == 0;
+
+}
+
+///Check if name still refers to the segment that fd is open on
+///
+bool SharedBinning::hasName(int fd, const std::string& name){
+
+  int other = shm_open(name.c_str(), O_RDONLY, 0);
+  if (other == -1) return false;
+
+  struct stat info, otherInfo;
+  bool isSame = fstat(fd, &info) == 0 && fstat(other, &otherInfo) == 0 &&
+                info.st_dev == otherInfo.st_dev && info.st_ino == otherInfo.st_ino;
+  close(other);
+
+  return isSame;
+
+}
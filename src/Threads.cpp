@@ -0,0 +1,37 @@
+#include "Threads.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+///Get the number of threads to use when nThreads are asked for, which is
+///the number of hardware threads if nThreads is zero or less
+int Threads::getNumThreads(int nThreads){
+
+  return nThreads > 0 ? nThreads : std::max(1u, std::thread::hardware_concurrency());
+
+}
+
+///Run work(thread) on nThreads threads, one of which is the calling thread,
+///and wait for all of them to finish
+void Threads::runThreads(int nThreads, const std::function<void(int)>& work){
+
+  std::vector<std::thread> threads;
+  for (int i = 1; i < nThreads; i++) threads.emplace_back(work, i);
+  work(0);
+  for (auto& thread : threads) thread.join();
+
+}
+
+///Run work(thread, chunk) for every chunk from 0 to nChunks - 1 on nThreads
+///threads, which take the chunks in turn, and wait for all of them to
+///finish. All nThreads threads are started, even if there are fewer chunks.
+void Threads::runThreads(int nThreads, int nChunks, const std::function<void(int, int)>& work){
+
+  std::atomic<int> nextChunk(0);
+  runThreads(nThreads, [&](int thread){
+    for (int chunk = nextChunk++; chunk < nChunks; chunk = nextChunk++) work(thread, chunk);
+  });
+
+}
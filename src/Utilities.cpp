@@ -5,6 +5,7 @@
 #include<numeric>
 #include"TLorentzVector.h"
 #include"TVector3.h"
+#include"TMath.h"
 #include"Utilities.h"
 
 namespace Utilities {
@@ -83,4 +84,71 @@ namespace Utilities {
 
   }
   
+  bool getBinningCoordinates(const std::array<TLorentzVector, 4> &daughters,
+			     const TLorentzVector &parent,
+			     HyperPoint &hyperPoint) {
+
+    // Calculate the five variables that parameterise the D decay
+
+    const double mPlus = (daughters[0] + daughters[1]).M();
+    const double mMinus = (daughters[2] + daughters[3]).M();
+
+    double cosThetaPlus =
+      getCosTheta(daughters[0], daughters[0] + daughters[1], parent);
+
+    double cosThetaMinus =
+      getCosTheta(daughters[2], daughters[2] + daughters[3], parent);
+
+    double phi = getPhi(daughters);
+
+    constexpr double mMin = 2.0*0.13957039;
+
+    double mPlusPrime, mMinusPrime;
+    if(mMinus > mPlus) {
+      mPlusPrime  = mPlus  + (mPlus - mMin);
+      mMinusPrime = mMinus + (mPlus - mMin);
+    }
+    else {
+      mPlusPrime  = mPlus  + (mMinus - mMin);
+      mMinusPrime = mMinus + (mMinus - mMin);
+    }
+
+    // Transform the variables so that cosThetaPlus > 0, cosThetaMinus > 0 and phi > 0
+
+    if (cosThetaPlus < 0.0){
+      cosThetaPlus = -cosThetaPlus;
+      phi = phi - TMath::Pi();
+    }
+
+    if (cosThetaMinus < 0.0){
+      cosThetaMinus = -cosThetaMinus;
+      phi = phi- TMath::Pi();
+    }
+
+    while (phi < -TMath::Pi()){
+      phi += 2.0*TMath::Pi();
+    }
+
+    while (phi > TMath::Pi()){
+      phi -= 2.0*TMath::Pi();
+    }
+
+    bool Flip = false;
+    if (phi < 0){
+      std::swap(cosThetaPlus, cosThetaMinus); 
+      std::swap(mPlusPrime  , mMinusPrime  ); 
+      phi = -phi;
+      Flip = true;
+    }
+
+    hyperPoint.at(0) = mPlusPrime;
+    hyperPoint.at(1) = mMinusPrime;
+    hyperPoint.at(2) = cosThetaPlus;
+    hyperPoint.at(3) = cosThetaMinus;
+    hyperPoint.at(4) = phi;
+
+    return Flip;
+
+  }
+  
 }  
@@ -0,0 +1,142 @@
+/**
+ * Checks that HyperBinning::getBinNum and HyperHistogram::getVal make no
+ * heap allocations
+ * A binning scheme is built, saved and loaded again, and the allocations
+ * made while looking up random points are counted with a replaced global
+ * operator new
+ *
+ * Returns 1 if any allocation was made, and 0 otherwise
+ */
+
+#include<atomic>
+#include<cstdlib>
+#include<iostream>
+#include<new>
+#include<random>
+#include<vector>
+#include"HyperPoint.h"
+#include"HyperCuboid.h"
+#include"HyperVolume.h"
+#include"HyperHistogram.h"
+#include"HyperBinningBuilder.h"
+#include"HyperBinningMemRes.h"
+
+std::atomic<long> NumberAllocations(0);
+
+void *operator new(std::size_t Size) {
+  NumberAllocations++;
+  void *Pointer = std::malloc(Size == 0 ? 1 : Size);
+  if(Pointer == nullptr) {
+    throw std::bad_alloc();
+  }
+  return Pointer;
+}
+
+void *operator new[](std::size_t Size) {
+  return operator new(Size);
+}
+
+void operator delete(void *Pointer) noexcept {
+  std::free(Pointer);
+}
+
+void operator delete[](void *Pointer) noexcept {
+  std::free(Pointer);
+}
+
+void operator delete(void *Pointer, std::size_t) noexcept {
+  std::free(Pointer);
+}
+
+void operator delete[](void *Pointer, std::size_t) noexcept {
+  std::free(Pointer);
+}
+
+/**
+ * Split a HyperCuboid in half along each dimension in turn, down to a given
+ * depth, and add the HyperVolumes with their links
+ * @param Cuboid The HyperCuboid to split
+ * @param Depth Number of splits left
+ * @param Volumes The HyperVolumes added so far
+ * @param Links The links of each HyperVolume added so far
+ * @return The volume number of the HyperCuboid
+ */
+int AddVolumes(const HyperCuboid &Cuboid, int Depth, std::vector<HyperVolume> &Volumes, std::vector<std::vector<int>> &Links) {
+  const int Dimension = Cuboid.getDimension();
+  const int VolumeNumber = Volumes.size();
+  Volumes.emplace_back(Dimension);
+  Volumes.back().addHyperCuboid(Cuboid);
+  Links.emplace_back();
+  if(Depth == 0) {
+    return VolumeNumber;
+  }
+  const int d = Depth%Dimension;
+  const double Middle = 0.5*(Cuboid.getLowCorner().at(d) + Cuboid.getHighCorner().at(d));
+  HyperPoint LowHigh(Cuboid.getHighCorner()), HighLow(Cuboid.getLowCorner());
+  LowHigh.at(d) = Middle;
+  HighLow.at(d) = Middle;
+  const int Low = AddVolumes(HyperCuboid(Cuboid.getLowCorner(), LowHigh), Depth - 1, Volumes, Links);
+  const int High = AddVolumes(HyperCuboid(HighLow, Cuboid.getHighCorner()), Depth - 1, Volumes, Links);
+  Links[VolumeNumber] = {Low, High};
+  return VolumeNumber;
+}
+
+int main() {
+
+  const int Dimension = 5;
+  const int NumberPoints = 100000;
+  const char *Filename = "AllocationTest.root";
+
+  // Build a binning scheme with 1024 bins, and save it with some bin contents
+
+  std::vector<HyperVolume> Volumes;
+  std::vector<std::vector<int>> Links;
+  AddVolumes(HyperCuboid(Dimension, 0.0, 1.0), 10, Volumes, Links);
+  HyperBinningBuilder Builder(Dimension);
+  Builder.addHyperVolumes(std::move(Volumes), std::move(Links));
+  Builder.addPrimaryVolumeNumber(0);
+  std::unique_ptr<const HyperBinningMemRes> Built = Builder.finalize();
+  if(!Built) {
+    return 1;
+  }
+  {
+    HyperHistogram Histogram(*Built);
+    for(int i = 0; i < Built->getNumBins(); i++) {
+      Histogram.setBinContent(i, i%7);
+    }
+    Histogram.save(Filename);
+  }
+
+  // Load it again, and look up random points inside and outside the binning
+
+  HyperBinningMemRes Binning;
+  Binning.load(Filename);
+  const HyperHistogram Histogram(Filename, "MEMRES READ");
+
+  std::mt19937_64 Random(1);
+  std::vector<HyperPoint> Points(NumberPoints, HyperPoint(Dimension));
+  for(HyperPoint &Point : Points) {
+    for(int d = 0; d < Dimension; d++) {
+      Point.at(d) = std::uniform_real_distribution<double>(-0.1, 1.1)(Random);
+    }
+  }
+
+  // Loading the scheme allocates, so a count of zero here means that the
+  // replaced operator new isn't being used
+
+  const long AllocationsBefore = NumberAllocations;
+  if(AllocationsBefore == 0) {
+    std::cerr << "No allocations were counted while loading the binning scheme\n";
+    return 1;
+  }
+  long Sum = 0;
+  for(const HyperPoint &Point : Points) {
+    Sum += Binning.getBinNum(Point);
+    Sum += Histogram.getVal(Point);
+  }
+  const long Allocations = NumberAllocations - AllocationsBefore;
+
+  std::cout << "Looked up " << NumberPoints << " points (checksum " << Sum << ") with " << Allocations << " allocations\n";
+  return Allocations == 0 ? 0 : 1;
+
+}
@@ -0,0 +1,427 @@
+/**
+ * Checks BinningValidator against brute force on small synthetic binnings,
+ * into which overlaps, gaps and overhangs are injected
+ * - Overlaps, and their volumes, are the same as when every pair of linked HyperCuboids is compared
+ * - Overhangs are the same as when every linked HyperCuboid is compared with the HyperVolume linking to it
+ * - Gap fractions agree with Monte Carlo, and the points that aren't in any linked HyperVolume are in the gap regions
+ * - Flat binnings with more HyperCuboids than are swept at once, which are
+ *   split into a grid of cells, report each overlapping pair exactly once,
+ *   also when the pair shares several cells
+ * - The results don't depend on the number of threads
+ *
+ * Returns 1 if any check fails, and 0 otherwise
+ */
+
+#include<algorithm>
+#include<cmath>
+#include<cstdint>
+#include<iostream>
+#include<map>
+#include<random>
+#include<string>
+#include<utility>
+#include<vector>
+#include"HyperPoint.h"
+#include"HyperCuboid.h"
+#include"HyperVolume.h"
+#include"HyperBinningFrozen.h"
+#include"BinningValidator.h"
+
+// A HyperVolume of a synthetic binning, before it is frozen
+struct Volume {
+  std::vector<std::vector<double>> Low, High;
+  std::vector<int> Links;
+};
+
+int NumberFailures = 0;
+
+std::mt19937_64 Random(17);
+
+void Check(bool Condition, const std::string &Message) {
+  if(!Condition) {
+    std::cerr << "FAILED: " << Message << "\n";
+    NumberFailures++;
+  }
+}
+
+/**
+ * Get a uniform random number in [0, 1), the same on every platform
+ */
+double Uniform() {
+  return (Random() >> 11)*0x1.0p-53;
+}
+
+/**
+ * Freeze a synthetic binning
+ * @param Primary The primary volume, or -1 for a flat binning without primary volumes
+ */
+HyperBinningFrozen Freeze(const std::vector<Volume> &Volumes, int Dimension, int Primary) {
+  HyperBinningFrozen Binning(Dimension);
+  for(const Volume &Vol : Volumes) {
+    HyperVolume HyperVol(Dimension);
+    for(std::size_t c = 0; c < Vol.Low.size(); c++) {
+      HyperPoint Low(Dimension), High(Dimension);
+      for(int d = 0; d < Dimension; d++) {
+        Low.at(d) = Vol.Low[c][d];
+        High.at(d) = Vol.High[c][d];
+      }
+      HyperVol.addHyperCuboid(HyperCuboid(Low, High));
+    }
+    Binning.addHyperVolume(HyperVol, Vol.Links);
+  }
+  if(Primary != -1) {
+    Binning.addPrimaryVolumeNumber(Primary);
+  }
+  Binning.buildIndex();
+  return Binning;
+}
+
+/**
+ * Split a box in random places, down to a given depth, and add the pieces as HyperVolumes linked from the one for the box
+ * Some leaves are made of two HyperCuboids, and some HyperVolumes link to only one other
+ * @return The number of the HyperVolume for the box
+ */
+int Split(std::vector<Volume> &Volumes, const std::vector<double> &Low, const std::vector<double> &High, int Depth) {
+  const int Number = Volumes.size();
+  Volumes.push_back(Volume());
+  Volumes[Number].Low.push_back(Low);
+  Volumes[Number].High.push_back(High);
+  if(Depth == 0) {
+    if(Uniform() < 0.2) {
+      const int Dim = Random()%Low.size();
+      const double Middle = 0.5*(Low[Dim] + High[Dim]);
+      Volumes[Number].High[0][Dim] = Middle;
+      Volumes[Number].Low.push_back(Low);
+      Volumes[Number].High.push_back(High);
+      Volumes[Number].Low[1][Dim] = Middle;
+    }
+    return Number;
+  }
+  if(Uniform() < 0.1) {
+    const int Child = Split(Volumes, Low, High, Depth - 1);
+    Volumes[Number].Links = {Child};
+    return Number;
+  }
+  // Split into two or three pieces along one dimension
+  const int Dim = Random()%Low.size();
+  const int NumberPieces = Uniform() < 0.7 ? 2 : 3;
+  std::vector<double> Edges = {Low[Dim]};
+  for(int i = 1; i < NumberPieces; i++) {
+    Edges.push_back(Low[Dim] + (High[Dim] - Low[Dim])*(i + 0.6*(Uniform() - 0.5))/NumberPieces);
+  }
+  Edges.push_back(High[Dim]);
+  std::vector<int> Links;
+  for(int i = 0; i < NumberPieces; i++) {
+    std::vector<double> PieceLow = Low, PieceHigh = High;
+    PieceLow[Dim] = Edges[i];
+    PieceHigh[Dim] = Edges[i + 1];
+    Links.push_back(Split(Volumes, PieceLow, PieceHigh, Uniform() < 0.3 ? Depth/2 : Depth - 1));
+  }
+  Volumes[Number].Links = Links;
+  return Number;
+}
+
+/**
+ * Get the volume of the overlap of two HyperCuboids
+ */
+double GetOverlap(const double *LowA, const double *HighA, const double *LowB, const double *HighB, int Dimension) {
+  double Overlap = 1.0;
+  for(int d = 0; d < Dimension; d++) {
+    const double Width = std::min(HighA[d], HighB[d]) - std::max(LowA[d], LowB[d]);
+    if(Width <= 0.0) {
+      return 0.0;
+    }
+    Overlap *= Width;
+  }
+  return Overlap;
+}
+
+/**
+ * Get the volume of a HyperVolume
+ */
+double GetVolume(const HyperBinningFrozen &Binning, int VolumeNumber) {
+  double Vol = 0.0;
+  for(int c = 0; c < Binning.getNumHyperCuboids(VolumeNumber); c++) {
+    Vol += GetOverlap(Binning.getLowCorner(VolumeNumber, c), Binning.getHighCorner(VolumeNumber, c), Binning.getLowCorner(VolumeNumber, c), Binning.getHighCorner(VolumeNumber, c), Binning.getDimension());
+  }
+  return Vol;
+}
+
+/**
+ * Get the volume of the overlap of two HyperVolumes
+ */
+double GetOverlap(const HyperBinningFrozen &Binning, int First, int Second) {
+  double Overlap = 0.0;
+  for(int a = 0; a < Binning.getNumHyperCuboids(First); a++) {
+    for(int b = 0; b < Binning.getNumHyperCuboids(Second); b++) {
+      Overlap += GetOverlap(Binning.getLowCorner(First, a), Binning.getHighCorner(First, a), Binning.getLowCorner(Second, b), Binning.getHighCorner(Second, b), Binning.getDimension());
+    }
+  }
+  return Overlap;
+}
+
+/**
+ * Get the HyperVolumes linked from a HyperVolume, or the primary volumes (or those that nothing links to) for -1
+ */
+std::vector<int> GetMembers(const HyperBinningFrozen &Binning, int VolumeNumber) {
+  std::vector<int> Members;
+  if(VolumeNumber != -1) {
+    for(int i = 0; i < Binning.getNumLinkedHyperVolumes(VolumeNumber); i++) {
+      Members.push_back(Binning.getLinkedHyperVolume(VolumeNumber, i));
+    }
+  } else if(Binning.getNumPrimaryVolumes() > 0) {
+    for(int i = 0; i < Binning.getNumPrimaryVolumes(); i++) {
+      Members.push_back(Binning.getPrimaryVolumeNumber(i));
+    }
+  } else {
+    std::vector<bool> IsLinked(Binning.getNumHyperVolumes(), false);
+    for(int i = 0; i < Binning.getNumHyperVolumes(); i++) {
+      for(int j : GetMembers(Binning, i)) {
+        IsLinked[j] = true;
+      }
+    }
+    for(int i = 0; i < Binning.getNumHyperVolumes(); i++) {
+      if(!IsLinked[i]) {
+        Members.push_back(i);
+      }
+    }
+  }
+  return Members;
+}
+
+/**
+ * Compare the overlaps with those found by comparing every pair of linked HyperVolumes
+ * @return The number of overlaps found by brute force
+ */
+int CheckOverlaps(const HyperBinningFrozen &Binning, const BinningValidator &Validator, const std::string &Name) {
+  std::map<std::pair<int, int>, double> Expected;
+  std::vector<int> Parents = {-1};
+  for(int i = 0; i < Binning.getNumHyperVolumes(); i++) {
+    Parents.push_back(i);
+  }
+  for(int Parent : Parents) {
+    const std::vector<int> Members = GetMembers(Binning, Parent);
+    for(std::size_t i = 0; i < Members.size(); i++) {
+      for(std::size_t j = i + 1; j < Members.size(); j++) {
+        const double Overlap = GetOverlap(Binning, Members[i], Members[j]);
+        if(Overlap > 0.0) {
+          // Every HyperVolume is linked from at most one other, so the pair identifies the parent
+          Expected[{Members[i], Members[j]}] = Overlap;
+        }
+      }
+    }
+  }
+  std::map<std::pair<int, int>, int> Reported;
+  for(const BinningValidator::Overlap &Overlap : Validator.getOverlaps()) {
+    const std::pair<int, int> Pair(Overlap.first, Overlap.second);
+    const std::string Label = Name + ": overlap of " + std::to_string(Overlap.first) + " and " + std::to_string(Overlap.second) + " in " + std::to_string(Overlap.volumeNumber);
+    Check(++Reported[Pair] == 1, Label + " is reported more than once");
+    const auto Found = Expected.find(Pair);
+    if(Found == Expected.end()) {
+      Check(false, Label + " doesn't exist");
+      continue;
+    }
+    Check(std::abs(Overlap.volume - Found->second) <= 1e-12*std::max(1.0, Found->second), Label + " has volume " + std::to_string(Overlap.volume) + " instead of " + std::to_string(Found->second));
+  }
+  for(const auto &Pair : Expected) {
+    Check(Reported.count(Pair.first) == 1, Name + ": overlap of " + std::to_string(Pair.first.first) + " and " + std::to_string(Pair.first.second) + " is missing");
+  }
+  return Expected.size();
+}
+
+/**
+ * Compare the overhangs with those found by comparing every linked HyperCuboid with the HyperVolume linking to it
+ * @return The number of overhangs found by brute force
+ */
+int CheckOverhangs(const HyperBinningFrozen &Binning, const BinningValidator &Validator, const std::string &Name) {
+  std::map<std::pair<int, int>, double> Expected;
+  for(int Parent = 0; Parent < Binning.getNumHyperVolumes(); Parent++) {
+    const double ParentVolume = GetVolume(Binning, Parent);
+    for(int Member : GetMembers(Binning, Parent)) {
+      const double Overhang = GetVolume(Binning, Member) - GetOverlap(Binning, Parent, Member);
+      if(Overhang > 1e-9*ParentVolume) {
+        Expected[{Parent, Member}] = Overhang;
+      }
+    }
+  }
+  Check(Validator.getOverhangs().size() == Expected.size(), Name + ": " + std::to_string(Validator.getOverhangs().size()) + " overhangs instead of " + std::to_string(Expected.size()));
+  for(const BinningValidator::Overhang &Overhang : Validator.getOverhangs()) {
+    const auto Found = Expected.find({Overhang.volumeNumber, Overhang.linkedVolume});
+    const std::string Label = Name + ": overhang of " + std::to_string(Overhang.linkedVolume) + " from " + std::to_string(Overhang.volumeNumber);
+    Check(Found != Expected.end() && std::abs(Overhang.volume - Found->second) <= 1e-9*std::max(1.0, Found->second), Label + " doesn't match");
+  }
+  return Expected.size();
+}
+
+/**
+ * Compare the gap fractions with Monte Carlo, and check that the points in no linked HyperVolume are in the gap regions
+ * @return The number of HyperVolumes with a gap
+ */
+int CheckGaps(const HyperBinningFrozen &Binning, const BinningValidator &Validator, int NumberPoints, const std::string &Name) {
+  const int Dimension = Binning.getDimension();
+  std::map<int, const BinningValidator::Gap*> Gaps;
+  for(const BinningValidator::Gap &Gap : Validator.getGaps()) {
+    Gaps[Gap.volumeNumber] = &Gap;
+  }
+  int NumberGaps = 0;
+  std::vector<double> Point(Dimension);
+  for(int Parent = 0; Parent < Binning.getNumHyperVolumes(); Parent++) {
+    const std::vector<int> Members = GetMembers(Binning, Parent);
+    if(Members.empty()) {
+      continue;
+    }
+    const BinningValidator::Gap *Gap = Gaps.count(Parent) == 1 ? Gaps[Parent] : nullptr;
+    const double *Limits = Binning.getVolumeLimits(Parent);
+    int NumberInside = 0, NumberMissed = 0, NumberOutsideRegions = 0;
+    for(int n = 0; n < NumberPoints; n++) {
+      for(int d = 0; d < Dimension; d++) {
+        Point[d] = Limits[d] + (Limits[Dimension + d] - Limits[d])*Uniform();
+      }
+      if(!Binning.inHyperVolume(Parent, Point.data())) {
+        continue;
+      }
+      NumberInside++;
+      const bool Covered = std::any_of(Members.begin(), Members.end(), [&](int Member) { return Binning.inHyperVolume(Member, Point.data()); });
+      if(Covered) {
+        continue;
+      }
+      NumberMissed++;
+      if(Gap != nullptr && Gap->allRegions) {
+        const bool InRegion = std::any_of(Gap->regions.begin(), Gap->regions.end(), [&](const HyperCuboid &Region) {
+          for(int d = 0; d < Dimension; d++) {
+            if(Point[d] < Region.getLowCorner().at(d) || Point[d] >= Region.getHighCorner().at(d)) {
+              return false;
+            }
+          }
+          return true;
+        });
+        NumberOutsideRegions += !InRegion;
+      }
+    }
+    const double Fraction = Gap != nullptr ? Gap->fraction : 0.0;
+    const double Estimate = NumberInside > 0 ? static_cast<double>(NumberMissed)/NumberInside : 0.0;
+    const double Error = std::sqrt(std::max(Fraction*(1.0 - Fraction), 1.0/NumberPoints)/std::max(NumberInside, 1));
+    const std::string Label = Name + ": HyperVolume " + std::to_string(Parent);
+    Check(std::abs(Estimate - Fraction) <= 5.0*Error, Label + " has a gap of " + std::to_string(Fraction) + ", but Monte Carlo finds " + std::to_string(Estimate));
+    Check(NumberOutsideRegions == 0, Label + " has " + std::to_string(NumberOutsideRegions) + " uncovered points outside its gap regions");
+    NumberGaps += Gap != nullptr;
+  }
+  Check(NumberGaps == static_cast<int>(Validator.getGaps().size()), Name + ": gaps are reported for HyperVolumes without links");
+  return NumberGaps;
+}
+
+/**
+ * Validate a binning on one and on several threads, and compare the results with brute force
+ * @param IsFlat If true, nothing links to anything, and there can only be overlaps
+ */
+void CheckBinning(const HyperBinningFrozen &Binning, int NumberPoints, bool IsFlat, const std::string &Name) {
+  BinningValidator Validator(1e-9, 1000);
+  BinningValidator OneThread(1e-9, 1000);
+  Validator.validate(Binning, 4);
+  OneThread.validate(Binning, 1);
+
+  bool SameResults = Validator.getOverlaps().size() == OneThread.getOverlaps().size() && Validator.getGaps().size() == OneThread.getGaps().size() && Validator.getOverhangs().size() == OneThread.getOverhangs().size();
+  for(std::size_t i = 0; SameResults && i < Validator.getOverlaps().size(); i++) {
+    SameResults = Validator.getOverlaps()[i].first == OneThread.getOverlaps()[i].first && Validator.getOverlaps()[i].second == OneThread.getOverlaps()[i].second && Validator.getOverlaps()[i].volume == OneThread.getOverlaps()[i].volume;
+  }
+  for(std::size_t i = 0; SameResults && i < Validator.getGaps().size(); i++) {
+    SameResults = Validator.getGaps()[i].volumeNumber == OneThread.getGaps()[i].volumeNumber && Validator.getGaps()[i].volume == OneThread.getGaps()[i].volume;
+  }
+  Check(SameResults, Name + ": the results depend on the number of threads");
+
+  const int NumberOverlaps = CheckOverlaps(Binning, Validator, Name);
+  const int NumberOverhangs = CheckOverhangs(Binning, Validator, Name);
+  const int NumberGaps = CheckGaps(Binning, Validator, NumberPoints, Name);
+  Check(NumberOverlaps > 0 && (IsFlat || (NumberOverhangs > 0 && NumberGaps > 0)), Name + ": not every kind of defect was injected");
+  std::cout << Name << ": " << NumberOverlaps << " overlaps, " << NumberGaps << " gaps and " << NumberOverhangs << " overhangs\n";
+}
+
+/**
+ * A hierarchical binning in three dimensions, with some HyperVolumes shrunk, which leaves gaps, and some grown, which makes overlaps and overhangs
+ */
+void TestHierarchy() {
+  const int Dimension = 3;
+  std::vector<Volume> Volumes;
+  Split(Volumes, std::vector<double>(Dimension, 0.0), std::vector<double>(Dimension, 1.0), 9);
+  for(int k = 0; k < 60; k++) {
+    Volume &Vol = Volumes[1 + Random()%(Volumes.size() - 1)];
+    const int Dim = Random()%Dimension;
+    const double Width = Vol.High[0][Dim] - Vol.Low[0][Dim];
+    if(k%3 == 0) {
+      Vol.High[0][Dim] -= 0.3*Width;
+    } else if(k%3 == 1) {
+      Vol.High[0][Dim] += 0.3*Width;
+    } else {
+      Vol.Low[0][Dim] -= 0.3*Width;
+    }
+  }
+  CheckBinning(Freeze(Volumes, Dimension, 0), 20000, false, "Hierarchy");
+}
+
+/**
+ * A grid of bins, with more HyperCuboids than are swept at once, so that they are split into a grid of cells
+ * A few bins are left out, which leaves gaps, and large bins are added on top, which overlap many bins in several cells
+ * Some of the large bins are made of several HyperCuboids that overlap the same bins
+ * @param WithParent If true, the bins are linked from a HyperVolume around the grid, otherwise the binning is flat
+ */
+void TestGrid(int Dimension, int BinsPerDim, bool WithParent) {
+  std::vector<Volume> Volumes;
+  if(WithParent) {
+    Volumes.push_back(Volume());
+    Volumes[0].Low.push_back(std::vector<double>(Dimension, 0.0));
+    Volumes[0].High.push_back(std::vector<double>(Dimension, BinsPerDim));
+  }
+  const int First = Volumes.size();
+  int NumberBins = 1;
+  for(int d = 0; d < Dimension; d++) {
+    NumberBins *= BinsPerDim;
+  }
+  for(int i = 0; i < NumberBins; i++) {
+    if(i%97 == 13) {
+      continue;
+    }
+    Volume Bin;
+    std::vector<double> Low(Dimension), High(Dimension);
+    for(int d = 0, Index = i; d < Dimension; d++, Index /= BinsPerDim) {
+      Low[d] = Index%BinsPerDim;
+      High[d] = Low[d] + 1.0;
+    }
+    Bin.Low.push_back(Low);
+    Bin.High.push_back(High);
+    Volumes.push_back(Bin);
+  }
+  for(int k = 0; k < 12; k++) {
+    Volume Bin;
+    for(int c = 0; c < 1 + k%3; c++) {
+      std::vector<double> Low(Dimension), High(Dimension);
+      for(int d = 0; d < Dimension; d++) {
+        const double Width = 0.5 + 0.3*BinsPerDim*Uniform();
+        Low[d] = (BinsPerDim + 2.0)*Uniform() - 2.0;
+        High[d] = Low[d] + Width;
+      }
+      Bin.Low.push_back(Low);
+      Bin.High.push_back(High);
+    }
+    Volumes.push_back(Bin);
+  }
+  if(WithParent) {
+    for(int i = First; i < static_cast<int>(Volumes.size()); i++) {
+      Volumes[0].Links.push_back(i);
+    }
+  }
+  const std::string Name = std::string(WithParent ? "Linked" : "Flat") + " grid in " + std::to_string(Dimension) + " dimensions";
+  CheckBinning(Freeze(Volumes, Dimension, WithParent ? 0 : -1), 200000, !WithParent, Name);
+}
+
+int main() {
+
+  TestHierarchy();
+  TestGrid(2, 40, true);
+  TestGrid(2, 40, false);
+  TestGrid(3, 12, true);
+  TestGrid(3, 12, false);
+
+  std::cout << NumberFailures << " checks failed\n";
+  return NumberFailures == 0 ? 0 : 1;
+
+}
@@ -0,0 +1,281 @@
+/**
+ * Checks the protocol with which SharedBinning shares a binning between
+ * processes, with forked processes that attach, publish, detach and crash
+ * - Many processes that call attachOrPublish at once publish exactly once
+ * - Attached binnings are mapped onto the segment, and not copied
+ * - Segments of another version are refused while in use, and replaced when not
+ * - A segment outlives a process that is killed, and is removed by the last one to detach
+ * - Half-written and retired segments are never attached to, and are replaced
+ *
+ * Returns 1 if any check fails, and 0 otherwise
+ */
+
+#include<cstdint>
+#include<cstring>
+#include<iostream>
+#include<string>
+#include<vector>
+#include<fcntl.h>
+#include<signal.h>
+#include<sys/mman.h>
+#include<sys/wait.h>
+#include<unistd.h>
+#include"HyperPoint.h"
+#include"HyperCuboid.h"
+#include"HyperVolume.h"
+#include"HyperBinningFrozen.h"
+#include"SharedBinning.h"
+
+// Same layout as the header at the start of a segment
+struct SegmentHeader {
+  char Magic[8];
+  std::uint32_t FormatVersion;
+  std::uint32_t ImageVersion;
+  std::uint64_t Version;
+  std::uint64_t ImageSize;
+  std::uint32_t State;
+};
+
+int NumberFailures = 0;
+
+void Check(bool Condition, const std::string &Message) {
+  if(!Condition) {
+    std::cerr << "FAILED: " << Message << "\n";
+    NumberFailures++;
+  }
+}
+
+/**
+ * Make a flat binning with a grid of bins in two dimensions, with a spatial index
+ */
+HyperBinningFrozen MakeBinning() {
+  HyperBinningFrozen Binning(2);
+  for(int i = 0; i < 32; i++) {
+    for(int j = 0; j < 32; j++) {
+      HyperPoint Low(2), High(2);
+      Low.at(0) = i;
+      Low.at(1) = j;
+      High.at(0) = i + 1;
+      High.at(1) = j + 1;
+      HyperVolume Volume(2);
+      Volume.addHyperCuboid(HyperCuboid(Low, High));
+      Binning.addHyperVolume(Volume, std::vector<int>());
+    }
+  }
+  Binning.buildIndex();
+  return Binning;
+}
+
+/**
+ * Check that an attached binning is mapped onto the segment, and is the same as the original
+ */
+bool IsSameBinning(const HyperBinningFrozen &Binning, const HyperBinningFrozen &Original) {
+  const double Coords[2] = {17.5, 3.5};
+  return Binning.isMapped() && Binning.getFingerprint() == Original.getFingerprint() && Binning.getBinNum(Coords) == Original.getBinNum(Coords);
+}
+
+/**
+ * Wait for a forked process, and get its exit code, or -1 if it didn't exit normally
+ */
+int WaitFor(pid_t Pid) {
+  int Status = 0;
+  if(waitpid(Pid, &Status, 0) != Pid || !WIFEXITED(Status)) {
+    return -1;
+  }
+  return WEXITSTATUS(Status);
+}
+
+/**
+ * Fork a process that publishes a binning, and kill it once it has, so that the segment is left behind with nobody attached
+ */
+bool PublishAndKill(const std::string &Name, std::uint64_t Version) {
+  int Ready[2];
+  if(pipe(Ready) == -1) {
+    return false;
+  }
+  const pid_t Pid = fork();
+  if(Pid == 0) {
+    close(Ready[0]);
+    SharedBinning Shared;
+    const char Byte = Shared.publish(Name, MakeBinning(), Version) ? 1 : 0;
+    if(write(Ready[1], &Byte, 1) != 1) {
+      _exit(1);
+    }
+    pause();
+    _exit(0);
+  }
+  close(Ready[1]);
+  char Byte = 0;
+  const bool Published = read(Ready[0], &Byte, 1) == 1 && Byte == 1;
+  close(Ready[0]);
+  kill(Pid, SIGKILL);
+  return WaitFor(Pid) == -1 && Published;
+}
+
+/**
+ * Write a segment by hand, as it is left behind by a process that crashed
+ */
+void WriteSegment(const std::string &Name, std::size_t Size, std::uint32_t State) {
+  SharedBinning::remove(Name);
+  const int Fd = shm_open(Name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if(Fd == -1) {
+    return;
+  }
+  if(Size != 0 && ftruncate(Fd, Size) == 0 && State != 0) {
+    SegmentHeader Header;
+    std::memset(&Header, 0, sizeof(Header));
+    std::memcpy(Header.Magic, "HBSHARED", 8);
+    Header.FormatVersion = SharedBinning::FormatVersion;
+    Header.ImageVersion = HyperBinningFrozen::ImageVersion;
+    Header.State = State;
+    if(pwrite(Fd, &Header, sizeof(Header), 0) != sizeof(Header)) {
+      std::cerr << "Could not write the header of " << Name << "\n";
+    }
+  }
+  close(Fd);
+}
+
+/**
+ * Check if a segment exists
+ */
+bool Exists(const std::string &Name) {
+  const int Fd = shm_open(Name.c_str(), O_RDONLY, 0);
+  if(Fd == -1) {
+    return false;
+  }
+  close(Fd);
+  return true;
+}
+
+/**
+ * Start many processes at once that all call attachOrPublish, and stay attached until all of them are
+ */
+void TestConcurrentAttachOrPublish(const std::string &Name) {
+  const int NumberProcesses = 16;
+  const int NumberRounds = 20;
+  const HyperBinningFrozen Original = MakeBinning();
+  for(int Round = 0; Round < NumberRounds; Round++) {
+    int Start[2], Attached[2], Release[2];
+    if(pipe(Start) == -1 || pipe(Attached) == -1 || pipe(Release) == -1) {
+      Check(false, "Could not make the pipes");
+      return;
+    }
+    std::vector<pid_t> Pids;
+    for(int i = 0; i < NumberProcesses; i++) {
+      const pid_t Pid = fork();
+      if(Pid == 0) {
+        close(Start[1]);
+        close(Attached[0]);
+        close(Release[1]);
+        char Byte = 0;
+        if(read(Start[0], &Byte, 1) != 0) {
+          _exit(3);
+        }
+        SharedBinning Shared;
+        const bool Ok = Shared.attachOrPublish(Name, MakeBinning) && IsSameBinning(Shared.getBinning(), Original);
+        if(write(Attached[1], &Byte, 1) != 1 || read(Release[0], &Byte, 1) != 0) {
+          _exit(3);
+        }
+        const int ExitCode = !Ok ? 2 : Shared.isPublisher() ? 1 : 0;
+        Shared.detach();
+        _exit(ExitCode);
+      }
+      Pids.push_back(Pid);
+    }
+    close(Start[0]);
+    close(Attached[1]);
+    close(Release[0]);
+    close(Start[1]);
+    char Byte = 0;
+    for(int i = 0; i < NumberProcesses; i++) {
+      if(read(Attached[0], &Byte, 1) != 1) {
+        break;
+      }
+    }
+    close(Release[1]);
+    close(Attached[0]);
+    int NumberPublishers = 0, NumberFailed = 0;
+    for(pid_t Pid : Pids) {
+      const int ExitCode = WaitFor(Pid);
+      NumberPublishers += ExitCode == 1;
+      NumberFailed += ExitCode != 0 && ExitCode != 1;
+    }
+    Check(NumberPublishers == 1 && NumberFailed == 0, "Round " + std::to_string(Round) + " of attachOrPublish had " + std::to_string(NumberPublishers) + " publishers and " + std::to_string(NumberFailed) + " failures");
+    Check(!Exists(Name), "The segment wasn't removed when the last process detached");
+  }
+}
+
+/**
+ * A segment of another version can't be attached to, and attachOrPublish only replaces it if nobody uses it
+ */
+void TestVersions(const std::string &Name) {
+  SharedBinning Publisher;
+  Check(Publisher.publish(Name, MakeBinning(), 1), "Could not publish version 1");
+  const pid_t Pid = fork();
+  if(Pid == 0) {
+    SharedBinning Shared;
+    if(Shared.attach(Name, 2) || Shared.attachOrPublish(Name, MakeBinning, 2)) {
+      _exit(1);
+    }
+    const int ExitCode = Shared.attach(Name, 1) && !Shared.isPublisher() ? 0 : 1;
+    Shared.detach();
+    _exit(ExitCode);
+  }
+  Check(WaitFor(Pid) == 0, "Version 2 was attached to while version 1 was in use");
+  Publisher.detach();
+  Check(!Exists(Name), "The segment wasn't removed when the last process detached");
+
+  Check(PublishAndKill(Name, 1), "Could not publish version 1 and kill the publisher");
+  SharedBinning Shared;
+  Check(Shared.attachOrPublish(Name, MakeBinning, 2) && Shared.isPublisher() && Shared.getVersion() == 2, "An unused segment of version 1 wasn't replaced by version 2");
+}
+
+/**
+ * A segment outlives a publisher that is killed, and the next process to detach removes it
+ */
+void TestKilledHolder(const std::string &Name) {
+  Check(PublishAndKill(Name, 0), "Could not publish and kill the publisher");
+  Check(Exists(Name), "The segment didn't outlive its publisher");
+  SharedBinning Shared;
+  Check(Shared.attach(Name) && !Shared.isPublisher() && IsSameBinning(Shared.getBinning(), MakeBinning()), "Could not attach to the segment of a killed publisher");
+  Shared.detach();
+  Check(!Exists(Name), "The segment of a killed publisher wasn't removed by the last process to detach");
+}
+
+/**
+ * Segments left behind by crashed processes are never attached to, and attachOrPublish replaces them
+ */
+void TestLeftBehind(const std::string &Name) {
+  const std::size_t Size = 2*4096;
+  const std::vector<std::uint32_t> States = {1, 3, 7};
+  for(std::uint32_t State : States) {
+    WriteSegment(Name, Size, State);
+    SharedBinning Shared;
+    Check(!Shared.attach(Name), "Attached to a segment in state " + std::to_string(State));
+    Check(Shared.attachOrPublish(Name, MakeBinning) && Shared.isPublisher(), "A segment in state " + std::to_string(State) + " wasn't replaced");
+  }
+  // A segment that was never filled in, or never even made large enough for its header
+  const std::vector<std::size_t> Sizes = {Size, 0};
+  for(std::size_t SegmentSize : Sizes) {
+    WriteSegment(Name, SegmentSize, 0);
+    SharedBinning Shared;
+    Check(!Shared.attach(Name), "Attached to an empty segment of " + std::to_string(SegmentSize) + " bytes");
+    Check(Shared.attachOrPublish(Name, MakeBinning) && Shared.isPublisher(), "An empty segment of " + std::to_string(SegmentSize) + " bytes wasn't replaced");
+  }
+}
+
+int main() {
+
+  const std::string Name = "/SharedBinningTest" + std::to_string(getpid());
+
+  TestConcurrentAttachOrPublish(Name);
+  TestVersions(Name);
+  TestKilledHolder(Name);
+  TestLeftBehind(Name);
+
+  SharedBinning::remove(Name);
+
+  std::cout << NumberFailures << " checks failed\n";
+  return NumberFailures == 0 ? 0 : 1;
+
+}
@@ -0,0 +1,365 @@
+/**
+ * Compiles a binning scheme into a self-contained C++ header
+ * The header holds the binning as constexpr tables, together with inline
+ * lookup functions, so a program that includes it needs no file I/O or
+ * ROOT to find bin labels. The lookup follows the same steps as
+ * HyperBinningFrozen, which in turn agrees with HyperHistogram::getVal
+ * @param 1 Filename of binning scheme
+ * @param 2 Filename of the header to write
+ * @param 3 (Optional) Namespace of the generated code, default is BinningScheme
+ * @param 4 (Optional) Number of random points to check, default is 100000
+ *
+ * The random points are checked in two ways. First, the tables are checked
+ * against HyperHistogram::getVal here. Second, a small program
+ * <header>_check.cpp is written next to the header, with the expected
+ * labels embedded, which checks the compiled lookup:
+ * g++ -std=c++17 -O2 -I<header directory> <header>_check.cpp && ./a.out
+ */
+
+#include<cstdint>
+#include<cstdio>
+#include<fstream>
+#include<iostream>
+#include<limits>
+#include<string>
+#include<vector>
+#include"HyperPoint.h"
+#include"HyperHistogram.h"
+#include"HyperBinningFrozen.h"
+
+/**
+ * Random number generator used for the check points
+ * The same generator is written into the check program, so both see the
+ * same points on any platform
+ */
+struct CheckRandom {
+  std::uint64_t State;
+  explicit CheckRandom(std::uint64_t Seed): State(Seed) {}
+  double Uniform(double Low, double High) {
+    State ^= State >> 12;
+    State ^= State << 25;
+    State ^= State >> 27;
+    return Low + (High - Low)*static_cast<double>((State*0x2545F4914F6CDD1DULL) >> 11)*0x1.0p-53;
+  }
+};
+
+/**
+ * Source code of CheckRandom, and of a function that fills a point from it
+ * The points are spread over the limits of the binning, plus 5% on each side
+ */
+const std::string CheckRandomSource = R"(struct CheckRandom {
+  std::uint64_t State;
+  explicit CheckRandom(std::uint64_t Seed): State(Seed) {}
+  double Uniform(double Low, double High) {
+    State ^= State >> 12;
+    State ^= State << 25;
+    State ^= State >> 27;
+    return Low + (High - Low)*static_cast<double>((State*0x2545F4914F6CDD1DULL) >> 11)*0x1.0p-53;
+  }
+};
+)";
+
+/**
+ * Write a double so that it is read back exactly
+ */
+std::string ToString(double x) {
+  char Buffer[32];
+  std::snprintf(Buffer, sizeof(Buffer), "%.17g", x);
+  return Buffer;
+}
+
+/**
+ * Write an array of numbers, a few per line
+ * Zero-length arrays are not allowed in C++, so an empty array gets one dummy element
+ */
+template<typename T, typename F>
+void WriteArray(std::ostream &Output, const std::string &Type, const std::string &Name, const std::vector<T> &Values, F Format) {
+  Output << "  inline constexpr " << Type << " " << Name << "[] = {";
+  if(Values.size() == 0) {
+    Output << "0";
+  }
+  for(std::size_t i = 0; i < Values.size(); i++) {
+    Output << (i % 8 == 0 ? "\n    " : " ") << Format(Values[i]) << (i + 1 == Values.size() ? "" : ",");
+  }
+  Output << "\n  };\n\n";
+}
+
+/**
+ * Write the header with the tables and lookup functions
+ */
+void WriteHeader(std::ostream &Output, const HyperBinningFrozen &Binning,
+		 const std::string &SchemeName, const std::string &Namespace) {
+
+  const int Dimension = Binning.getDimension();
+  const HyperCuboid Limits = Binning.getLimits();
+
+  std::vector<double> CuboidCorners, VolumeLimits, LimitsTable;
+  std::vector<int> LinkedVolumes, PrimaryVolumes;
+  for(int d = 0; d < Dimension; d++) {
+    LimitsTable.push_back(Limits.getLowCorner().at(d));
+  }
+  for(int d = 0; d < Dimension; d++) {
+    LimitsTable.push_back(Limits.getHighCorner().at(d));
+  }
+  for(int v = 0; v < Binning.getNumHyperVolumes(); v++) {
+    for(int c = 0; c < Binning.getNumHyperCuboids(v); c++) {
+      CuboidCorners.insert(CuboidCorners.end(), Binning.getLowCorner(v, c), Binning.getLowCorner(v, c) + Dimension);
+      CuboidCorners.insert(CuboidCorners.end(), Binning.getHighCorner(v, c), Binning.getHighCorner(v, c) + Dimension);
+    }
+    VolumeLimits.insert(VolumeLimits.end(), Binning.getVolumeLimits(v), Binning.getVolumeLimits(v) + 2*Dimension);
+    for(int i = 0; i < Binning.getNumLinkedHyperVolumes(v); i++) {
+      LinkedVolumes.push_back(Binning.getLinkedHyperVolume(v, i));
+    }
+  }
+  for(int i = 0; i < Binning.getNumPrimaryVolumes(); i++) {
+    PrimaryVolumes.push_back(Binning.getPrimaryVolumeNumber(i));
+  }
+
+  const std::string Guard = Namespace + "_HH";
+
+  Output << "/**\n"
+	 << " * Binning scheme " << SchemeName << ", compiled into C++ by BinningCodeGenerator\n"
+	 << " * Do not edit, generate it again from the binning scheme instead\n"
+	 << " * Usage: const int Label = " << Namespace << "::getLabel(Coords);\n"
+	 << " * where Coords is a double[" << Dimension << "]\n"
+	 << " */\n\n"
+	 << "#ifndef " << Guard << "\n"
+	 << "#define " << Guard << "\n\n"
+	 << "#include<cstdint>\n\n"
+	 << "namespace " << Namespace << " {\n\n"
+	 << "  inline constexpr int Dimension = " << Dimension << ";\n"
+	 << "  inline constexpr int NumberHyperVolumes = " << Binning.getNumHyperVolumes() << ";\n"
+	 << "  inline constexpr int NumberBins = " << Binning.getNumBins() << ";\n"
+	 << "  inline constexpr int NumberPrimaryVolumes = " << Binning.getNumPrimaryVolumes() << ";\n"
+	 << "  inline constexpr int OutsideLabel = " << Binning.getOutsideLabel() << ";\n\n"
+	 << "  struct Node {\n"
+	 << "    int FirstCuboid;\n"
+	 << "    int NumberCuboids;\n"
+	 << "    int FirstLink;\n"
+	 << "    int NumberLinks;\n"
+	 << "    int BinNumber;\n"
+	 << "    std::int16_t Label;\n"
+	 << "  };\n\n";
+
+  auto FormatDouble = [](double x) { return ToString(x); };
+  auto FormatInt = [](int x) { return std::to_string(x); };
+
+  WriteArray(Output, "double", "Limits", LimitsTable, FormatDouble);
+
+  Output << "  inline constexpr Node Nodes[] = {";
+  int FirstCuboid = 0, FirstLink = 0;
+  for(int v = 0; v < Binning.getNumHyperVolumes(); v++) {
+    Output << "\n    {" << FirstCuboid << ", " << Binning.getNumHyperCuboids(v) << ", "
+	   << FirstLink << ", " << Binning.getNumLinkedHyperVolumes(v) << ", "
+	   << Binning.getBinNum(v) << ", "
+	   << (Binning.getBinNum(v) == -1 ? 0 : Binning.getVolumeLabel(v)) << "}"
+	   << (v + 1 == Binning.getNumHyperVolumes() ? "" : ",");
+    FirstCuboid += Binning.getNumHyperCuboids(v);
+    FirstLink += Binning.getNumLinkedHyperVolumes(v);
+  }
+  Output << "\n  };\n\n";
+
+  WriteArray(Output, "double", "CuboidCorners", CuboidCorners, FormatDouble);
+  WriteArray(Output, "double", "VolumeLimits", VolumeLimits, FormatDouble);
+  WriteArray(Output, "int", "LinkedVolumes", LinkedVolumes, FormatInt);
+  WriteArray(Output, "int", "PrimaryVolumes", PrimaryVolumes, FormatInt);
+
+  Output << R"(  /**
+   * Check if Coords is inside the box with corners Box[0..Dimension-1] and Box[Dimension..2*Dimension-1]
+   */
+  inline bool InBox(const double *Box, const double *Coords) {
+    for(int d = 0; d < Dimension; d++) {
+      if(!(Box[d] < Coords[d] && Coords[d] <= Box[Dimension + d])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Check if Coords is inside a HyperVolume
+   */
+  inline bool InVolume(int Volume, const double *Coords) {
+    const Node &ThisNode = Nodes[Volume];
+    if(ThisNode.NumberCuboids > 1 && !InBox(VolumeLimits + 2*Dimension*Volume, Coords)) {
+      return false;
+    }
+    for(int c = 0; c < ThisNode.NumberCuboids; c++) {
+      if(InBox(CuboidCorners + 2*Dimension*(ThisNode.FirstCuboid + c), Coords)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Get the number of the HyperVolume that is a true bin and contains Coords, or -1
+   */
+  inline int getVolumeNumber(const double *Coords) {
+    if(!InBox(Limits, Coords)) {
+      return -1;
+    }
+    int Volume = -1;
+    const int NumberRoots = NumberPrimaryVolumes == 0 ? NumberHyperVolumes : NumberPrimaryVolumes;
+    for(int i = 0; i < NumberRoots; i++) {
+      const int ThisVolume = NumberPrimaryVolumes == 0 ? i : PrimaryVolumes[i];
+      if(InVolume(ThisVolume, Coords)) {
+        Volume = ThisVolume;
+        break;
+      }
+    }
+    while(Volume != -1 && Nodes[Volume].NumberLinks > 0) {
+      const Node &Mother = Nodes[Volume];
+      Volume = -1;
+      for(int i = Mother.FirstLink; i < Mother.FirstLink + Mother.NumberLinks; i++) {
+        if(InVolume(LinkedVolumes[i], Coords)) {
+          Volume = LinkedVolumes[i];
+          break;
+        }
+      }
+    }
+    return Volume;
+  }
+
+  /**
+   * Get the bin number that Coords falls into, or -1 if it is outside the binning
+   */
+  inline int getBinNumber(const double *Coords) {
+    const int Volume = getVolumeNumber(Coords);
+    return Volume == -1 ? -1 : Nodes[Volume].BinNumber;
+  }
+
+  /**
+   * Get the label of the bin that Coords falls into
+   */
+  inline int getLabel(const double *Coords) {
+    const int Volume = getVolumeNumber(Coords);
+    return Volume == -1 ? OutsideLabel : Nodes[Volume].Label;
+  }
+
+)";
+
+  Output << "}\n\n#endif\n";
+}
+
+/**
+ * Write the program that checks the compiled lookup against the expected labels
+ */
+void WriteCheck(std::ostream &Output, const std::string &HeaderName,
+		const std::string &Namespace, std::uint64_t Seed,
+		const std::vector<int> &Labels) {
+
+  Output << "// Checks " << HeaderName << " against labels from HyperHistogram::getVal, generated by BinningCodeGenerator\n\n"
+	 << "#include<cstdint>\n"
+	 << "#include<iostream>\n"
+	 << "#include\"" << HeaderName << "\"\n\n"
+	 << CheckRandomSource << "\n";
+  WriteArray(Output, "int", "ExpectedLabels", Labels, [](int x) { return std::to_string(x); });
+  Output << "int main() {\n"
+	 << "  CheckRandom Random(" << Seed << "ULL);\n"
+	 << "  const int NumberPoints = " << Labels.size() << ";\n"
+	 << "  int Mismatches = 0;\n"
+	 << "  for(int n = 0; n < NumberPoints; n++) {\n"
+	 << "    double Coords[" << Namespace << "::Dimension];\n"
+	 << "    for(int d = 0; d < " << Namespace << "::Dimension; d++) {\n"
+	 << "      const double Low = " << Namespace << "::Limits[d];\n"
+	 << "      const double High = " << Namespace << "::Limits[" << Namespace << "::Dimension + d];\n"
+	 << "      Coords[d] = Random.Uniform(Low - 0.05*(High - Low), High + 0.05*(High - Low));\n"
+	 << "    }\n"
+	 << "    if(" << Namespace << "::getLabel(Coords) != ExpectedLabels[n]) {\n"
+	 << "      Mismatches++;\n"
+	 << "    }\n"
+	 << "  }\n"
+	 << "  std::cout << Mismatches << \" mismatches out of \" << NumberPoints << \" points\\n\";\n"
+	 << "  return Mismatches == 0 ? 0 : 1;\n"
+	 << "}\n";
+}
+
+int main(int argc, char *argv[]) {
+
+  if(argc < 3 || argc > 5) {
+    std::cout << "Usage: " << argv[0] << " <binning scheme> <output header> [namespace] [number of check points]\n";
+    return 0;
+  }
+
+  const std::string SchemeName(argv[1]);
+  const std::string HeaderFilename(argv[2]);
+  const std::string Namespace = argc >= 4 ? argv[3] : "BinningScheme";
+  const int NumberCheckPoints = argc == 5 ? std::stoi(std::string(argv[4])) : 100000;
+
+  // Load and freeze the binning scheme
+
+  const HyperHistogram hyperHistogram(SchemeName.c_str(), "MEMRES READ");
+  const HyperBinningFrozen Binning = hyperHistogram.freeze();
+  if(!Binning.hasLabels()) {
+    std::cerr << "The bin contents of " << SchemeName << " can't be stored as integer labels\n";
+    return 1;
+  }
+
+  // Check the tables against HyperHistogram::getVal
+
+  const std::uint64_t Seed = 0x9E3779B97F4A7C15ULL;
+  CheckRandom Random(Seed);
+  const int Dimension = Binning.getDimension();
+  const HyperCuboid Limits = Binning.getLimits();
+  std::vector<int> Labels;
+  Labels.reserve(NumberCheckPoints);
+  HyperPoint Point(Dimension);
+  int Mismatches = 0;
+  for(int n = 0; n < NumberCheckPoints; n++) {
+    for(int d = 0; d < Dimension; d++) {
+      const double Low = Limits.getLowCorner().at(d);
+      const double High = Limits.getHighCorner().at(d);
+      Point.at(d) = Random.Uniform(Low - 0.05*(High - Low), High + 0.05*(High - Low));
+    }
+    const int Label = static_cast<int>(hyperHistogram.getVal(Point));
+    if(Binning.getLabel(Point) != Label) {
+      Mismatches++;
+    }
+    Labels.push_back(Label);
+  }
+  if(Mismatches > 0) {
+    std::cerr << Mismatches << " out of " << NumberCheckPoints << " points disagree with HyperHistogram::getVal, not writing the header\n";
+    return 1;
+  }
+
+  // Write the header and the check program
+
+  std::ofstream Header(HeaderFilename);
+  if(!Header) {
+    std::cerr << "Can't open " << HeaderFilename << " for writing\n";
+    return 1;
+  }
+  WriteHeader(Header, Binning, SchemeName, Namespace);
+  Header.close();
+
+  // The check program goes next to the header, with the extension of the header, if it has one, replaced
+  const std::size_t Slash = HeaderFilename.find_last_of('/');
+  const std::size_t NameStart = Slash == std::string::npos ? 0 : Slash + 1;
+  const std::string HeaderName = HeaderFilename.substr(NameStart);
+  const std::size_t Dot = HeaderFilename.find_last_of('.');
+  const std::string Stem = Dot != std::string::npos && Dot > NameStart ? HeaderFilename.substr(0, Dot) : HeaderFilename;
+  const std::string CheckFilename = Stem + "_check.cpp";
+  if(NumberCheckPoints > 0) {
+    std::ofstream Check(CheckFilename);
+    if(!Check) {
+      std::cerr << "Can't open " << CheckFilename << " for writing\n";
+      return 1;
+    }
+    WriteCheck(Check, HeaderName, Namespace, Seed, Labels);
+    Check.close();
+    if(!Check) {
+      std::cerr << "Could not write " << CheckFilename << "\n";
+      return 1;
+    }
+  }
+
+  std::cout << "Wrote " << Binning.getNumHyperVolumes() << " HyperVolumes (" << Binning.getNumBins()
+	    << " bins) to " << HeaderFilename << ", which agrees with HyperHistogram::getVal on "
+	    << NumberCheckPoints << " random points\n";
+  if(NumberCheckPoints > 0) {
+    std::cout << "To check the compiled lookup, compile and run " << CheckFilename << "\n";
+  }
+
+  return 0;
+}
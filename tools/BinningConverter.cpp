@@ -0,0 +1,93 @@
+/**
+ * Converts a binning scheme into a binary scheme file
+ * The binary file holds the frozen binning, with its bin labels, and can be
+ * loaded with HyperBinningFrozen::load by programs that only link against
+ * D02pipipipi_binning_core, without ROOT
+ * @param 1 Filename of binning scheme
+ * @param 2 Filename of the binary scheme file to write
+ * @param 3 (Optional) Number of random points to check, default is 100000
+ *
+ * The random points are checked against HyperHistogram::getVal, both
+ * before the file is written and after it has been loaded again
+ */
+
+#include<iostream>
+#include<random>
+#include<string>
+#include<vector>
+#include"HyperPoint.h"
+#include"HyperHistogram.h"
+#include"HyperBinningFrozen.h"
+
+int main(int argc, char *argv[]) {
+
+  if(argc < 3 || argc > 4) {
+    std::cout << "Usage: " << argv[0] << " <binning scheme> <binary scheme file> [number of check points]\n";
+    return 0;
+  }
+
+  const std::string SchemeName(argv[1]);
+  const std::string BinaryFilename(argv[2]);
+  const int NumberCheckPoints = argc == 4 ? std::stoi(std::string(argv[3])) : 100000;
+
+  // Load and freeze the binning scheme
+
+  const HyperHistogram hyperHistogram(SchemeName.c_str(), "MEMRES READ");
+  const HyperBinningFrozen Binning = hyperHistogram.freeze();
+  if(!Binning.hasLabels()) {
+    std::cerr << "The bin contents of " << SchemeName << " can't be stored as integer labels\n";
+    return 1;
+  }
+
+  // Draw the check points over the limits of the binning, plus 5% on each side
+
+  std::mt19937_64 Random(0x9E3779B97F4A7C15ULL);
+  const int Dimension = Binning.getDimension();
+  const HyperCuboid Limits = Binning.getLimits();
+  std::vector<HyperPoint> Points(NumberCheckPoints, HyperPoint(Dimension));
+  std::vector<int> Labels(NumberCheckPoints);
+  for(int n = 0; n < NumberCheckPoints; n++) {
+    for(int d = 0; d < Dimension; d++) {
+      const double Low = Limits.getLowCorner().at(d);
+      const double High = Limits.getHighCorner().at(d);
+      Points[n].at(d) = std::uniform_real_distribution<double>(Low - 0.05*(High - Low), High + 0.05*(High - Low))(Random);
+    }
+    Labels[n] = static_cast<int>(hyperHistogram.getVal(Points[n]));
+  }
+
+  auto CountMismatches = [&](const HyperBinningFrozen &Frozen) {
+    int Mismatches = 0;
+    for(int n = 0; n < NumberCheckPoints; n++) {
+      if(Frozen.getLabel(Points[n]) != Labels[n]) {
+        Mismatches++;
+      }
+    }
+    return Mismatches;
+  };
+
+  int Mismatches = CountMismatches(Binning);
+  if(Mismatches > 0) {
+    std::cerr << Mismatches << " out of " << NumberCheckPoints << " points disagree with HyperHistogram::getVal, not writing the file\n";
+    return 1;
+  }
+
+  // Write the file, and check it by loading it again
+
+  if(!Binning.save(BinaryFilename)) {
+    return 1;
+  }
+
+  HyperBinningFrozen Loaded;
+  if(!Loaded.load(BinaryFilename)) {
+    return 1;
+  }
+  Mismatches = CountMismatches(Loaded);
+  if(Mismatches > 0) {
+    std::cerr << Mismatches << " out of " << NumberCheckPoints << " points disagree after loading " << BinaryFilename << "\n";
+    return 1;
+  }
+
+  std::cout << "Wrote " << Binning.getNumBins() << " bins to " << BinaryFilename << ", all " << NumberCheckPoints << " check points agree\n";
+  return 0;
+
+}
@@ -0,0 +1,246 @@
+/**
+ * Compares two versions of a binning scheme, and prints how much of the
+ * old binning changes label and how much needs to be looked up again
+ * when events are re-binned from their old bin numbers
+ * @param 1 Filename of old binning scheme, either a ROOT file or a binary scheme file
+ * @param 2 Filename of new binning scheme, either a ROOT file or a binary scheme file
+ * @param 3 (Optional) Number of changes to list, default is 10, or a sample binned with the old binning scheme
+ * @param 4 (Optional) Output file for the sample re-binned with the new binning scheme
+ *
+ * With a sample, its events are re-binned from their stored bin numbers,
+ * and only those in old bins that are split between several new labels
+ * are looked up again. If the filename ends with .csv each event is one
+ * line "x1,...,xD,old bin number" with the D coordinates of the binning,
+ * otherwise each event is a binary record of D doubles followed by the old
+ * bin number as a 32-bit integer, in the native byte order. The output has
+ * the same format, with the new label appended to each event.
+ */
+
+#include<cctype>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<fstream>
+#include<iostream>
+#include<random>
+#include<string>
+#include<vector>
+#include"HyperHistogram.h"
+#include"HyperCuboid.h"
+#include"HyperBinningFrozen.h"
+#include"BinningDiff.h"
+
+bool LoadBinning(const std::string &SchemeName, HyperBinningFrozen &Binning) {
+  if(SchemeName.size() >= 5 && SchemeName.compare(SchemeName.size() - 5, 5, ".root") == 0) {
+    Binning = HyperHistogram(SchemeName.c_str(), "MEMRES READ").freeze();
+    if(!Binning.hasLabels()) {
+      std::cerr << "The bin contents of " << SchemeName << " can't be stored as integer labels\n";
+      return false;
+    }
+    return true;
+  }
+  return Binning.load(SchemeName);
+}
+
+bool IsCSV(const std::string &Filename) {
+  return Filename.size() >= 4 && Filename.compare(Filename.size() - 4, 4, ".csv") == 0;
+}
+
+/**
+ * Read the next events of a sample, each with its coordinates and its bin number
+ * @param Input The sample
+ * @param CSV Is the sample a CSV file?
+ * @param Dimension Number of coordinates of each event
+ * @param MaxEvents Largest number of events to read
+ * @param Coordinates The coordinates of the events, back to back
+ * @param BinNumbers The bin numbers of the events
+ * @param NumberEvents The number of events read
+ * @return False if an event can't be read
+ */
+bool ReadEvents(std::ifstream &Input, bool CSV, int Dimension, int MaxEvents, std::vector<double> &Coordinates, std::vector<int> &BinNumbers, int &NumberEvents) {
+  NumberEvents = 0;
+  std::string Line;
+  std::vector<char> Record(Dimension*sizeof(double) + sizeof(int));
+  while(NumberEvents < MaxEvents) {
+    double *Coords = Coordinates.data() + NumberEvents*Dimension;
+    if(CSV) {
+      if(!std::getline(Input, Line)) {
+        break;
+      }
+      if(Line.find_first_not_of(" \t\r") == std::string::npos) {
+        continue;
+      }
+      const char *Position = Line.c_str();
+      char *End = nullptr;
+      for(int d = 0; d < Dimension; d++) {
+        Coords[d] = std::strtod(Position, &End);
+        if(End == Position || *End != ',') {
+          return false;
+        }
+        Position = End + 1;
+      }
+      BinNumbers[NumberEvents] = std::strtol(Position, &End, 10);
+      while(std::isspace(static_cast<unsigned char>(*End))) {
+        End++;
+      }
+      if(End == Position || *End != '\0') {
+        return false;
+      }
+    } else {
+      Input.read(Record.data(), Record.size());
+      if(Input.gcount() == 0) {
+        break;
+      }
+      if(static_cast<std::size_t>(Input.gcount()) != Record.size()) {
+        return false;
+      }
+      std::memcpy(Coords, Record.data(), Dimension*sizeof(double));
+      std::memcpy(&BinNumbers[NumberEvents], Record.data() + Dimension*sizeof(double), sizeof(int));
+    }
+    NumberEvents++;
+  }
+  return true;
+}
+
+/**
+ * Write events with their coordinates, their old bin number and their new label
+ */
+void WriteEvents(std::ofstream &Output, bool CSV, int Dimension, int NumberEvents, const std::vector<double> &Coordinates, const std::vector<int> &BinNumbers, const std::vector<int> &Labels) {
+  std::string Buffer;
+  char Number[32];
+  for(int i = 0; i < NumberEvents; i++) {
+    const double *Coords = Coordinates.data() + i*Dimension;
+    if(CSV) {
+      for(int d = 0; d < Dimension; d++) {
+        const int Length = std::snprintf(Number, sizeof(Number), "%.17g,", Coords[d]);
+        Buffer.append(Number, Length);
+      }
+      const int Length = std::snprintf(Number, sizeof(Number), "%d,%d\n", BinNumbers[i], Labels[i]);
+      Buffer.append(Number, Length);
+    } else {
+      Buffer.append(reinterpret_cast<const char*>(Coords), Dimension*sizeof(double));
+      Buffer.append(reinterpret_cast<const char*>(&BinNumbers[i]), sizeof(int));
+      Buffer.append(reinterpret_cast<const char*>(&Labels[i]), sizeof(int));
+    }
+  }
+  Output.write(Buffer.data(), Buffer.size());
+}
+
+/**
+ * Re-bin a sample binned with the old binning scheme, a chunk of events at a time, and write it with the new labels
+ * @return False if the sample can't be read or written, or has bin numbers that aren't in the old binning scheme
+ */
+bool RebinSample(const BinningDiff &Diff, int Dimension, const std::string &InputName, const std::string &OutputName) {
+  std::ifstream Input(InputName, IsCSV(InputName) ? std::ios::in : std::ios::in | std::ios::binary);
+  if(!Input) {
+    std::cerr << "Could not open " << InputName << "\n";
+    return false;
+  }
+  std::ofstream Output(OutputName, IsCSV(OutputName) ? std::ios::out : std::ios::out | std::ios::binary);
+  if(!Output) {
+    std::cerr << "Could not open " << OutputName << "\n";
+    return false;
+  }
+
+  const int ChunkSize = 1 << 16;
+  std::vector<double> Coordinates(static_cast<std::size_t>(ChunkSize)*Dimension);
+  std::vector<int> OldBinNumbers(ChunkSize), NewLabels(ChunkSize);
+  long NumberEvents = 0, NumberLookedUp = 0;
+  while(true) {
+    int NumberRead = 0;
+    if(!ReadEvents(Input, IsCSV(InputName), Dimension, ChunkSize, Coordinates, OldBinNumbers, NumberRead)) {
+      std::cerr << "Could not read event " << NumberEvents + NumberRead + 1 << " of " << InputName << "\n";
+      return false;
+    }
+    if(NumberRead == 0) {
+      break;
+    }
+    const int NumberChunkLookedUp = Diff.rebin(Coordinates.data(), OldBinNumbers.data(), NumberRead, NewLabels.data());
+    if(NumberChunkLookedUp == -1) {
+      return false;
+    }
+    WriteEvents(Output, IsCSV(OutputName), Dimension, NumberRead, Coordinates, OldBinNumbers, NewLabels);
+    NumberEvents += NumberRead;
+    NumberLookedUp += NumberChunkLookedUp;
+  }
+
+  Output.close();
+  if(!Output) {
+    std::cerr << "Could not write " << OutputName << "\n";
+    return false;
+  }
+  std::cout << "Re-binned " << NumberEvents << " events of " << InputName << " into " << OutputName << ", " << (NumberEvents == 0 ? 0.0 : 100.0*NumberLookedUp/NumberEvents) << "% looked up again\n";
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+
+  if(argc < 3 || argc > 5) {
+    std::cout << "Usage: " << argv[0] << " <old binning scheme> <new binning scheme> [number of changes to list]\n";
+    std::cout << "       " << argv[0] << " <old binning scheme> <new binning scheme> <sample> <re-binned sample>\n";
+    return 0;
+  }
+
+  const bool HasSample = argc == 5;
+  const int NumberListed = argc == 4 ? std::stoi(std::string(argv[3])) : 10;
+
+  HyperBinningFrozen OldBinning, NewBinning;
+  if(!LoadBinning(std::string(argv[1]), OldBinning) || !LoadBinning(std::string(argv[2]), NewBinning)) {
+    return 1;
+  }
+  if(OldBinning.getDimension() != NewBinning.getDimension()) {
+    std::cout << "The binning schemes have different dimensions\n";
+    return 1;
+  }
+  if(OldBinning.getNumHyperVolumes() == 0) {
+    std::cout << "The old binning scheme has no HyperVolumes\n";
+    return 1;
+  }
+
+  const BinningDiff Diff(OldBinning, NewBinning, BinningDiff::Labels);
+
+  std::cout << "Label changes in " << 100.0*Diff.getChangedFraction() << "% of the old binning, in " << Diff.getChanges().size() << " regions\n";
+  std::cout << Diff.getNumLookupBins() << " of " << Diff.getNumOldBins() << " old bins (" << 100.0*Diff.getLookupFraction() << "% of the volume) need to be looked up again\n";
+  std::cout << "Events outside the old binning " << (Diff.needsLookup(-1) ? "need" : "don't need") << " to be looked up again\n";
+
+  if(HasSample) {
+    return RebinSample(Diff, OldBinning.getDimension(), std::string(argv[3]), std::string(argv[4])) ? 0 : 1;
+  }
+
+  for(std::size_t i = 0; i < Diff.getChanges().size() && int(i) < NumberListed; i++) {
+    const BinningDiff::Change &Change = Diff.getChanges()[i];
+    std::cout << "Bin " << Change.oldBin << " (label " << Change.oldLabel << ") to bin " << Change.newBin << " (label " << Change.newLabel << "):";
+    for(int d = 0; d < Change.region.getDimension(); d++) {
+      std::cout << " (" << Change.region.getLowCorner().at(d) << ", " << Change.region.getHighCorner().at(d) << "]";
+    }
+    std::cout << "\n";
+  }
+
+  // Check the re-binning against a lookup in the new binning, with random points in the old binning
+
+  const int Dimension = OldBinning.getDimension();
+  const int NumberPoints = 100000;
+  const HyperCuboid Limits = OldBinning.getLimits();
+  std::mt19937_64 Generator(1);
+  std::vector<double> Coordinates(NumberPoints*Dimension);
+  for(int i = 0; i < NumberPoints; i++) {
+    for(int d = 0; d < Dimension; d++) {
+      Coordinates[i*Dimension + d] = std::uniform_real_distribution<double>(Limits.getLowCorner().at(d), Limits.getHighCorner().at(d))(Generator);
+    }
+  }
+  std::vector<int> OldBinNumbers(NumberPoints), NewLabels(NumberPoints), LookupLabels(NumberPoints);
+  OldBinning.getBinNums(Coordinates.data(), NumberPoints, OldBinNumbers.data());
+  const int NumberLookedUp = Diff.rebin(Coordinates.data(), OldBinNumbers.data(), NumberPoints, NewLabels.data());
+  NewBinning.getLabels(Coordinates.data(), NumberPoints, LookupLabels.data());
+
+  int Mismatches = 0;
+  for(int i = 0; i < NumberPoints; i++) {
+    if(NewLabels[i] != LookupLabels[i]) {
+      Mismatches++;
+    }
+  }
+  std::cout << "Re-binned " << NumberPoints << " random points, " << 100.0*NumberLookedUp/NumberPoints << "% looked up again, " << Mismatches << " mismatches\n";
+
+  return Mismatches == 0 ? 0 : 1;
+
+}
@@ -0,0 +1,88 @@
+/**
+ * Rebuilds the bin hierarchy of a binning scheme, so that fewer HyperVolumes
+ * are tested to find a bin, and writes the result as a new binning scheme
+ * The bins, their numbers and their contents stay exactly the same
+ * @param 1 Filename of binning scheme
+ * @param 2 Filename of the optimised binning scheme to write
+ * @param 3 (Optional) Fan-out of the new hierarchy, default is 4
+ * @param 4 (Optional) Largest number of links between a primary volume and a bin, default is 0 (no limit)
+ *
+ * The number of HyperVolumes tested to reach a bin is reported before and
+ * after, and 100000 random points are checked to fall into the same bin
+ */
+
+#include<iomanip>
+#include<iostream>
+#include<random>
+#include<string>
+#include"HyperPoint.h"
+#include"HyperHistogram.h"
+#include"HyperBinningMemRes.h"
+#include"HyperBinningOptimiser.h"
+
+int main(int argc, char *argv[]) {
+
+  if(argc < 3 || argc > 5) {
+    std::cout << "Usage: " << argv[0] << " <binning scheme> <optimised binning scheme> [fan-out] [max depth]\n";
+    return 0;
+  }
+
+  const std::string SchemeName(argv[1]);
+  const std::string OptimisedName(argv[2]);
+  const int FanOut = argc >= 4 ? std::stoi(std::string(argv[3])) : 4;
+  const int MaxDepth = argc == 5 ? std::stoi(std::string(argv[4])) : 0;
+  const int NumberCheckPoints = 100000;
+
+  // Load the binning and rebuild its hierarchy
+
+  HyperBinningMemRes Binning;
+  Binning.load(SchemeName.c_str());
+
+  const HyperBinningOptimiser Optimiser(FanOut, MaxDepth);
+  std::unique_ptr<const HyperBinningMemRes> Optimised = Optimiser.optimise(Binning);
+  if(!Optimised) {
+    return 1;
+  }
+
+  auto PrintCost = [](const std::string &Name, const HyperBinningOptimiser::LookupCost &Cost) {
+    std::cout << std::setw(8) << Name << ": " << std::fixed << std::setprecision(2);
+    std::cout << Cost.averageTests << " volume tests on average, " << Cost.maxTests << " at most, ";
+    std::cout << Cost.averageDepth << " links deep on average, " << Cost.maxDepth << " at most, ";
+    std::cout << Cost.nHierarchy << " hierarchy volumes\n";
+  };
+  PrintCost("Before", HyperBinningOptimiser::getLookupCost(Binning));
+  PrintCost("After", HyperBinningOptimiser::getLookupCost(*Optimised));
+
+  // Check that random points over the limits of the binning, plus 5% on
+  // each side, fall into the same bins
+
+  std::mt19937_64 Random(0x9E3779B97F4A7C15ULL);
+  const int Dimension = Binning.getDimension();
+  const HyperCuboid Limits = Binning.getLimits();
+  HyperPoint Point(Dimension);
+  int Mismatches = 0;
+  for(int n = 0; n < NumberCheckPoints; n++) {
+    for(int d = 0; d < Dimension; d++) {
+      const double Low = Limits.getLowCorner().at(d);
+      const double High = Limits.getHighCorner().at(d);
+      Point.at(d) = std::uniform_real_distribution<double>(Low - 0.05*(High - Low), High + 0.05*(High - Low))(Random);
+    }
+    if(Binning.getBinNum(Point) != Optimised->getBinNum(Point)) {
+      Mismatches++;
+    }
+  }
+  if(Mismatches > 0) {
+    std::cerr << Mismatches << " out of " << NumberCheckPoints << " points fall into a different bin, not writing the file\n";
+    return 1;
+  }
+
+  // Save the new binning with the bin contents of the old one
+
+  HyperHistogram Histogram(*Optimised);
+  Histogram.loadBase(SchemeName.c_str());
+  Histogram.save(OptimisedName.c_str());
+
+  std::cout << "Wrote " << Optimised->getNumBins() << " bins to " << OptimisedName << ", all " << NumberCheckPoints << " check points agree\n";
+  return 0;
+
+}
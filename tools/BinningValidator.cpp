@@ -0,0 +1,72 @@
+/**
+ * Checks that the HyperVolumes linked from each HyperVolume of a binning
+ * scheme tile it exactly, and lists the overlaps, gaps and overhangs
+ * @param 1 Filename of binning scheme, either a ROOT file or a binary scheme file
+ * @param 2 (Optional) Number of threads, default is the number of hardware threads
+ * @param 3 (Optional) Number of defects of each kind to list, default is 10
+ *
+ * Returns 1 if anything is wrong with the binning, and 0 otherwise
+ */
+
+#include<chrono>
+#include<iostream>
+#include<string>
+#include"HyperBinningMemRes.h"
+#include"HyperBinningFrozen.h"
+#include"BinningValidator.h"
+
+int main(int argc, char *argv[]) {
+
+  if(argc < 2 || argc > 4) {
+    std::cout << "Usage: " << argv[0] << " <binning scheme> [number of threads] [number of defects to list]\n";
+    return 0;
+  }
+
+  const std::string SchemeName(argv[1]);
+  const int NumberThreads = argc >= 3 ? std::stoi(std::string(argv[2])) : 0;
+  const int NumberListed = argc == 4 ? std::stoi(std::string(argv[3])) : 10;
+
+  // Load the binning, from a ROOT file or a binary scheme file. Only the
+  // HyperVolumes are checked, so the bin contents don't need to be labels
+
+  HyperBinningFrozen Binning;
+  if(SchemeName.size() >= 5 && SchemeName.compare(SchemeName.size() - 5, 5, ".root") == 0) {
+    HyperBinningMemRes MemRes;
+    MemRes.load(SchemeName.c_str());
+    Binning = MemRes.freeze();
+  } else if(!Binning.load(SchemeName)) {
+    return 1;
+  }
+
+  const auto Start = std::chrono::steady_clock::now();
+  BinningValidator Validator;
+  const bool Valid = Validator.validate(Binning, NumberThreads);
+  const double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+
+  std::cout << "Checked " << Binning.getNumHyperVolumes() << " HyperVolumes in " << Seconds << " s: ";
+  std::cout << Validator.getOverlaps().size() << " overlaps, " << Validator.getGaps().size() << " gaps, " << Validator.getOverhangs().size() << " overhangs\n";
+
+  for(std::size_t i = 0; i < Validator.getOverlaps().size() && int(i) < NumberListed; i++) {
+    const BinningValidator::Overlap &Overlap = Validator.getOverlaps()[i];
+    std::cout << "Overlap in HyperVolume " << Overlap.volumeNumber << ": " << Overlap.first << " and " << Overlap.second << ", volume " << Overlap.volume << "\n";
+  }
+  for(std::size_t i = 0; i < Validator.getGaps().size() && int(i) < NumberListed; i++) {
+    const BinningValidator::Gap &Gap = Validator.getGaps()[i];
+    std::cout << "Gap in HyperVolume " << Gap.volumeNumber << ": volume " << Gap.volume << " (" << 100.0*Gap.fraction << "%), " << Gap.regions.size() << (Gap.allRegions ? "" : "+") << " regions\n";
+    if(Gap.regions.size() > 0) {
+      const HyperCuboid &Region = Gap.regions[0];
+      std::cout << "  largest region:";
+      for(int d = 0; d < Region.getDimension(); d++) {
+        std::cout << " (" << Region.getLowCorner().at(d) << ", " << Region.getHighCorner().at(d) << "]";
+      }
+      std::cout << "\n";
+    }
+  }
+  for(std::size_t i = 0; i < Validator.getOverhangs().size() && int(i) < NumberListed; i++) {
+    const BinningValidator::Overhang &Overhang = Validator.getOverhangs()[i];
+    std::cout << "Overhang in HyperVolume " << Overhang.volumeNumber << ": " << Overhang.linkedVolume << " sticks out by volume " << Overhang.volume << "\n";
+  }
+
+  return Valid ? 0 : 1;
+
+}